@@ -0,0 +1,16 @@
+# Превращает файл в C++ массив байт.
+# Usage: cmake -DINPUT=<file> -DOUTPUT=<file.cpp> -DSYMBOL=<name> -P embed_file.cmake
+
+file(READ ${INPUT} HEX_CONTENT HEX)
+file(SIZE ${INPUT} CONTENT_SIZE)
+
+# по 32 байта на строку
+string(REGEX REPLACE "([0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f])" "\\1\n" HEX_CONTENT "${HEX_CONTENT}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," BYTES "${HEX_CONTENT}")
+
+file(WRITE ${OUTPUT}
+        "// Generated by cmake/embed_file.cmake from ${INPUT}. Do not edit.\n"
+        "#include <cstddef>\n\n"
+        "alignas(64) extern const unsigned char ${SYMBOL}[] = {\n${BYTES}\n};\n"
+        "extern const size_t ${SYMBOL}_SIZE = ${CONTENT_SIZE};\n"
+)
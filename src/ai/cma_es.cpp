@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#define CMA_DIMENSIONS_MAX 16
+#define CMA_POPULATION_MAX 256
+#define CMA_JACOBI_SWEEPS 64
+
+// =============
+// CmaEs: CMA-ES (Hansen) для максимизации f(x) без производных. Цикл: ask - кандидаты
+// x = mean + sigma * B * D * z, z ~ N(0, I); tell - их оценки. По лучшим половине кандидатов
+// сдвигается среднее, подстраиваются ковариация (форма облака) и sigma (размер шага).
+// Собственное разложение ковариации - методом Якоби: размерность маленькая.
+// Генератор нормальных чисел свой и входит в состояние: продолжение с контрольной точки
+// дает те же кандидаты, что и непрерывный запуск.
+
+class CmaEs {
+public:
+    int dimensions;
+    int population; // lambda
+    int generation;
+    double sigma;
+    double mean[CMA_DIMENSIONS_MAX];
+    double pathSigma[CMA_DIMENSIONS_MAX];
+    double pathC[CMA_DIMENSIONS_MAX];
+    double covariance[CMA_DIMENSIONS_MAX][CMA_DIMENSIONS_MAX];
+    uint64_t randomState;
+
+private:
+    // Производные от dimensions и population, пересчитываются configure()
+    int parents; // mu
+    double weights[CMA_POPULATION_MAX];
+    double parentsEffective; // mu_eff
+    double cc, cs, c1, cmu, damps, chiN;
+    // covariance = B * diag(D^2) * B^T
+    double axes[CMA_DIMENSIONS_MAX][CMA_DIMENSIONS_MAX]; // B, столбцы - собственные векторы
+    double scales[CMA_DIMENSIONS_MAX]; // D
+
+    uint64_t nextRandom() {
+        // xorshift64*
+        this->randomState ^= this->randomState >> 12;
+        this->randomState ^= this->randomState << 25;
+        this->randomState ^= this->randomState >> 27;
+        return this->randomState * 0x2545F4914F6CDD1Dull;
+    }
+
+    double nextUniform() {
+        return ((double) (this->nextRandom() >> 11) + 0.5) / 9007199254740992.0;
+    }
+
+    // Бокс-Мюллер; второе число пары не хранится, чтобы состояние было одним словом
+    double nextGaussian() {
+        double u1 = this->nextUniform();
+        double u2 = this->nextUniform();
+        return std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+    }
+
+    void configure() {
+        int n = this->dimensions;
+        this->parents = this->population / 2;
+        double sum = 0.0;
+        double sumSquares = 0.0;
+        for (int i = 0; i < this->parents; i++) {
+            this->weights[i] = std::log(this->parents + 0.5) - std::log(i + 1.0);
+            sum += this->weights[i];
+        }
+        for (int i = 0; i < this->parents; i++) {
+            this->weights[i] /= sum;
+            sumSquares += this->weights[i] * this->weights[i];
+        }
+        this->parentsEffective = 1.0 / sumSquares;
+
+        double mueff = this->parentsEffective;
+        this->cc = (4.0 + mueff / n) / (n + 4.0 + 2.0 * mueff / n);
+        this->cs = (mueff + 2.0) / (n + mueff + 5.0);
+        this->c1 = 2.0 / ((n + 1.3) * (n + 1.3) + mueff);
+        this->cmu = std::min(1.0 - this->c1, 2.0 * (mueff - 2.0 + 1.0 / mueff) / ((n + 2.0) * (n + 2.0) + mueff));
+        this->damps = 1.0 + 2.0 * std::max(0.0, std::sqrt((mueff - 1.0) / (n + 1.0)) - 1.0) + this->cs;
+        this->chiN = std::sqrt((double) n) * (1.0 - 1.0 / (4.0 * n) + 1.0 / (21.0 * n * n));
+    }
+
+    // Якоби: вращениями обнуляет внедиагональные элементы копии ковариации
+    void decompose() {
+        int n = this->dimensions;
+        double a[CMA_DIMENSIONS_MAX][CMA_DIMENSIONS_MAX];
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                a[i][j] = this->covariance[i][j];
+                this->axes[i][j] = i == j ? 1.0 : 0.0;
+            }
+        }
+        for (int sweep = 0; sweep < CMA_JACOBI_SWEEPS; sweep++) {
+            double offDiagonal = 0.0;
+            for (int p = 0; p < n; p++) {
+                for (int q = p + 1; q < n; q++) { offDiagonal += a[p][q] * a[p][q]; }
+            }
+            if (offDiagonal < 1e-30) { break; }
+            for (int p = 0; p < n; p++) {
+                for (int q = p + 1; q < n; q++) {
+                    if (std::fabs(a[p][q]) < 1e-300) { continue; }
+                    double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                    double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                    double c = 1.0 / std::sqrt(t * t + 1.0);
+                    double s = t * c;
+                    for (int k = 0; k < n; k++) {
+                        double akp = a[k][p];
+                        double akq = a[k][q];
+                        a[k][p] = c * akp - s * akq;
+                        a[k][q] = s * akp + c * akq;
+                    }
+                    for (int k = 0; k < n; k++) {
+                        double apk = a[p][k];
+                        double aqk = a[q][k];
+                        a[p][k] = c * apk - s * aqk;
+                        a[q][k] = s * apk + c * aqk;
+                    }
+                    for (int k = 0; k < n; k++) {
+                        double bkp = this->axes[k][p];
+                        double bkq = this->axes[k][q];
+                        this->axes[k][p] = c * bkp - s * bkq;
+                        this->axes[k][q] = s * bkp + c * bkq;
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            this->scales[i] = std::sqrt(std::max(a[i][i], 1e-20));
+        }
+    }
+
+public:
+    CmaEs(): dimensions(0), population(0), generation(0), sigma(0.0), mean(), pathSigma(), pathC(), covariance(),
+             randomState(1), parents(0), weights(), parentsEffective(0.0), cc(0.0), cs(0.0), c1(0.0), cmu(0.0),
+             damps(0.0), chiN(0.0), axes(), scales() {}
+
+    // population = 0 - стандартный размер 4 + 3 ln n
+    void start(int dimensions, const double* initialMean, double initialSigma, int population, uint64_t seed) {
+        *this = CmaEs();
+        this->dimensions = std::max(1, std::min(dimensions, CMA_DIMENSIONS_MAX));
+        this->population = population > 0 ? population : 4 + (int) (3.0 * std::log((double) this->dimensions));
+        this->population = std::max(2, std::min(this->population, CMA_POPULATION_MAX));
+        this->sigma = initialSigma;
+        this->randomState = seed != 0 ? seed : 0x9E3779B97F4A7C15ull;
+        for (int i = 0; i < this->dimensions; i++) {
+            this->mean[i] = initialMean[i];
+            this->covariance[i][i] = 1.0;
+        }
+        this->configure();
+        this->decompose();
+    }
+
+    void ask(std::vector<std::vector<double>>* candidates) {
+        int n = this->dimensions;
+        candidates->assign(this->population, std::vector<double>(n, 0.0));
+        for (auto& x : *candidates) {
+            double z[CMA_DIMENSIONS_MAX];
+            for (int i = 0; i < n; i++) { z[i] = this->scales[i] * this->nextGaussian(); }
+            for (int i = 0; i < n; i++) {
+                double y = 0.0;
+                for (int j = 0; j < n; j++) { y += this->axes[i][j] * z[j]; }
+                x[i] = this->mean[i] + this->sigma * y;
+            }
+        }
+    }
+
+    // fitness[i] - оценка candidates[i], больше - лучше
+    void tell(const std::vector<std::vector<double>>& candidates, const std::vector<double>& fitness) {
+        int n = this->dimensions;
+        std::vector<int> order(candidates.size());
+        for (size_t i = 0; i < order.size(); i++) { order[i] = (int) i; }
+        std::stable_sort(order.begin(), order.end(), [&fitness](int a, int b) { return fitness[a] > fitness[b]; });
+
+        double oldMean[CMA_DIMENSIONS_MAX];
+        std::copy(this->mean, this->mean + n, oldMean);
+        for (int i = 0; i < n; i++) {
+            this->mean[i] = 0.0;
+            for (int k = 0; k < this->parents; k++) { this->mean[i] += this->weights[k] * candidates[order[k]][i]; }
+        }
+
+        // Шаг среднего в единицах sigma и он же, приведенный к изотропному: C^(-1/2) * step
+        double step[CMA_DIMENSIONS_MAX];
+        for (int i = 0; i < n; i++) { step[i] = (this->mean[i] - oldMean[i]) / this->sigma; }
+        double rotated[CMA_DIMENSIONS_MAX];
+        for (int j = 0; j < n; j++) {
+            double sum = 0.0;
+            for (int i = 0; i < n; i++) { sum += this->axes[i][j] * step[i]; }
+            rotated[j] = sum / this->scales[j];
+        }
+        double whitened[CMA_DIMENSIONS_MAX];
+        for (int i = 0; i < n; i++) {
+            double sum = 0.0;
+            for (int j = 0; j < n; j++) { sum += this->axes[i][j] * rotated[j]; }
+            whitened[i] = sum;
+        }
+
+        double sigmaRate = std::sqrt(this->cs * (2.0 - this->cs) * this->parentsEffective);
+        double pathNorm = 0.0;
+        for (int i = 0; i < n; i++) {
+            this->pathSigma[i] = (1.0 - this->cs) * this->pathSigma[i] + sigmaRate * whitened[i];
+            pathNorm += this->pathSigma[i] * this->pathSigma[i];
+        }
+        pathNorm = std::sqrt(pathNorm);
+        this->generation += 1;
+        double decay = 1.0 - std::pow(1.0 - this->cs, 2.0 * this->generation);
+        bool isStalled = pathNorm / std::sqrt(decay) / this->chiN >= 1.4 + 2.0 / (n + 1.0);
+
+        double cRate = std::sqrt(this->cc * (2.0 - this->cc) * this->parentsEffective);
+        for (int i = 0; i < n; i++) {
+            this->pathC[i] = (1.0 - this->cc) * this->pathC[i] + (isStalled ? 0.0 : cRate * step[i]);
+        }
+
+        double correction = isStalled ? this->c1 * this->cc * (2.0 - this->cc) : 0.0;
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j <= i; j++) {
+                double rankMu = 0.0;
+                for (int k = 0; k < this->parents; k++) {
+                    const std::vector<double>& x = candidates[order[k]];
+                    rankMu += this->weights[k] * (x[i] - oldMean[i]) * (x[j] - oldMean[j]);
+                }
+                rankMu /= this->sigma * this->sigma;
+                double value = (1.0 - this->c1 - this->cmu) * this->covariance[i][j]
+                        + this->c1 * this->pathC[i] * this->pathC[j] + correction * this->covariance[i][j]
+                        + this->cmu * rankMu;
+                this->covariance[i][j] = value;
+                this->covariance[j][i] = value;
+            }
+        }
+
+        this->sigma *= std::exp((this->cs / this->damps) * (pathNorm / this->chiN - 1.0));
+        this->decompose();
+    }
+
+    // Состояние - текстом, числа с полной точностью
+    void write(FILE* file) const {
+        int n = this->dimensions;
+        fprintf(file, "cma %d %d %d %.17g %llu\n", n, this->population, this->generation, this->sigma,
+                (unsigned long long) this->randomState);
+        auto writeVector = [file, n](const char* name, const double* values) {
+            fprintf(file, "%s", name);
+            for (int i = 0; i < n; i++) { fprintf(file, " %.17g", values[i]); }
+            fprintf(file, "\n");
+        };
+        writeVector("mean", this->mean);
+        writeVector("path_sigma", this->pathSigma);
+        writeVector("path_c", this->pathC);
+        for (int i = 0; i < n; i++) { writeVector("covariance", this->covariance[i]); }
+    }
+
+    bool read(FILE* file) {
+        CmaEs state;
+        unsigned long long randomState = 0;
+        int n = 0;
+        if (fscanf(file, " cma %d %d %d %lf %llu", &n, &state.population, &state.generation, &state.sigma, &randomState) != 5) {
+            return false;
+        }
+        if (n < 1 || n > CMA_DIMENSIONS_MAX || state.population < 2 || state.population > CMA_POPULATION_MAX) { return false; }
+        state.dimensions = n;
+        state.randomState = (uint64_t) randomState;
+        auto readVector = [file, n](const char* name, double* values) {
+            char key[32];
+            if (fscanf(file, " %31s", key) != 1 || std::string(key) != name) { return false; }
+            for (int i = 0; i < n; i++) {
+                if (fscanf(file, " %lf", &values[i]) != 1) { return false; }
+            }
+            return true;
+        };
+        bool isValid = readVector("mean", state.mean) && readVector("path_sigma", state.pathSigma)
+                && readVector("path_c", state.pathC);
+        for (int i = 0; i < n && isValid; i++) { isValid = readVector("covariance", state.covariance[i]); }
+        if (!isValid || !(state.sigma > 0.0)) { return false; }
+
+        state.configure();
+        state.decompose();
+        *this = state;
+        return true;
+    }
+};
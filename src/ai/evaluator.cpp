@@ -0,0 +1,239 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "../game.cpp"
+#include "../log.cpp"
+
+// Признаки позиции после хода; вес каждого - в EvalWeights
+enum EvalFeature {
+    evalLandingHeight = 0, // высота середины фигуры после падения
+    evalLines = 1, // убрано строк этим ходом
+    evalHeight = 2, // сумма высот столбцов
+    evalMaxHeight = 3,
+    evalHoles = 4, // пустые клетки под верхом своего столбца
+    evalBumpiness = 5, // сумма |разница высот соседних столбцов|
+    evalWells = 6, // сумма глубин колодцев (столбец ниже обоих соседей, стены - высокие)
+    EVAL_FEATURES = 7
+};
+
+const char* EVAL_FEATURE_NAMES[EVAL_FEATURES] = {
+    "landing_height", "lines", "height", "max_height", "holes", "bumpiness", "wells"
+};
+
+// Ход, после которого фигура остается в скрытых строках: партия проиграна
+#define EVAL_LOSS_SCORE -1e30f
+#define EVAL_ROWS_MASK ((uint32_t) (((uint64_t) 1 << FIELD_H) - 1))
+#define EVAL_HIDDEN_MASK (((uint32_t) 1 << VIEWABLE_FIELD_Y) - 1)
+
+// =================================================
+// Файл весов (// - комментарий до конца строки), по признаку на строку:
+//   holes -0.36
+//   lines 0.76
+// Признаки, которых нет в файле, получают вес 0.
+
+struct EvalWeights {
+    float values[EVAL_FEATURES];
+
+    // Веса, с которыми играет бот по умолчанию
+    static EvalWeights defaults() {
+        EvalWeights weights = EvalWeights();
+        weights.values[evalLines] = 0.76f;
+        weights.values[evalHeight] = -0.51f;
+        weights.values[evalHoles] = -0.36f;
+        weights.values[evalBumpiness] = -0.18f;
+        return weights;
+    }
+
+    static bool load(const char* path, EvalWeights* out) {
+        FILE* file = fopen(path, "r");
+        if (file == NULL) {
+            LOG_ERROR("Unable open weights: %s", path);
+            return false;
+        }
+        EvalWeights weights = EvalWeights();
+        char line[256];
+        int lineNumber = 0;
+        bool isValid = true;
+        while (isValid && fgets(line, sizeof(line), file) != NULL) {
+            lineNumber += 1;
+            char* comment = strstr(line, "//");
+            if (comment != NULL) { *comment = 0; }
+            char name[64];
+            float value = 0.0f;
+            int fields = sscanf(line, "%63s %f", name, &value);
+            if (fields <= 0) { continue; }
+
+            int feature = EvalWeights::findFeature(name);
+            isValid = fields == 2 && feature >= 0 && std::isfinite(value);
+            if (isValid) { weights.values[feature] = value; }
+        }
+        fclose(file);
+        if (!isValid) {
+            LOG_ERROR("Weights %s:%d: expected '<feature> <number>'", path, lineNumber);
+            return false;
+        }
+        *out = weights;
+        return true;
+    }
+
+    // В формате load; перечислены все признаки, в том числе с весом 0
+    void write(FILE* file) const {
+        for (int i = 0; i < EVAL_FEATURES; i++) {
+            fprintf(file, "%s %.9g\n", EVAL_FEATURE_NAMES[i], this->values[i]);
+        }
+    }
+
+    // -1 - такого признака нет
+    static int findFeature(const char* name) {
+        for (int i = 0; i < EVAL_FEATURES; i++) {
+            if (strcmp(name, EVAL_FEATURE_NAMES[i]) == 0) { return i; }
+        }
+        return -1;
+    }
+};
+
+// Ход в терминах TetroGame::placeShape
+struct PolicyMove {
+    int rotations;
+    int column;
+    float score;
+};
+
+// =============
+// PlacementPolicy: бот на один ход вперед. Перебирает все (поворот, столбец), которые
+// принимает placeShape, бросает фигуру на копии столбцов поля и выбирает ход с наибольшей
+// взвешенной суммой признаков. Столбцы - по 32-битному слову (бит y - клетка (x, y)), поэтому
+// падение, очистка строк и признаки считаются без копии TetroField.
+// Рабочие массивы внутри: у каждого потока своя политика.
+
+class PlacementPolicy {
+public:
+    EvalWeights weights;
+
+private:
+    int width;
+    uint32_t base[FIELD_W_MAX]; // столбцы поля до хода
+    uint32_t columns[FIELD_W_MAX]; // столбцы после пробного хода
+    int heights[FIELD_W_MAX];
+
+    // Первый y, с которого фигура уже не падает: от y вниз, пока все клетки свободны
+    int dropRow(const PieceOrientation& orientation, int x, int y) const {
+        uint32_t fits = EVAL_ROWS_MASK;
+        for (int dx = orientation.minX; dx <= orientation.maxX; dx++) {
+            uint32_t free = ~this->base[x + dx] & EVAL_ROWS_MASK;
+            uint32_t tiles = orientation.columnMasks[dx];
+            while (tiles != 0) {
+                fits &= free >> countTrailingZeros32(tiles);
+                tiles &= tiles - 1;
+            }
+        }
+        uint32_t run = fits >> y;
+        return y + countTrailingZeros32(~run) - 1;
+    }
+
+    // Убирает полные строки из this->columns, возвращает их число
+    int clearLines() {
+        uint32_t full = EVAL_ROWS_MASK;
+        for (int x = 0; x < this->width && full != 0; x++) {
+            full &= this->columns[x];
+        }
+        if (full == 0) { return 0; }
+        int lines = countBits32(full);
+        // Сверху вниз: строки выше убранной сдвигаются на одну вниз, нижние не меняются
+        while (full != 0) {
+            int row = countTrailingZeros32(full);
+            full &= full - 1;
+            uint32_t above = ((uint32_t) 1 << row) - 1;
+            for (int x = 0; x < this->width; x++) {
+                uint32_t column = this->columns[x];
+                this->columns[x] = (column & ~(above | ((uint32_t) 1 << row))) | ((column & above) << 1);
+            }
+        }
+        return lines;
+    }
+
+public:
+    PlacementPolicy(): PlacementPolicy(EvalWeights::defaults()) {}
+
+    explicit PlacementPolicy(const EvalWeights& weights): weights(weights), width(0), base(), columns(), heights() {}
+
+    // Признаки позиции this->columns; landingHeight и lines - от самого хода
+    void features(float landingHeight, int lines, float* out) {
+        for (int x = 0; x < this->width; x++) {
+            uint32_t column = this->columns[x];
+            this->heights[x] = column != 0 ? FIELD_H - countTrailingZeros32(column) : 0;
+        }
+        std::fill(out, out + EVAL_FEATURES, 0.0f);
+        out[evalLandingHeight] = landingHeight;
+        out[evalLines] = (float) lines;
+        int maxHeight = 0;
+        for (int x = 0; x < this->width; x++) {
+            int height = this->heights[x];
+            out[evalHeight] += (float) height;
+            maxHeight = std::max(maxHeight, height);
+            out[evalHoles] += (float) (height - countBits32(this->columns[x]));
+            if (x + 1 < this->width) { out[evalBumpiness] += (float) std::abs(height - this->heights[x + 1]); }
+            int left = x > 0 ? this->heights[x - 1] : FIELD_H;
+            int right = x + 1 < this->width ? this->heights[x + 1] : FIELD_H;
+            out[evalWells] += (float) std::max(0, std::min(left, right) - height);
+        }
+        out[evalMaxHeight] = (float) maxHeight;
+    }
+
+    // Лучший ход для активной фигуры. false - фигуры нет или ей некуда встать.
+    bool choose(TetroGame& game, PolicyMove* out) {
+        if (!game.activeShape.has_value()) { return false; }
+        const TetroActiveShape& shape = game.activeShape.value();
+        const PieceSet& pieces = PieceSet::active();
+        this->width = game.field.getWidth();
+        for (int x = 0; x < this->width; x++) {
+            this->base[x] = game.field.columnBits(x);
+        }
+
+        bool found = false;
+        float features[EVAL_FEATURES];
+        int orientations = pieces.orientations(shape.prototype.clazz);
+        for (int r = 0; r < orientations; r++) {
+            int minColumn = 0;
+            int maxColumn = 0;
+            if (!game.placementRange(r, &minColumn, &maxColumn)) { continue; }
+            const PieceOrientation& orientation = pieces.orientation(shape.prototype.clazz, shape.prototype.variant + r);
+
+            for (int column = minColumn; column <= maxColumn; column++) {
+                int x = column - orientation.minX;
+                int y = this->dropRow(orientation, x, shape.y);
+                // y < shape.y - фигура появилась поверх плиток, placeShape зафиксирует ее в скрытых строках
+                bool isLose = y < shape.y;
+                int lines = 0;
+                if (!isLose) {
+                    memcpy(this->columns, this->base, sizeof(this->base[0]) * this->width);
+                    for (int dx = orientation.minX; dx <= orientation.maxX; dx++) {
+                        this->columns[x + dx] |= orientation.columnMasks[dx] << y;
+                    }
+                    lines = this->clearLines();
+                }
+                for (int c = 0; c < this->width && !isLose; c++) {
+                    isLose = (this->columns[c] & EVAL_HIDDEN_MASK) != 0;
+                }
+
+                float score = EVAL_LOSS_SCORE;
+                if (!isLose) {
+                    float landingHeight = (float) (FIELD_H - y) - (float) (orientation.minY + orientation.maxY + 1) * 0.5f;
+                    this->features(landingHeight, lines, features);
+                    score = 0.0f;
+                    for (int i = 0; i < EVAL_FEATURES; i++) {
+                        score += this->weights.values[i] * features[i];
+                    }
+                }
+                if (!found || score > out->score) {
+                    *out = PolicyMove { r, column, score };
+                    found = true;
+                }
+            }
+        }
+        return found;
+    }
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "evaluator.cpp"
+
+#define VERSUS_PLAYERS 2
+
+struct VersusResult {
+    int winner; // игрок 0 или 1, -1 - ничья (проиграли в один ход или кончился лимит ходов)
+    int pieces; // ходов каждого игрока
+    int lines[VERSUS_PLAYERS];
+    int garbage[VERSUS_PLAYERS]; // мусорных строк отправлено сопернику
+};
+
+// =============
+// VersusMatch: партия двух ботов без времени. Игроки ходят в lockstep - оба ставят по фигуре,
+// затем мусор за очищенные линии уходит сопернику, как в NetFrameState::step.
+// Оба начинают с одного зерна: до первого мусора у них одинаковая очередь фигур.
+// Партии можно переигрывать в том же объекте - поля не выделяются заново.
+
+class VersusMatch {
+public:
+    TetroGame players[VERSUS_PLAYERS];
+
+    explicit VersusMatch(const GameConfig& config): players { TetroGame(config), TetroGame(config) } {}
+
+    VersusResult play(PlacementPolicy* policies[VERSUS_PLAYERS], uint32_t seed, int maxPieces) {
+        VersusResult result = VersusResult();
+        result.winner = -1;
+        for (auto& game : this->players) {
+            game.reset(seed);
+            game.spawnNextShape();
+        }
+
+        while (result.pieces < maxPieces) {
+            for (int p = 0; p < VERSUS_PLAYERS; p++) {
+                TetroGame& game = this->players[p];
+                PolicyMove move;
+                if (!policies[p]->choose(game, &move) || !game.placeShape(move.rotations, move.column)) {
+                    game.isLose = true;
+                }
+            }
+            result.pieces += 1;
+
+            int garbage0 = this->players[0].takeOutgoingGarbage();
+            int garbage1 = this->players[1].takeOutgoingGarbage();
+            if (garbage0 > 0) { this->players[1].raiseGarbage(garbage0); }
+            if (garbage1 > 0) { this->players[0].raiseGarbage(garbage1); }
+            result.garbage[0] += garbage0;
+            result.garbage[1] += garbage1;
+
+            bool isLose0 = this->players[0].isLose;
+            bool isLose1 = this->players[1].isLose;
+            if (isLose0 || isLose1) {
+                if (isLose0 != isLose1) { result.winner = isLose0 ? 1 : 0; }
+                break;
+            }
+        }
+
+        for (int p = 0; p < VERSUS_PLAYERS; p++) {
+            const TetroGame& game = this->players[p];
+            result.lines[p] = game.clearedTiles / game.field.getWidth();
+        }
+        return result;
+    }
+};
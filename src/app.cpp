@@ -1,17 +1,25 @@
+#include <algorithm>
 #include <stdexcept>
 #include <SDL2/SDL.h>
-#include <vector>
+#include <memory>
 #include <optional>
 #include "render/texture.cpp"
 #include "render/digit_draw.cpp"
-#include "tetromino.cpp"
+#include "render/tile_batch.cpp"
+#include "resources.cpp"
+#include "simulation.cpp"
+#include "latency_probe.cpp"
+#include "audio/mixer.cpp"
+#include "debug/alloc_counter.cpp"
 
-#define GAME_SPEED 1.0
-#define FALL_BASE_T 0.5
-
-#define VIEWABLE_FIELD_H 20
-#define VIEWABLE_FIELD_Y (FIELD_H - VIEWABLE_FIELD_H)
 #define TILE_SIZE 16
+// Сколько столбцов поля помещается на экране; на широком поле камера следует за фигурой
+#define VIEW_COLUMNS_MAX 20
+#define VIEW_COLUMNS_MARGIN 3
+// Сколько поток окна спит без событий: служебная работа (запись сохранения) ждет не дольше
+#define WINDOW_IDLE_WAIT_MS 250
+// Пока грузятся ассеты, загрузчик надо прокачивать часто
+#define WINDOW_LOADING_WAIT_MS 5
 
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
@@ -36,117 +44,72 @@ const int SCREEN_HEIGHT = 480;
 #define COL_PINK SDL_Color { 255, 0, 255, 255 }
 #define COL_PINK_DARK SDL_Color { 255, 0, 128, 255 }
 
-// ==============
-// Resources
-
-class Resources {
-public:
-    Texture texBlock;
-
-    Texture menuNewGame;
-    Texture menuExit;
-
-    Texture scoreText;
-    Texture digits;
-    Texture gameOver;
-
-    Resources(const Resources&) = delete;
-    Resources(Resources&&) = default;
-    ~Resources() = default;
+// =============
+// Split screen
+
+// Клавиши досок. Первый игрок - прежние клавиши; остальные рассчитаны на
+// аркадные кнопки, подключенные через клавиатурный энкодер.
+struct KeyBinding {
+    SDL_Keycode sym;
+    int board;
+    InputKey key;
 };
 
-Resources loadResources(SDL_Renderer* renderer) {
-    auto texBlock = Texture(renderer, "assets/textures/t-block-s.bmp");
-
-    auto menuNewGame = Texture(renderer, "assets/textures/menu/new-game.bmp");
-    auto menuExit = Texture(renderer, "assets/textures/menu/exit.bmp");
-
-    auto scoreText = Texture(renderer, "assets/textures/common_ui/score-l.bmp");
-    auto digits = Texture(renderer, "assets/textures/common_ui/digits.bmp");
-    auto gameOver = Texture(renderer, "assets/textures/common_ui/game-over.bmp");
-
-    return Resources {
-        std::move(texBlock),
-
-        std::move(menuNewGame),
-        std::move(menuExit),
-
-        std::move(scoreText),
-        std::move(digits),
-        std::move(gameOver)
-    };
+const KeyBinding KEY_BINDINGS[] = {
+    { SDLK_RIGHT, 0, InputKey::keyRight }, { SDLK_UP, 0, InputKey::keyUp }, { SDLK_LEFT, 0, InputKey::keyLeft }, { SDLK_DOWN, 0, InputKey::keyDown },
+    { SDLK_z, 0, InputKey::keyAction }, { SDLK_SPACE, 0, InputKey::keyAction }, { SDLK_RETURN, 0, InputKey::keyAction },
+    { SDLK_x, 0, InputKey::keyBack }, { SDLK_ESCAPE, 0, InputKey::keyBack },
+
+    { SDLK_d, 1, InputKey::keyRight }, { SDLK_w, 1, InputKey::keyUp }, { SDLK_a, 1, InputKey::keyLeft }, { SDLK_s, 1, InputKey::keyDown }, { SDLK_q, 1, InputKey::keyAction },
+    { SDLK_l, 2, InputKey::keyRight }, { SDLK_i, 2, InputKey::keyUp }, { SDLK_j, 2, InputKey::keyLeft }, { SDLK_k, 2, InputKey::keyDown }, { SDLK_u, 2, InputKey::keyAction },
+    { SDLK_KP_6, 3, InputKey::keyRight }, { SDLK_KP_8, 3, InputKey::keyUp }, { SDLK_KP_4, 3, InputKey::keyLeft }, { SDLK_KP_5, 3, InputKey::keyDown }, { SDLK_KP_0, 3, InputKey::keyAction },
+    { SDLK_h, 4, InputKey::keyRight }, { SDLK_t, 4, InputKey::keyUp }, { SDLK_f, 4, InputKey::keyLeft }, { SDLK_g, 4, InputKey::keyDown }, { SDLK_r, 4, InputKey::keyAction },
+    { SDLK_PAGEDOWN, 5, InputKey::keyRight }, { SDLK_HOME, 5, InputKey::keyUp }, { SDLK_DELETE, 5, InputKey::keyLeft }, { SDLK_END, 5, InputKey::keyDown }, { SDLK_INSERT, 5, InputKey::keyAction },
+    { SDLK_F4, 6, InputKey::keyRight }, { SDLK_F2, 6, InputKey::keyUp }, { SDLK_F1, 6, InputKey::keyLeft }, { SDLK_F3, 6, InputKey::keyDown }, { SDLK_F5, 6, InputKey::keyAction },
+    { SDLK_F9, 7, InputKey::keyRight }, { SDLK_F7, 7, InputKey::keyUp }, { SDLK_F6, 7, InputKey::keyLeft }, { SDLK_F8, 7, InputKey::keyDown }, { SDLK_F10, 7, InputKey::keyAction },
 };
 
-void destroyResources(SDL_Renderer* renderer, Resources* res) {
-
-}
-
-// ===========
-// InputState
-
-class KeyState {
-private:
-    bool f_isDown;
-    bool f_isPressed;
-
-public:
-    KeyState() {
-        this->f_isDown = false;
-        this->f_isPressed = false;
-    }
-
-    bool isDown() {
-        return this->f_isDown;
-    }
-
-    bool isUp() {
-        return !this->f_isDown;
-    }
-
-    bool isPressed() {
-        return this->f_isPressed;
-    }
-
-    void press() {
-        if (this->f_isDown) {
-            this->f_isDown = true;
-        } else {
-            this->f_isDown = true;
-            this->f_isPressed = true;
-        }
-    }
+// Область экрана под одну доску и размер плитки в ней
+struct BoardCell {
+    int x, y, w, h;
+    int tileSize;
+};
 
-    void release() {
-        this->f_isDown = false;
-        this->f_isPressed = false;
-    }
+// Где drawBoard разместил поле и счет: текст рисуется по этим координатам после плиток
+struct BoardLayout {
+    int tile;
+    int fieldX, fieldY, fieldW, fieldH;
+    int titleX, titleY;
+};
 
-    void update() {
-        if (this->f_isPressed) {
-            this->f_isPressed = false;
+// Доски раскладываются сеткой; число строк выбирается так, чтобы плитки были крупнее.
+// По ширине доске нужно поле и по панели (следующие фигуры, счет) с каждой стороны.
+BoardCell boardCell(int index, int boardsCount, int viewColumns) {
+    int bestRows = 1;
+    int bestTile = 0;
+    for (int rows = 1; rows <= boardsCount; rows++) {
+        int columns = (boardsCount + rows - 1) / rows;
+        int tile = std::min(
+                (SCREEN_WIDTH / columns) / (viewColumns + 12),
+                (SCREEN_HEIGHT / rows) / (VIEWABLE_FIELD_H + 2)
+        );
+        if (tile > bestTile) {
+            bestTile = tile;
+            bestRows = rows;
         }
     }
-};
 
-class InputState {
-public:
-    KeyState keyR; // right
-    KeyState keyU; // isUp
-    KeyState keyL; // left
-    KeyState keyD; // isDown
-    KeyState keyAction; // z or space
-    KeyState keyBack; // x or esc
-    bool exitRequired;
-
-    InputState():
-            keyR(KeyState()),
-            keyU(KeyState()),
-            keyL(KeyState()),
-            keyD(KeyState()),
-            keyAction(KeyState()),
-            keyBack(KeyState()),
-            exitRequired(false) {}
-};
+    int columns = (boardsCount + bestRows - 1) / bestRows;
+    int cellW = SCREEN_WIDTH / columns;
+    int cellH = SCREEN_HEIGHT / bestRows;
+    return BoardCell {
+        (index % columns) * cellW,
+        (index / columns) * cellH,
+        cellW,
+        cellH,
+        std::clamp(bestTile, 1, TILE_SIZE)
+    };
+}
 
 // =============
 // Application
@@ -157,14 +120,6 @@ SDL_Point point(int x, int y) {
     return SDL_Point { x, y };
 }
 
-enum AppState { menu = 0, game = 1 };
-
-enum MenuElement { newGame = 0, quit = 1 };
-
-enum CleaningMode { line = 0, color = 1 };
-
-enum ExtraTilesMode { off = 0, on = 1 };
-
 SDL_Color tileSdlColor(TetroColor color) {
     switch(color) {
         case TetroColor::red: return COL_RED;
@@ -176,55 +131,7 @@ SDL_Color tileSdlColor(TetroColor color) {
         case TetroColor::white: return COL_GRAY_LIGHT;
         case TetroColor::black: return COL_GRAY_DARK;
     }
-}
-
-void fillShapeBag(std::vector<TetroShapeClass>* bag) {
-    bag->clear();
-    TetroShapeClass base[7] = {
-            TetroShapeClass::L,
-//            TetroShapeClass::L,
-            TetroShapeClass::J,
-//            TetroShapeClass::J,
-            TetroShapeClass::I,
-//            TetroShapeClass::I,
-            TetroShapeClass::T,
-//            TetroShapeClass::T,
-            TetroShapeClass::O,
-//            TetroShapeClass::O,
-            TetroShapeClass::Z,
-//            TetroShapeClass::Z,
-            TetroShapeClass::S,
-//            TetroShapeClass::S
-    };
-    for (int i = 0; i < 7; i++) { bag->push_back(base[i]); }
-
-    for (int i = 0; i < 7; i++) {
-        int i1 = i;
-        int i2 = std::rand() % 7;
-
-        auto class1 = bag->at(i1);
-        auto class2 = bag->at(i2);
-
-        bag->at(i1) = class2;
-        bag->at(i2) = class1;
-    }
-}
-
-void fillColorBag(std::vector<TetroColor>* bag) {
-    bag->clear();
-    for (int i = 0; i < 6; i++) { bag->push_back(BASE_TILES[i]); }
-
-    int size = bag->size();
-    for (int i = 0; i < size; i++) {
-        int i1 = i;
-        int i2 = std::rand() % size;
-
-        auto class1 = bag->at(i1);
-        auto class2 = bag->at(i2);
-
-        bag->at(i1) = class2;
-        bag->at(i2) = class1;
-    }
+    return COL_GRAY_DARK;
 }
 
 class App {
@@ -233,60 +140,37 @@ public:
     SDL_Window* window;
     SDL_Renderer* renderer;
     Resources resources;
-
-    AppState __state;
-    InputState input;
-
-    // =================
-    // [menu state part]
-
-    MenuElement menuElement;
-    CleaningMode cleaningMode;
-    ExtraTilesMode extraTilesMode;
-
-    // [menu state part]
-    // =================
-    // [game state part]
-
-    TetroField field;
-    std::optional<TetroActiveShape> activeShape;
-    float tickAccDown;
-    float tickAccSide;
-    int score;
-    float gameSpeed;
-    std::vector<TetroShapeClass> shapeBag;
-    std::vector<TetroColor> colorBag;
-    bool isLose;
-
-    // [game state part]
-    // =================
+    std::unique_ptr<AssetLoader> assetLoader;
+
+    std::unique_ptr<Simulation> simulation;
+    std::unique_ptr<AudioMixer> audio; // NULL - без звука
+    const char* savePath;
+    bool redrawRequired;
+    bool isMinimized; // свернутое окно не рисуется
+    int viewColumns[BOARDS_MAX]; // первый видимый столбец поля каждой доски
+    TileBatch tileBatch;
+    LatencyProbe latencyProbe;
+    AllocationGuard allocationGuard;
 
     App() = delete;
     App(const App&) = delete;
     App(App&&) = default;
     ~App() = default;
 
-    App(SDL_Window* window, SDL_Renderer* renderer, Resources res):
+    App(SDL_Window* window, SDL_Renderer* renderer, std::unique_ptr<AssetLoader> assetLoader, GameConfig config):
             window(window),
             renderer(renderer),
-            resources(std::move(res)),
-            __state(AppState::menu),
-
-            // [menu]
-            menuElement(MenuElement::newGame),
-            cleaningMode(CleaningMode::line),
-            extraTilesMode(ExtraTilesMode::off),
-
-            // [game]
-            field(TetroField()),
-            activeShape(std::nullopt),
-            tickAccDown(0.0),
-            tickAccSide(0.0),
-            score(0),
-            gameSpeed(GAME_SPEED),
-            shapeBag(std::vector<TetroShapeClass>()),
-            colorBag(std::vector<TetroColor>()),
-            isLose(false)
+            resources(Resources()),
+            assetLoader(std::move(assetLoader)),
+            simulation(std::make_unique<Simulation>(config)),
+            audio(AudioMixer::open(config.volume)),
+            savePath(config.savePath),
+            redrawRequired(true),
+            isMinimized(false),
+            viewColumns(),
+            tileBatch(TileBatch()),
+            latencyProbe(LatencyProbe(config.measureLatency)),
+            allocationGuard(AllocationGuard("Render tick", ALLOCATION_WARMUP_TICKS))
     {}
 
     void drawTextureCopyColored(Texture& texture, SDL_Point point, SDL_Color color) {
@@ -294,314 +178,74 @@ public:
         SDL_Rect destRect = SDL_Rect { point.x, point.y, textureRect.w, textureRect.h };
 
         SDL_SetTextureColorMod(texture.sldHandle(), color.r, color.g, color.b);
-        SDL_RenderCopy(this->renderer, texture.sldHandle(), &textureRect, &destRect);
+        SDL_CHECK(SDL_RenderCopy(this->renderer, texture.sldHandle(), &textureRect, &destRect));
     }
 
     void drawTextureCopy(Texture& texture, SDL_Point point) {
         drawTextureCopyColored(texture, point, SDL_Color { 255, 255, 255, 255});
     }
 
-    TetroShapeClass nextShapeClass(bool remove) {
-        if (this->shapeBag.empty()) {
-            fillShapeBag(&this->shapeBag);
-        }
-
-        int last = this->shapeBag.size() - 1;
-        auto shapeClass = this->shapeBag.at(last);
-        if (remove) { this->shapeBag.pop_back(); }
-
-        return shapeClass;
-    }
-
-    TetroColor nextShapeColor(bool remove) {
-        if (this->colorBag.empty()) {
-            fillColorBag(&this->colorBag);
+    bool mapKey(SDL_Keycode sym, InputKey* key, int* board) {
+        for (auto& binding : KEY_BINDINGS) {
+            if (binding.sym == sym) {
+                *key = binding.key;
+                *board = binding.board;
+                return true;
+            }
         }
-
-        int last = this->colorBag.size() - 1;
-        auto shapeColor = this->colorBag.at(last);
-
-        if (remove) { this->colorBag.pop_back(); }
-
-        return shapeColor;
-    }
-
-    TetroShapePrototype peekNextShape() {
-        auto shapeClass = this->nextShapeClass(false);
-        auto shapeColor = this->nextShapeColor(false);
-        return TetroShapePrototype(shapeClass, 0, shapeColor);
+        return false;
     }
 
-    void spawnNextShape() {
-        auto shapeClass = this->nextShapeClass(true);
-        auto shapeColor = this->nextShapeColor(true);
-        this->activeShape = std::optional(
-            TetroActiveShape(
-                3,
-                0,
-                TetroShapePrototype(shapeClass, 0, shapeColor)
-            )
-        );
-    }
-
-    void resetGameState() {
-        this->tickAccDown = 0.0;
-        this->score = 0;
-        this->isLose = false;
-        this->activeShape = std::nullopt;
-        this->shapeBag.clear();
-        this->colorBag.clear();
-        this->field.clear();
-    }
-
-    void setMainState(AppState state) {
-        if (this->__state == state) {
-            printf("Change app __state to same");
-            exit(1);
-        }
-        if (this->__state == AppState::menu && state == AppState::game) {
-            this->__state = state;
-            this->resetGameState();
-        }
-        if (this->__state == AppState::game && state == AppState::menu) {
-            this->__state = state;
+    void pushInput(InputEventType type, InputKey key, Uint32 timestamp, int board) {
+        InputEvent inputEvent = InputEvent { type, key, timestamp, this->latencyProbe.stamp(), board };
+        if (!this->simulation->inputQueue.push(inputEvent)) {
+            LOG_WARN("Input queue overflow, event dropped");
         }
     }
 
-    void updateInput() {
-        {
-            this->input.keyAction.update();
-            this->input.keyBack.update();
-            this->input.keyR.update();
-            this->input.keyU.update();
-            this->input.keyL.update();
-            this->input.keyD.update();
-        }
-
+    // Поток окна только собирает события и передает их симуляции
+    void pollInput() {
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_QUIT) {
-                this->input.exitRequired = true;
-            } else if (event.type == SDL_KEYDOWN) {
-                if (event.key.keysym.sym == SDLK_z || event.key.keysym.sym == SDLK_SPACE || event.key.keysym.sym == SDLK_RETURN) { this->input.keyAction.press(); }
-                if (event.key.keysym.sym == SDLK_x || event.key.keysym.sym == SDLK_ESCAPE) { this->input.keyBack.press(); }
-                if (event.key.keysym.sym == SDLK_RIGHT) { this->input.keyR.press(); }
-                if (event.key.keysym.sym == SDLK_UP) { this->input.keyU.press(); }
-                if (event.key.keysym.sym == SDLK_LEFT) { this->input.keyL.press(); }
-                if (event.key.keysym.sym == SDLK_DOWN) { this->input.keyD.press(); }
-            } else if (event.type == SDL_KEYUP) {
-                if (event.key.keysym.sym == SDLK_z || event.key.keysym.sym == SDLK_SPACE || event.key.keysym.sym == SDLK_RETURN) { this->input.keyAction.release(); }
-                if (event.key.keysym.sym == SDLK_x || event.key.keysym.sym == SDLK_ESCAPE) { this->input.keyBack.release(); }
-                if (event.key.keysym.sym == SDLK_RIGHT) { this->input.keyR.release(); }
-                if (event.key.keysym.sym == SDLK_UP) { this->input.keyU.release(); }
-                if (event.key.keysym.sym == SDLK_LEFT) { this->input.keyL.release(); }
-                if (event.key.keysym.sym == SDLK_DOWN) { this->input.keyD.release(); }
-            } else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
-                this->input.keyAction.release();
-                this->input.keyBack.release();
-                this->input.keyR.release();
-                this->input.keyU.release();
-                this->input.keyL.release();
-                this->input.keyD.release();
-            }
+            this->handleEvent(event);
         }
     }
 
-    void updateStateMenu() {
-        if (this->input.keyBack.isPressed()) {
-            this->input.exitRequired = true;
-        }
-
-        if (this->input.keyAction.isPressed()) {
-            switch (this->menuElement) {
-                case MenuElement::newGame:
-                    this->setMainState(AppState::game);
-                    break;
-                case MenuElement::quit:
-                    this->input.exitRequired = true;
-                    break;
-                default:
-                    printf("UNREACHABLE\n");
-                    exit(1);
-            }
-        }
-
-        if (this->input.keyD.isPressed()) {
-            this->menuElement = static_cast<MenuElement>(this->menuElement < 1 ? this->menuElement + 1 : 1);
-        }
-        if (this->input.keyU.isPressed()) {
-            this->menuElement = static_cast<MenuElement>(this->menuElement > 0 ? this->menuElement - 1 : 0);
-        }
-    }
-
-    void updateStateGame(float dt) {
-        // Проверка выхода
-        if (this->input.keyBack.isPressed()) { this->setMainState(AppState::menu); return; }
-        // Проверка проигрыша
-        if (this->isLose) {
-            if (this->input.keyAction.isPressed()) {
-                this->resetGameState();
-            }
-            return;
-        }
-
-        // Определение управление фигурой
-        this->tickAccDown += dt;
-
-        if (this->tickAccSide > 0.0) {
-            this->tickAccSide -= dt;
-        }
-        auto tS = this->tickAccSide;
-        auto tD = this->tickAccDown;
-
-        float fallT = FALL_BASE_T / this->gameSpeed;
-        float forceFallT = fallT / 12.0;
-        float sideT = FALL_BASE_T / 8.0;
-
-        bool downPressed = this->input.keyD.isDown();
-        bool upPressed = this->input.keyU.isDown();
-        bool upJustPressed = this->input.keyU.isPressed();
-        bool leftPressed = this->input.keyL.isDown();
-        bool rightPressed = this->input.keyR.isDown();
-
-        bool handleMove = false;
-        bool resetT = false;
-        bool left = false;
-        bool right = false;
-        bool down = false;
-        bool rotate = false;
-
-        if (downPressed ? tD >= forceFallT : tD >= fallT) {
-            down = true;
-            handleMove = true;
-            resetT = true;
-        }
-
-        if (leftPressed && tS <= 0.0) {
-            left = true;
-            handleMove = true;
-            if (downPressed) { down = true; }
-        }
-
-        if (rightPressed && tS <= 0.0) {
-            right = true;
-            handleMove = true;
-            if (downPressed) { down = true; }
-        }
-
-        if (upJustPressed) {
-            rotate = true;
-        }
-
-        if (resetT) {
-            this->tickAccDown = 0.0;// this->tickAccDown - fallT * floor(this->tickAccDown / fallT); // Skipping many ticks on lag fix
-        }
-
-        // Обработка вращения фигуры
-        if (rotate && this->activeShape.has_value()) {
-            TetroActiveShape shape = this->activeShape.value();
-            auto rotatedPrototype = shape.prototype.rotated();
-            shape.prototype = rotatedPrototype;
-
-            if (shapeCanPlaced(shape)) {
-                this->activeShape.value() = shape;
-            }
-        }
-
-        // Обработка движения фигуры
-        if (handleMove) {
-            if(this->activeShape.has_value()) {
-                // handle down
-                {
-                    TetroActiveShape& shape = this->activeShape.value();
-                    TetroActiveShape movedShape = shape;
-                    if (down) { movedShape.y += 1; }
-
-                    bool canMove = this->shapeCanPlaced(movedShape);
-                    if(canMove) {
-                        this->activeShape.value() = movedShape;
-                    } else {
-                        // Здесь нам нужна еще не сдвинутая фигура.
-                        for (int i = 0; i < shape.prototype.tilesCount; i++) {
-                            int x = shape.x + shape.prototype.offsetsX[i];
-                            int y = shape.y + shape.prototype.offsetsY[i];
-                            this->field.set(x, y, std::optional(shape.prototype.color));
-                        }
-                        this->spawnNextShape();
-                    }
-                }
-                // handle left/right
-                {
-                    TetroActiveShape &shape = this->activeShape.value();
-                    TetroActiveShape movedShape = shape;
-                    if (left) { movedShape.x -= 1; }
-                    if (right) { movedShape.x += 1; }
-
-                    bool canMove = this->shapeCanPlaced(movedShape);
-                    if (canMove) {
-                        this->activeShape.value() = movedShape;
-                        this->tickAccSide = sideT;
-                    }
-                }
-            } else {
-                this->spawnNextShape();
-            }
-        }
-
-        // обработка полных линий
-        int removed = this->field.removeFullLines();
-        if (removed > 0) {
-            int dScore = 0;
-            switch (removed) {
-                case 1: dScore = 10 + 0; break;
-                case 2: dScore = 20 + 5; break;
-                case 3: dScore = 30 + 15; break;
-                case 4: dScore = 40 + 20; break;
-                default: dScore = 13 * removed; break;
-            }
-            this->score += dScore;
-        }
-
-        // Обработка проигрыша
-        {
-            bool isLose = false;
-            for (int y = 0; y < VIEWABLE_FIELD_Y; y++) {
-                if (!this->field.lineIsEmpty(y)) {
-                    isLose = true;
-                    break;
-                }
-            }
-            if (isLose) { this->isLose = true; }
+    // Ждет события: ввода, окна или нового снимка от симуляции (Simulation::wakeWindow)
+    void waitEvent() {
+        int timeout = this->assetLoader ? WINDOW_LOADING_WAIT_MS : WINDOW_IDLE_WAIT_MS;
+        SDL_Event event;
+        if (SDL_WaitEventTimeout(&event, timeout)) {
+            this->handleEvent(event);
         }
     }
 
-    // Game logic
-    void updateState(float dt) {
-        switch (this->__state) {
-            case AppState::menu:
-                this->updateStateMenu();
-                break;
-            case AppState::game:
-                this->updateStateGame(dt);
-                break;
-            default:
-                printf("UNREACHABLE\n");
-                exit(1);
+    void handleEvent(const SDL_Event& event) {
+        InputKey key;
+        int board;
+        if (event.type == SDL_QUIT) {
+            this->pushInput(InputEventType::quitRequested, InputKey::keyBack, event.common.timestamp, BOARD_ALL);
+        } else if (event.type == SDL_KEYDOWN) {
+            // Автоповтор ОС - не новое нажатие: повтор сдвига задают DAS/ARR, поворот - только по нажатию
+            if (event.key.repeat != 0) { return; }
+            if (this->mapKey(event.key.keysym.sym, &key, &board)) { this->pushInput(InputEventType::keyPressed, key, event.key.timestamp, board); }
+        } else if (event.type == SDL_KEYUP) {
+            if (this->mapKey(event.key.keysym.sym, &key, &board)) { this->pushInput(InputEventType::keyReleased, key, event.key.timestamp, board); }
+        } else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+            this->pushInput(InputEventType::focusLost, InputKey::keyBack, event.window.timestamp, BOARD_ALL);
+        } else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_EXPOSED) {
+            this->redrawRequired = true;
+        } else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_MINIMIZED) {
+            this->isMinimized = true;
+        } else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_RESTORED) {
+            this->isMinimized = false;
+            this->redrawRequired = true;
         }
     }
 
-    bool shapeCanPlaced(TetroActiveShape& shape) {
-        int count = shape.prototype.tilesCount;
-        for (int i = 0; i < count; i++) {
-            int x = shape.x + shape.prototype.offsetsX[i];
-            int y = shape.y + shape.prototype.offsetsY[i];
-            if (x < 0 || x >= FIELD_W || y < 0 || y >= FIELD_H) { return false; }
-            if (this->field.getAssured(x, y)->has_value()) { return false; }
-        }
-        return true;
-    }
+    void drawMenu(const GameSnapshot& snapshot) {
+        if (!this->resources.menuLoaded()) { return; }
 
-    void drawMenu() {
         auto activeColor = COL_WHITE;
         auto unActiveColor = COL_GRAY;
 
@@ -609,156 +253,237 @@ public:
         auto baseY = (SCREEN_HEIGHT - 32 * 2) / 2;
 
         {
-            auto color = this->menuElement == MenuElement::newGame ? activeColor : unActiveColor;
+            auto color = snapshot.menuElement == MenuElement::newGame ? activeColor : unActiveColor;
             this->drawTextureCopyColored(this->resources.menuNewGame, point(baseX, baseY + 32*0), color);
         }
 
         {
-            auto color = this->menuElement == MenuElement::quit ? activeColor : unActiveColor;
+            auto color = snapshot.menuElement == MenuElement::quit ? activeColor : unActiveColor;
             this->drawTextureCopyColored(this->resources.menuExit, point(baseX, baseY + 32*1), color);
         }
     }
 
-    void drawDynamicShape(TetroShapePrototype shape, int x, int y, int clipping) {
+    // clippingRow - строки фигуры до этой включительно не рисуются (скрытая часть поля)
+    void batchShape(const TetroShapePrototype& shape, int x, int y, int tileSize, int clippingRow) {
         for(int i = 0; i < shape.tilesCount; i++) {
             int xp = shape.offsetsX[i];
             int yp = shape.offsetsY[i];
-            if (yp <= clipping) { continue; }
-            this->drawTextureCopyColored(
-                    this->resources.texBlock,
-                    point(x + xp * TILE_SIZE, y + yp * TILE_SIZE),
-                    tileSdlColor(shape.color)
-            );
+            if (yp <= clippingRow) { continue; }
+            SDL_Rect rect = SDL_Rect { x + xp * tileSize, y + yp * tileSize, tileSize, tileSize };
+            this->tileBatch.addTile(this->renderer, this->resources.texBlock, rect, tileSdlColor(shape.color));
         }
     }
 
-    void drawDynamicShape(TetroShapePrototype shape, int x, int y) {
-        drawDynamicShape(shape, x, y, -2000000000);
+    // Плитка превью: фигура с квадратом больше 4x4 уменьшается, чтобы влезть в рамку 4x4
+    static int previewTileSize(const TetroShapePrototype& shape, int tileSize) {
+        int boxSize = PieceSet::active().classes[shape.clazz].boxSize;
+        return std::max(tileSize * 4 / std::max(boxSize, 4), 1);
     }
 
-    void drawGame() {
-
-        int fieldMinX = SCREEN_WIDTH / 2 - TILE_SIZE*FIELD_W / 2;
-        int fieldMinY = SCREEN_HEIGHT / 2 - TILE_SIZE*VIEWABLE_FIELD_H / 2;
-        int fieldW = TILE_SIZE * FIELD_W;
-        int fieldH = TILE_SIZE * VIEWABLE_FIELD_H;
-        {
-            int x1 = fieldMinX - 1;
-            int y1 = fieldMinY - 1;
-            int x2 = fieldMinX + fieldW;
-            int y2 = fieldMinY + fieldH;
-            SDL_SetRenderDrawColor(this->renderer, 128, 128, 128, 255);
-            SDL_RenderDrawLine(this->renderer, x1, y1, x1, y2);
-            SDL_RenderDrawLine(this->renderer, x1, y1, x2, y1);
-            SDL_RenderDrawLine(this->renderer, x2, y2, x1, y2);
-            SDL_RenderDrawLine(this->renderer, x2, y2, x2, y1);
-            SDL_SetRenderDrawColor(this->renderer, 0, 0, 0, 255);
+    // Сдвигает камеру доски так, чтобы активная фигура была видна с запасом по краям
+    void updateViewColumn(const BoardSnapshot& board, int boardIndex, int viewColumns) {
+        int& viewColumn = this->viewColumns[boardIndex];
+        if (board.activeShape.has_value()) {
+            const TetroActiveShape& shape = board.activeShape.value();
+            int shapeMinX = shape.x + shape.prototype.orientation().minX;
+            int shapeMaxX = shape.x + shape.prototype.orientation().maxX;
+            if (shapeMinX - VIEW_COLUMNS_MARGIN < viewColumn) {
+                viewColumn = shapeMinX - VIEW_COLUMNS_MARGIN;
+            }
+            if (shapeMaxX + VIEW_COLUMNS_MARGIN >= viewColumn + viewColumns) {
+                viewColumn = shapeMaxX + VIEW_COLUMNS_MARGIN - viewColumns + 1;
+            }
         }
+        viewColumn = std::clamp(viewColumn, 0, board.field.getWidth() - viewColumns);
+    }
+
+    // Плитки и рамки доски уходят в общую пачку; текст - потом, drawBoardText по *layout
+    void drawBoard(const BoardSnapshot& board, int boardIndex, const BoardCell& cell, BoardLayout* layout) {
+        int tile = cell.tileSize;
+        int viewColumns = std::min(board.field.getWidth(), VIEW_COLUMNS_MAX);
+        this->updateViewColumn(board, boardIndex, viewColumns);
+        int viewColumn = this->viewColumns[boardIndex];
+
+        int fieldW = tile * viewColumns;
+        int fieldH = tile * VIEWABLE_FIELD_H;
+        int fieldMinX = cell.x + cell.w / 2 - fieldW / 2;
+        int fieldMinY = cell.y + cell.h / 2 - fieldH / 2;
+        this->tileBatch.addFrame(fieldMinX, fieldMinY, fieldW, fieldH);
 
         // xp, yp - Визуальные координаты поля
         // xi, yi - Координаты в массиве поля
-        for (int xp = 0; xp < FIELD_W; xp++) {
-            for (int yp = 0; yp < VIEWABLE_FIELD_H; yp++) {
-                int xi = xp;
-                int yi = yp + VIEWABLE_FIELD_Y;
-
-                auto tileOpt = this->field.getAssured(xi, yi);
-                if (!tileOpt->has_value()) { continue; }
-                auto tile = tileOpt->value();
-
-                auto sdlColor = tileSdlColor(tile);
-                this->drawTextureCopyColored(
-                    this->resources.texBlock,
-                    point(fieldMinX + xp * TILE_SIZE, fieldMinY + yp * TILE_SIZE),
-                    sdlColor
-                );
+        // Рисуются только видимые столбцы, пустые строки пропускаются целиком
+        for (int yp = 0; yp < VIEWABLE_FIELD_H; yp++) {
+            int yi = yp + VIEWABLE_FIELD_Y;
+            if (board.field.lineIsEmpty(yi)) { continue; }
+
+            for (int xp = 0; xp < viewColumns; xp++) {
+                int xi = xp + viewColumn;
+
+                if (!board.field.isFilled(xi, yi)) { continue; }
+                TetroColor color = board.field.getAssured(xi, yi).value();
+
+                SDL_Rect rect = SDL_Rect { fieldMinX + xp * tile, fieldMinY + yp * tile, tile, tile };
+                this->tileBatch.addTile(this->renderer, this->resources.texBlock, rect, tileSdlColor(color));
             }
         }
 
-        if (this->activeShape.has_value()) {
-            auto shape = this->activeShape.value();
-            auto x = fieldMinX + shape.x * TILE_SIZE;
-            auto y = fieldMinY + (shape.y - VIEWABLE_FIELD_Y) * TILE_SIZE;
-            drawDynamicShape(shape.prototype, x, y, VIEWABLE_FIELD_Y - shape.y - 1);
-//            drawDynamicShape(shape.prototype, x, y);
+        // Подсказка под активной фигурой: та перекрывает ее, когда доведена до места
+        if (board.hintShape.has_value()) {
+            const TetroActiveShape& hint = board.hintShape.value();
+            auto x = fieldMinX + (hint.x - viewColumn) * tile;
+            auto y = fieldMinY + (hint.y - VIEWABLE_FIELD_Y) * tile;
+            batchShape(hint.prototype, x, y, tile, VIEWABLE_FIELD_Y - hint.y - 1);
+        }
+
+        if (board.activeShape.has_value()) {
+            const TetroActiveShape& shape = board.activeShape.value();
+            auto x = fieldMinX + (shape.x - viewColumn) * tile;
+            auto y = fieldMinY + (shape.y - VIEWABLE_FIELD_Y) * tile;
+            batchShape(shape.prototype, x, y, tile, VIEWABLE_FIELD_Y - shape.y - 1);
         }
 
         // next shape
-        auto nextShape = this->peekNextShape();
-        int shapeX = fieldMinX + fieldW + 16;
-        int shapeY = fieldMinY + 16;
-        int shapeW = TILE_SIZE * 4;
-        int shapeH = TILE_SIZE * 4;
+        int shapeX = fieldMinX + fieldW + tile;
+        int shapeY = fieldMinY + tile;
+        int shapeW = tile * 4;
+        int shapeH = tile * 4;
 
-        drawDynamicShape(nextShape, shapeX, shapeY);
-        {
-            int x1 = shapeX - 1;
-            int y1 = shapeY - 1;
-            int x2 = shapeX + shapeW;
-            int y2 = shapeY + shapeH;
-            SDL_SetRenderDrawColor(this->renderer, 128, 128, 128, 255);
-            SDL_RenderDrawLine(this->renderer, x1, y1, x1, y2);
-            SDL_RenderDrawLine(this->renderer, x1, y1, x2, y1);
-            SDL_RenderDrawLine(this->renderer, x2, y2, x1, y2);
-            SDL_RenderDrawLine(this->renderer, x2, y2, x2, y1);
-            SDL_SetRenderDrawColor(this->renderer, 0, 0, 0, 255);
+        if (!board.nextShapes.empty()) {
+            const TetroShapePrototype& next = board.nextShapes.at(0);
+            batchShape(next, shapeX, shapeY, previewTileSize(next, tile), -1);
         }
+        this->tileBatch.addFrame(shapeX, shapeY, shapeW, shapeH);
 
-        // score
+        // Место под счет; текстуры рассчитаны на TILE_SIZE и масштабируются вместе с плиткой
         int titleX = shapeX;
         int titleY = shapeY + shapeH;
-        SDL_Rect dstRect = SDL_Rect{titleX, titleY, 80, 32};
-        SDL_RenderCopy(this->renderer, this->resources.scoreText.sldHandle(), NULL, &dstRect);
+        int scoreY = titleY + 32 * tile / TILE_SIZE;
+        int digitH = DIGIT_TEX_H * tile / TILE_SIZE;
+        *layout = BoardLayout { tile, fieldMinX, fieldMinY, fieldW, fieldH, titleX, titleY };
+
+        // остальные фигуры очереди - мельче, в две колонки под счетом
+        {
+            int smallTile = std::max(tile / 2, 1);
+            int smallSize = smallTile * 4;
+            int step = smallSize + smallTile;
+            int baseY = scoreY + digitH + tile;
+            for (int i = 1; i < board.nextShapes.size(); i++) {
+                int column = (i - 1) % 2;
+                int row = (i - 1) / 2;
+                int x = shapeX + column * step;
+                int y = baseY + row * step;
+                const TetroShapePrototype& next = board.nextShapes.at(i);
+                batchShape(next, x, y, previewTileSize(next, smallTile), -1);
+                this->tileBatch.addFrame(x, y, smallSize, smallSize);
+            }
+        }
+    }
 
-        int scoreX = titleX + 0;
-        int scoreY = titleY + 32;
-        drawNumber(this->renderer, &this->resources.digits, scoreX, scoreY, this->score, 3);
+    // Счет и надпись о проигрыше - после сброса пачки плиток, иначе плитки легли бы поверх
+    void drawBoardText(const BoardSnapshot& board, const BoardLayout& layout) {
+        int tile = layout.tile;
+        SDL_Rect dstRect = SDL_Rect{layout.titleX, layout.titleY, 80 * tile / TILE_SIZE, 32 * tile / TILE_SIZE};
+        SDL_CHECK(SDL_RenderCopy(this->renderer, this->resources.scoreText.sldHandle(), NULL, &dstRect));
+
+        int digitW = DIGIT_TEX_W * tile / TILE_SIZE;
+        int digitH = DIGIT_TEX_H * tile / TILE_SIZE;
+        int scoreX = layout.titleX + 0;
+        int scoreY = layout.titleY + dstRect.h;
+        drawNumber(this->renderer, &this->resources.digits, scoreX, scoreY, board.score, 3, digitW, digitH);
 
         // lose
-        if (this->isLose) {
-            int w = 80;
-            int h = 64;
-            int x = SCREEN_WIDTH / 2 - w / 2;
-            int y = SCREEN_HEIGHT / 2 - h / 2;
-
-            SDL_Rect dstRect = SDL_Rect { x, y, w, h };
-            SDL_RenderCopy(this->renderer, this->resources.gameOver.sldHandle(), NULL, &dstRect);
+        if (board.isLose) {
+            int w = 80 * tile / TILE_SIZE;
+            int h = 64 * tile / TILE_SIZE;
+            int x = layout.fieldX + layout.fieldW / 2 - w / 2;
+            int y = layout.fieldY + layout.fieldH / 2 - h / 2;
+
+            SDL_Rect loseRect = SDL_Rect { x, y, w, h };
+            SDL_CHECK(SDL_RenderCopy(this->renderer, this->resources.gameOver.sldHandle(), NULL, &loseRect));
+        }
+    }
+
+    void drawGame(const GameSnapshot& snapshot) {
+        int viewColumns = std::min(snapshot.boards[0].field.getWidth(), VIEW_COLUMNS_MAX);
+        BoardLayout layouts[BOARDS_MAX];
+        for (int i = 0; i < snapshot.boardsCount; i++) {
+            BoardCell cell = boardCell(i, snapshot.boardsCount, viewColumns);
+            this->drawBoard(snapshot.boards[i], i, cell, &layouts[i]);
+        }
+        // Все плитки всех досок - одним вызовом, текст - поверх них
+        this->tileBatch.flush(this->renderer, this->resources.texBlock, COL_GRAY);
+        for (int i = 0; i < snapshot.boardsCount; i++) {
+            this->drawBoardText(snapshot.boards[i], layouts[i]);
         }
     }
 
-    void drawState() {
-        SDL_RenderClear(this->renderer);
+    void drawState(const GameSnapshot& snapshot) {
+        SDL_CHECK(SDL_RenderClear(this->renderer));
 
-        switch (this->__state) {
+        switch (snapshot.state) {
             case AppState::menu:
-                this->drawMenu();
+                this->drawMenu(snapshot);
                 break;
             case AppState::game:
-                this->drawGame();
+                this->drawGame(snapshot);
                 break;
         }
 
         SDL_RenderPresent(this->renderer);
+        this->latencyProbe.presented(snapshot.inputStamps);
+    }
+
+    // While true: Do render loop. Game logic runs on simulation thread.
+    void updateResources() {
+        if (!this->assetLoader) { return; }
+
+        if (this->assetLoader->pump(this->renderer, &this->resources)) {
+            this->redrawRequired = true;
+        }
+        if (this->assetLoader->isFinished()) {
+            this->assetLoader.reset();
+            this->simulation->gameAssetsReady = true;
+        }
     }
 
-    // While true: Do game loop
-    bool tick(float dt) {
-        updateInput();
-        updateState(dt);
-        drawState();
+    void writeSave() {
+        if (this->savePath != NULL && this->simulation->saves.fetch()) {
+            writeSaveFile(this->savePath, this->simulation->saves.readBuffer());
+        }
+    }
+
+    bool tick() {
+        this->allocationGuard.beginTick();
+
+        pollInput();
+        updateResources();
 
-        auto error = SDL_GetError();
-        if (error && strcmp(error, "") != 0) {
-            printf("> SDL ERROR: %s\n", error);
+        this->writeSave();
+
+        // Свернутое окно не рисует и не сбрасывает wakePending: симуляция его больше не будит
+        if (!this->isMinimized) {
+            this->simulation->wakePending = false;
+            bool hasNewSnapshot = this->simulation->snapshots.fetch();
+            if (hasNewSnapshot || this->redrawRequired) {
+                drawState(this->simulation->snapshots.readBuffer());
+                this->redrawRequired = false;
+            }
         }
 
-        return !this->input.exitRequired;
+        // Симуляция отдает снимок, только когда на экране что-то изменилось,
+        // поэтому в меню и после конца партии поток окна спит
+        if (!this->simulation->exitRequired) { this->waitEvent(); }
+
+        this->allocationGuard.endTick();
+        return !this->simulation->exitRequired;
     }
 };
 
-App Tetris_initApplication() {
+App Tetris_initApplication(GameConfig config) {
+    Logger::get(); // поток логгера стартует до всех остальных потоков
     if(SDL_Init( SDL_INIT_VIDEO | SDL_INIT_AUDIO ) < 0) {
-        printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+        LOG_ERROR("SDL could not initialize! SDL_Error: %s", SDL_GetError());
         throw std::runtime_error("Unable init SDL");
     }
 
@@ -766,18 +491,35 @@ App Tetris_initApplication() {
     SDL_Renderer* renderer;
     auto createWindow = SDL_CreateWindowAndRenderer(SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN, &window, &renderer);
     if(createWindow) {
-        printf( "Window could not be created! SDL_Error: %s\n", SDL_GetError() );
+        LOG_ERROR("Window could not be created! SDL_Error: %s", SDL_GetError());
         throw std::runtime_error("Unable create Window");
     }
     SDL_SetWindowTitle(window, "TetrisSDL");
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
 
-    auto resources = loadResources(renderer);
+    // Не ждем загрузки: меню покажется, как только будут готовы его текстуры
+    auto assetLoader = startLoadResources(config);
 
-    return App(window, renderer, std::move(resources));
+    auto app = App(window, renderer, std::move(assetLoader), config);
+    if (config.savePath != NULL) {
+        auto save = std::make_unique<SaveBlob>();
+        if (readSaveFile(config.savePath, save.get()) && app.simulation->resume(*save, config)) {
+            LOG_INFO("Resuming game from %s", config.savePath);
+        }
+    }
+    app.simulation->audio = app.audio.get();
+    app.simulation->wakeEventType = SDL_RegisterEvents(1);
+    app.simulation->start();
+    return app;
 }
 
 void Tetris_closeApplication(App* app) {
+    app->simulation->stop();
+    app->audio.reset();
+    app->writeSave();
+    app->assetLoader.reset();
+    app->latencyProbe.report();
+    app->simulation->report();
     destroyResources(app->renderer, &app->resources);
 
     SDL_DestroyWindow(app->window);
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <SDL2/SDL.h>
+#include "../log.cpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// =================================================
+// Формат архива ассетов (пишется asset_packer, читается игрой):
+//   AssetArchiveHeader
+//   AssetArchiveEntry[entriesCount]
+//   пиксели каждой текстуры, уже в формате рендера, выровнены на ASSET_ARCHIVE_ALIGN
+
+#define ASSET_ARCHIVE_MAGIC 0x4B415054 // "TPAK"
+#define ASSET_ARCHIVE_VERSION 1
+#define ASSET_ARCHIVE_ALIGN 64
+#define ASSET_NAME_SIZE 56
+
+#define ASSET_FLAG_BLEND 1
+
+struct AssetArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entriesCount;
+    uint32_t reserved;
+};
+
+struct AssetArchiveEntry {
+    char name[ASSET_NAME_SIZE]; // путь относительно assets/, например "textures/t-block-s.bmp"
+    uint32_t pixelFormat; // SDL_PIXELFORMAT_*
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t offset; // от начала архива
+    uint64_t size;
+};
+
+static_assert(sizeof(AssetArchiveHeader) == 16, "AssetArchiveHeader layout");
+static_assert(sizeof(AssetArchiveEntry) == 96, "AssetArchiveEntry layout");
+
+// =============
+// AssetArchive: архив, отображенный в память. Текстуры создаются прямо из отображенных пикселей.
+
+class AssetArchive {
+private:
+    const uint8_t* data;
+    size_t dataSize;
+    bool isMapped;
+    bool isOwned; // буфер выделен нами (чтение без mmap)
+
+    const AssetArchiveHeader* header() const {
+        return (const AssetArchiveHeader*) this->data;
+    }
+
+    const AssetArchiveEntry* entries() const {
+        return (const AssetArchiveEntry*) (this->data + sizeof(AssetArchiveHeader));
+    }
+
+    void validate(const char* path) {
+        if (this->dataSize < sizeof(AssetArchiveHeader)) {
+            LOG_ERROR("Asset archive %s is truncated", path);
+            throw std::runtime_error("Invalid asset archive");
+        }
+        auto h = this->header();
+        if (h->magic != ASSET_ARCHIVE_MAGIC || h->version != ASSET_ARCHIVE_VERSION) {
+            LOG_ERROR("Asset archive %s has unknown format (magic %08x, version %u)", path, h->magic, h->version);
+            throw std::runtime_error("Invalid asset archive");
+        }
+        uint64_t indexEnd = sizeof(AssetArchiveHeader) + (uint64_t) h->entriesCount * sizeof(AssetArchiveEntry);
+        if (indexEnd > this->dataSize) {
+            LOG_ERROR("Asset archive %s index is truncated", path);
+            throw std::runtime_error("Invalid asset archive");
+        }
+        for (uint32_t i = 0; i < h->entriesCount; i++) {
+            auto& entry = this->entries()[i];
+            bool nameTerminated = memchr(entry.name, '\0', ASSET_NAME_SIZE) != NULL;
+            bool inBounds = entry.offset <= this->dataSize && entry.size <= this->dataSize - entry.offset;
+            bool sizeMatches = (uint64_t) entry.pitch * entry.height <= entry.size;
+            if (!nameTerminated || !inBounds || !sizeMatches) {
+                LOG_ERROR("Asset archive %s entry %u is corrupted", path, i);
+                throw std::runtime_error("Invalid asset archive");
+            }
+        }
+    }
+
+public:
+    // Архив, встроенный в исполняемый файл: ни одного обращения к диску
+    AssetArchive(const void* data, size_t size): data((const uint8_t*) data), dataSize(size), isMapped(false), isOwned(false) {
+        this->validate("<embedded>");
+    }
+
+    explicit AssetArchive(const char* path): data(NULL), dataSize(0), isMapped(false), isOwned(false) {
+#ifndef _WIN32
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            LOG_ERROR("Unable open asset archive: %s", path);
+            throw std::runtime_error("Error on open asset archive");
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            close(fd);
+            LOG_ERROR("Unable stat asset archive: %s", path);
+            throw std::runtime_error("Error on open asset archive");
+        }
+        void* mapped = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            LOG_ERROR("Unable mmap asset archive: %s", path);
+            throw std::runtime_error("Error on mmap asset archive");
+        }
+        this->data = (const uint8_t*) mapped;
+        this->dataSize = (size_t) st.st_size;
+        this->isMapped = true;
+#else
+        // Без mmap: одно чтение файла целиком
+        auto rw = SDL_RWFromFile(path, "rb");
+        if (rw == NULL) {
+            LOG_ERROR("Unable open asset archive: %s (SDL error: %s)", path, SDL_GetError());
+            throw std::runtime_error("Error on open asset archive");
+        }
+        auto size = SDL_RWsize(rw);
+        auto buf = (uint8_t*) malloc(size > 0 ? (size_t) size : 1);
+        if (size <= 0 || SDL_RWread(rw, buf, 1, (size_t) size) != (size_t) size) {
+            SDL_RWclose(rw);
+            free(buf);
+            LOG_ERROR("Unable read asset archive: %s", path);
+            throw std::runtime_error("Error on read asset archive");
+        }
+        SDL_RWclose(rw);
+        this->data = buf;
+        this->dataSize = (size_t) size;
+        this->isOwned = true;
+#endif
+        this->validate(path);
+    }
+
+    ~AssetArchive() {
+        if (this->data == NULL) { return; }
+#ifndef _WIN32
+        if (this->isMapped) { munmap((void*) this->data, this->dataSize); }
+#endif
+        if (this->isOwned) { free((void*) this->data); }
+        this->data = NULL;
+    }
+
+    AssetArchive(const AssetArchive&) = delete;
+
+    const AssetArchiveEntry* find(const char* name) const {
+        auto count = this->header()->entriesCount;
+        for (uint32_t i = 0; i < count; i++) {
+            if (strcmp(this->entries()[i].name, name) == 0) {
+                return &this->entries()[i];
+            }
+        }
+        return NULL;
+    }
+
+    const AssetArchiveEntry& findAssured(const char* name) const {
+        auto entry = this->find(name);
+        if (entry == NULL) {
+            LOG_ERROR("Asset %s not found in archive", name);
+            throw std::runtime_error("Asset not found");
+        }
+        return *entry;
+    }
+
+    // Подтягивает страницы записи в память заранее (на медленном носителе это основное время)
+    void prefetch(const AssetArchiveEntry& entry) const {
+        const volatile uint8_t* bytes = this->data + entry.offset;
+        uint8_t sum = 0;
+        for (uint64_t i = 0; i < entry.size; i += 4096) {
+            sum += bytes[i];
+        }
+        (void) sum;
+    }
+
+    const void* pixels(const AssetArchiveEntry& entry) const {
+        return this->data + entry.offset;
+    }
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <SDL2/SDL.h>
+#include "../log.cpp"
+#include "../game.cpp"
+#include "../concurrent/spsc_queue.cpp"
+
+#define AUDIO_FREQUENCY 48000
+// Сэмплов в буфере устройства: 256 при 48 кГц - 5.3 мс от события до звука плюс буфер драйвера
+#define AUDIO_BUFFER_SAMPLES 256
+// Одновременно звучащих эффектов; новый эффект вытесняет самый старый
+#define AUDIO_VOICES 16
+#define AUDIO_TRIGGER_QUEUE_SIZE 64
+
+enum SoundEffect { soundMove = 0, soundRotate = 1, soundLock = 2, soundClear = 3, soundGameOver = 4 };
+#define SOUND_EFFECTS 5
+
+// Звук - отрезок PCM моно float, готовый для устройства (частота устройства)
+struct SoundClip {
+    std::vector<float> samples;
+};
+
+// Тон с частотой от startHz до endHz, огибающая - быстрая атака и экспоненциальное затухание
+void synthesizeTone(std::vector<float>* out, int frequency, float seconds, float startHz, float endHz, float gain, bool isSquare) {
+    size_t first = out->size();
+    int count = (int) (seconds * (float) frequency);
+    out->resize(first + count);
+    float phase = 0.0f;
+    for (int i = 0; i < count; i++) {
+        float t = (float) i / (float) count;
+        float hz = startHz + (endHz - startHz) * t;
+        phase += hz / (float) frequency;
+        phase -= std::floor(phase);
+        float wave = isSquare ? (phase < 0.5f ? 1.0f : -1.0f) * 0.5f : std::sin(phase * 6.2831853f);
+        float attack = std::min(1.0f, (float) i / (0.002f * (float) frequency));
+        float envelope = attack * std::exp(-4.0f * t);
+        (*out)[first + i] = wave * envelope * gain;
+    }
+}
+
+// Эффекты генерируются при запуске, в ассетах звуков нет
+void synthesizeClips(SoundClip clips[SOUND_EFFECTS], int frequency) {
+    synthesizeTone(&clips[SoundEffect::soundMove].samples, frequency, 0.025f, 1100.0f, 1000.0f, 0.15f, true);
+    synthesizeTone(&clips[SoundEffect::soundRotate].samples, frequency, 0.045f, 800.0f, 1400.0f, 0.18f, true);
+    synthesizeTone(&clips[SoundEffect::soundLock].samples, frequency, 0.09f, 180.0f, 90.0f, 0.5f, false);
+    synthesizeTone(&clips[SoundEffect::soundClear].samples, frequency, 0.07f, 660.0f, 660.0f, 0.3f, false);
+    synthesizeTone(&clips[SoundEffect::soundClear].samples, frequency, 0.07f, 830.0f, 830.0f, 0.3f, false);
+    synthesizeTone(&clips[SoundEffect::soundClear].samples, frequency, 0.12f, 990.0f, 990.0f, 0.3f, false);
+    synthesizeTone(&clips[SoundEffect::soundGameOver].samples, frequency, 0.8f, 600.0f, 120.0f, 0.35f, true);
+}
+
+// =============
+// AudioMixer: эффекты смешиваются в callback устройства SDL. Поток симуляции кладет
+// запросы в SPSC-очередь; callback забирает их в начале каждого буфера, так что в нем
+// нет ни блокировок, ни выделений памяти.
+
+class AudioMixer {
+private:
+    struct Voice {
+        const float* samples; // NULL - голос свободен
+        int length;
+        int position;
+    };
+
+    SDL_AudioDeviceID device;
+    float volume;
+    SoundClip clips[SOUND_EFFECTS];
+    SpscQueue<uint8_t, AUDIO_TRIGGER_QUEUE_SIZE> triggers;
+
+    // [audio thread only]
+    Voice voices[AUDIO_VOICES];
+
+    static void audioCallback(void* userdata, Uint8* stream, int len) {
+        ((AudioMixer*) userdata)->mix((float*) stream, len / (int) sizeof(float));
+    }
+
+    void startVoice(const SoundClip& clip) {
+        int chosen = 0;
+        for (int i = 0; i < AUDIO_VOICES; i++) {
+            if (this->voices[i].samples == NULL) { chosen = i; break; }
+            if (this->voices[i].position > this->voices[chosen].position) { chosen = i; }
+        }
+        this->voices[chosen] = Voice { clip.samples.data(), (int) clip.samples.size(), 0 };
+    }
+
+    void mix(float* out, int frames) {
+        uint8_t effect;
+        while (this->triggers.pop(&effect)) {
+            this->startVoice(this->clips[effect]);
+        }
+
+        memset(out, 0, sizeof(float) * frames);
+        for (auto& voice : this->voices) {
+            if (voice.samples == NULL) { continue; }
+            int count = std::min(frames, voice.length - voice.position);
+            const float* samples = voice.samples + voice.position;
+            for (int i = 0; i < count; i++) { out[i] += samples[i]; }
+            voice.position += count;
+            if (voice.position >= voice.length) { voice.samples = NULL; }
+        }
+        for (int i = 0; i < frames; i++) {
+            out[i] = std::clamp(out[i] * this->volume, -1.0f, 1.0f);
+        }
+    }
+
+public:
+    AudioMixer(): device(0), volume(0.0f), clips(), triggers(), voices() {}
+
+    AudioMixer(const AudioMixer&) = delete;
+
+    ~AudioMixer() {
+        if (this->device != 0) { SDL_CloseAudioDevice(this->device); }
+    }
+
+    // Нет устройства - игра идет без звука
+    static std::unique_ptr<AudioMixer> open(int volumePercent) {
+        if (volumePercent <= 0) { return NULL; }
+        auto mixer = std::make_unique<AudioMixer>();
+        mixer->volume = (float) volumePercent / 100.0f;
+
+        SDL_AudioSpec desired;
+        SDL_AudioSpec obtained;
+        memset(&desired, 0, sizeof(desired));
+        desired.freq = AUDIO_FREQUENCY;
+        desired.format = AUDIO_F32SYS;
+        desired.channels = 1;
+        desired.samples = AUDIO_BUFFER_SAMPLES;
+        desired.callback = AudioMixer::audioCallback;
+        desired.userdata = mixer.get();
+        // Частоту берем любую, какую даст устройство: эффекты генерируются под нее
+        mixer->device = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+        if (mixer->device == 0) {
+            LOG_WARN("Unable open audio device: %s", SDL_GetError());
+            return NULL;
+        }
+
+        synthesizeClips(mixer->clips, obtained.freq);
+        LOG_INFO("Audio: %d Hz, %d samples per buffer (%.1f ms)",
+                 obtained.freq, obtained.samples, 1000.0 * obtained.samples / obtained.freq);
+        SDL_PauseAudioDevice(mixer->device, 0);
+        return mixer;
+    }
+
+    // [simulation thread] Переполнение очереди - эффект пропадает
+    void play(SoundEffect effect) {
+        this->triggers.push((uint8_t) effect);
+    }
+
+    // [simulation thread] События тика партии; с концом партии остальные не слышны
+    void playEvents(uint32_t events) {
+        if (events & GameEvent::gameEventGameOver) { this->play(SoundEffect::soundGameOver); return; }
+        if (events & GameEvent::gameEventClear) { this->play(SoundEffect::soundClear); }
+        if (events & GameEvent::gameEventLock) { this->play(SoundEffect::soundLock); }
+        if (events & GameEvent::gameEventRotate) { this->play(SoundEffect::soundRotate); }
+        if (events & GameEvent::gameEventMove) { this->play(SoundEffect::soundMove); }
+    }
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstdint>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BIT_ROWS_X86 1
+#include <immintrin.h>
+#endif
+
+// Битовая строка поля: бит x - занята ли клетка x. Длина кратна 256 битам,
+// лишние биты всегда нули, поэтому проверки идут целыми векторами.
+#define BIT_ROW_BITS 512
+#define BIT_ROW_WORDS (BIT_ROW_BITS / 64)
+#define BIT_ROW_VECTOR_WORDS 4 // 256 бит
+
+struct alignas(32) BitRow {
+    uint64_t words[BIT_ROW_WORDS];
+};
+
+// vectors - сколько первых 256-битных блоков строки сравнивать
+using BitRowIsZeroFn = bool (*)(const BitRow* row, int vectors);
+using BitRowCoversFn = bool (*)(const BitRow* row, const BitRow* mask, int vectors);
+
+// Число младших нулевых битов, value != 0
+inline int countTrailingZeros32(uint32_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(value);
+#else
+    int count = 0;
+    while ((value & 1) == 0) {
+        value >>= 1;
+        count += 1;
+    }
+    return count;
+#endif
+}
+
+inline int countTrailingZeros64(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(value);
+#else
+    int count = 0;
+    while ((value & 1) == 0) {
+        value >>= 1;
+        count += 1;
+    }
+    return count;
+#endif
+}
+
+// Число единичных битов
+inline int countBits32(uint32_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcount(value);
+#else
+    int count = 0;
+    while (value != 0) {
+        value &= value - 1;
+        count += 1;
+    }
+    return count;
+#endif
+}
+
+inline int countBits64(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(value);
+#else
+    int count = 0;
+    while (value != 0) {
+        value &= value - 1;
+        count += 1;
+    }
+    return count;
+#endif
+}
+
+// =============
+// Scalar
+
+bool bitRowIsZeroScalar(const BitRow* row, int vectors) {
+    uint64_t acc = 0;
+    for (int i = 0; i < vectors * BIT_ROW_VECTOR_WORDS; i++) {
+        acc |= row->words[i];
+    }
+    return acc == 0;
+}
+
+// Все ли биты маски установлены в строке
+bool bitRowCoversScalar(const BitRow* row, const BitRow* mask, int vectors) {
+    uint64_t missing = 0;
+    for (int i = 0; i < vectors * BIT_ROW_VECTOR_WORDS; i++) {
+        missing |= mask->words[i] & ~row->words[i];
+    }
+    return missing == 0;
+}
+
+#ifdef BIT_ROWS_X86
+
+// =============
+// SSE2 (есть на любом x86_64)
+
+__attribute__((target("sse2")))
+bool bitRowIsZeroSse2(const BitRow* row, int vectors) {
+    __m128i acc = _mm_setzero_si128();
+    auto data = (const __m128i*) row->words;
+    for (int i = 0; i < vectors * 2; i++) {
+        acc = _mm_or_si128(acc, _mm_load_si128(data + i));
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) == 0xFFFF;
+}
+
+__attribute__((target("sse2")))
+bool bitRowCoversSse2(const BitRow* row, const BitRow* mask, int vectors) {
+    __m128i missing = _mm_setzero_si128();
+    auto rowData = (const __m128i*) row->words;
+    auto maskData = (const __m128i*) mask->words;
+    for (int i = 0; i < vectors * 2; i++) {
+        // andnot(a, b) = ~a & b
+        missing = _mm_or_si128(missing, _mm_andnot_si128(_mm_load_si128(rowData + i), _mm_load_si128(maskData + i)));
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(missing, _mm_setzero_si128())) == 0xFFFF;
+}
+
+// =============
+// AVX2
+
+__attribute__((target("avx2")))
+bool bitRowIsZeroAvx2(const BitRow* row, int vectors) {
+    __m256i acc = _mm256_setzero_si256();
+    auto data = (const __m256i*) row->words;
+    for (int i = 0; i < vectors; i++) {
+        acc = _mm256_or_si256(acc, _mm256_load_si256(data + i));
+    }
+    return _mm256_testz_si256(acc, acc) != 0;
+}
+
+__attribute__((target("avx2")))
+bool bitRowCoversAvx2(const BitRow* row, const BitRow* mask, int vectors) {
+    auto rowData = (const __m256i*) row->words;
+    auto maskData = (const __m256i*) mask->words;
+    for (int i = 0; i < vectors; i++) {
+        // testc(a, b): (~a & b) == 0
+        if (!_mm256_testc_si256(_mm256_load_si256(rowData + i), _mm256_load_si256(maskData + i))) { return false; }
+    }
+    return true;
+}
+
+#endif
+
+// =============
+// Выбор реализации по возможностям процессора, один раз при первом обращении
+
+class BitRowOps {
+public:
+    BitRowIsZeroFn isZero;
+    BitRowCoversFn covers;
+    const char* name;
+
+    BitRowOps(): isZero(bitRowIsZeroScalar), covers(bitRowCoversScalar), name("scalar") {
+#ifdef BIT_ROWS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            this->isZero = bitRowIsZeroAvx2;
+            this->covers = bitRowCoversAvx2;
+            this->name = "avx2";
+        } else if (__builtin_cpu_supports("sse2")) {
+            this->isZero = bitRowIsZeroSse2;
+            this->covers = bitRowCoversSse2;
+            this->name = "sse2";
+        }
+#endif
+    }
+
+    static const BitRowOps& get() {
+        static const BitRowOps ops;
+        return ops;
+    }
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "bit_rows.cpp"
+#include "tetromino.cpp"
+
+#define TILE_COLORS (GARBAGE_COLOR + 1)
+
+// =============
+// ColorGroups: одноцветные группы плиток на битовых масках столбцов, по маске на цвет
+// (бит y - плитка (x, y)). Группа ищется заливкой целыми столбцами: по вертикали - сдвигами
+// внутри слова, по горизонтали - пересечением с соседними столбцами.
+// Заливка идет только от измененных клеток (seeds): остальные группы уже проверены на прошлом
+// шаге и с тех пор не менялись, поэтому длинная цепочка не пересчитывает все поле.
+
+class ColorGroups {
+private:
+    uint32_t colors[TILE_COLORS][FIELD_W_MAX];
+    uint32_t seeds[FIELD_W_MAX]; // клетки, чьи группы надо проверить
+    uint32_t removed[FIELD_W_MAX]; // убрано на последнем шаге
+    uint32_t group[FIELD_W_MAX]; // рабочая маска заливки
+    int groupMinX, groupMaxX;
+
+    // Расширяет seed до связных отрезков столбца column, в которые он попадает
+    static uint32_t spreadColumn(uint32_t seed, uint32_t column) {
+        uint32_t spread = seed & column;
+        while (true) {
+            uint32_t next = spread | (((spread << 1) | (spread >> 1)) & column);
+            if (next == spread) { return spread; }
+            spread = next;
+        }
+    }
+
+    // Группа плитки (x, y) по маскам cells в this->group[groupMinX..groupMaxX], возвращает ее размер
+    int fillGroup(const uint32_t* cells, int width, int x, int y) {
+        this->groupMinX = x;
+        this->groupMaxX = x;
+        this->group[x] = spreadColumn((uint32_t) 1 << y, cells[x]);
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            int minX = this->groupMinX;
+            int maxX = this->groupMaxX;
+            if (minX > 0 && (this->group[minX] & cells[minX - 1]) != 0) {
+                this->groupMinX = minX - 1;
+                this->group[minX - 1] = 0;
+                changed = true;
+            }
+            if (maxX + 1 < width && (this->group[maxX] & cells[maxX + 1]) != 0) {
+                this->groupMaxX = maxX + 1;
+                this->group[maxX + 1] = 0;
+                changed = true;
+            }
+            for (int column = this->groupMinX; column <= this->groupMaxX; column++) {
+                uint32_t reach = this->group[column];
+                if (column > this->groupMinX) { reach |= this->group[column - 1]; }
+                if (column < this->groupMaxX) { reach |= this->group[column + 1]; }
+                uint32_t next = spreadColumn(reach, cells[column]);
+                if (next != this->group[column]) {
+                    this->group[column] = next;
+                    changed = true;
+                }
+            }
+        }
+
+        int size = 0;
+        for (int column = this->groupMinX; column <= this->groupMaxX; column++) {
+            size += countBits32(this->group[column]);
+        }
+        return size;
+    }
+
+    void build(const TetroField& field) {
+        int width = field.getWidth();
+        for (int color = 0; color < TILE_COLORS; color++) {
+            memset(this->colors[color], 0, sizeof(uint32_t) * width);
+        }
+        for (int x = 0; x < width; x++) {
+            uint32_t column = field.columnBits(x);
+            while (column != 0) {
+                int y = countTrailingZeros32(column);
+                column &= column - 1;
+                this->colors[field.tileCode(x, y) - 1][x] |= (uint32_t) 1 << y;
+            }
+        }
+    }
+
+public:
+    ColorGroups(): colors(), seeds(), removed(), group(), groupMinX(0), groupMaxX(0) {}
+
+    // Проверять группы плиток фигуры, только что зафиксированной на поле
+    void markPiece(const TetroActiveShape& shape, int width) {
+        memset(this->seeds, 0, sizeof(uint32_t) * width);
+        for (int i = 0; i < shape.prototype.tilesCount; i++) {
+            int x = shape.x + shape.prototype.offsetsX[i];
+            int y = shape.y + shape.prototype.offsetsY[i];
+            this->seeds[x] |= (uint32_t) 1 << y;
+        }
+    }
+
+    // После TetroField::dropTiles: проверять плитки, упавшие на место убранных
+    void markDropped(const TetroField& field) {
+        for (int x = 0; x < field.getWidth(); x++) {
+            // Упали все плитки не ниже самой нижней убранной: биты не старше ее бита
+            uint32_t above = this->removed[x];
+            above |= above >> 1;
+            above |= above >> 2;
+            above |= above >> 4;
+            above |= above >> 8;
+            above |= above >> 16;
+            this->seeds[x] = field.columnBits(x) & above;
+        }
+    }
+
+    // Удаляет группы больше groupThreshold плиток, задетые отмеченными клетками,
+    // и мусор рядом с ними. Возвращает число удаленных плиток.
+    int removeGroups(TetroField* field, int groupThreshold) {
+        int width = field->getWidth();
+        this->build(*field);
+        const uint32_t* garbage = this->colors[GARBAGE_COLOR];
+        memset(this->removed, 0, sizeof(uint32_t) * width);
+
+        for (int x = 0; x < width; x++) {
+            // Мусор не собирается в группы, его убирают только линии и соседство с группой
+            uint32_t pending = this->seeds[x] & field->columnBits(x) & ~garbage[x];
+            while (pending != 0) {
+                int y = countTrailingZeros32(pending);
+                int color = field->tileCode(x, y) - 1;
+                int size = this->fillGroup(this->colors[color], width, x, y);
+                for (int column = this->groupMinX; column <= this->groupMaxX; column++) {
+                    // Одна группа - одна заливка, даже если в ней несколько отмеченных клеток
+                    this->seeds[column] &= ~this->group[column];
+                    if (size > groupThreshold) { this->removed[column] |= this->group[column]; }
+                }
+                pending = this->seeds[x] & field->columnBits(x) & ~garbage[x];
+            }
+        }
+
+        // Мусор рядом с убранной группой тоже убирается
+        int removedTiles = 0;
+        uint32_t left = 0;
+        for (int x = 0; x < width; x++) {
+            uint32_t groups = this->removed[x];
+            uint32_t right = x + 1 < width ? this->removed[x + 1] : 0;
+            uint32_t near = (groups << 1) | (groups >> 1) | left | right;
+            left = groups;
+            this->removed[x] = groups | (near & garbage[x]);
+
+            uint32_t tiles = this->removed[x];
+            removedTiles += countBits32(tiles);
+            while (tiles != 0) {
+                field->set(x, countTrailingZeros32(tiles), std::nullopt);
+                tiles &= tiles - 1;
+            }
+        }
+        return removedTiles;
+    }
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free queue for any number of producer threads and one consumer thread
+// (per-cell sequence numbers, D. Vyukov). CAPACITY must be a power of two.
+template<typename T, size_t CAPACITY>
+class MpscQueue {
+private:
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "MpscQueue capacity must be a power of two");
+
+    struct Cell {
+        std::atomic<size_t> sequence; // == position: free for producer, == position + 1: ready for consumer
+        T item;
+    };
+
+    Cell cells[CAPACITY];
+    alignas(64) std::atomic<size_t> tail; // producers position
+    alignas(64) std::atomic<size_t> head; // consumer position
+
+public:
+    MpscQueue(): tail(0), head(0) {
+        for (size_t i = 0; i < CAPACITY; i++) {
+            this->cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+
+    // [any producer] Returns false if queue is full.
+    bool push(const T& item) {
+        size_t position = this->tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = this->cells[position & (CAPACITY - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) sequence - (intptr_t) position;
+            if (diff == 0) {
+                if (this->tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.item = item;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = this->tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // [consumer] Returns false if queue is empty.
+    bool pop(T* item) {
+        size_t position = this->head.load(std::memory_order_relaxed);
+        Cell& cell = this->cells[position & (CAPACITY - 1)];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if ((intptr_t) sequence - (intptr_t) (position + 1) < 0) { return false; }
+        *item = cell.item;
+        cell.sequence.store(position + CAPACITY, std::memory_order_release);
+        this->head.store(position + 1, std::memory_order_relaxed);
+        return true;
+    }
+};
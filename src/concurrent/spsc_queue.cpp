@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// CAPACITY must be a power of two.
+template<typename T, size_t CAPACITY>
+class SpscQueue {
+private:
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+    T items[CAPACITY];
+    alignas(64) std::atomic<size_t> head; // consumer position
+    alignas(64) std::atomic<size_t> tail; // producer position
+
+public:
+    SpscQueue(): head(0), tail(0) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+
+    // [producer] Returns false if queue is full.
+    bool push(const T& item) {
+        size_t t = this->tail.load(std::memory_order_relaxed);
+        if (t - this->head.load(std::memory_order_acquire) >= CAPACITY) { return false; }
+        this->items[t & (CAPACITY - 1)] = item;
+        this->tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // [consumer] Returns false if queue is empty.
+    bool pop(T* item) {
+        size_t h = this->head.load(std::memory_order_relaxed);
+        if (h == this->tail.load(std::memory_order_acquire)) { return false; }
+        *item = this->items[h & (CAPACITY - 1)];
+        this->head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return this->head.load(std::memory_order_acquire) == this->tail.load(std::memory_order_acquire);
+    }
+};
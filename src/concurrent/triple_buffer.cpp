@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free triple buffer: one writer thread fills back buffer and publishes it,
+// one reader thread always gets the newest published buffer. No thread ever waits.
+template<typename T>
+class TripleBuffer {
+private:
+    static const int INDEX_MASK = 0b011;
+    static const int FRESH_BIT = 0b100;
+
+    T buffers[3];
+    std::atomic<int> middle; // index of the shared buffer | FRESH_BIT if reader not seen it yet
+    int back; // writer only
+    int front; // reader only
+
+public:
+    TripleBuffer(): middle(1), back(0), front(2) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+
+    // [writer]
+    T& writeBuffer() {
+        return this->buffers[this->back];
+    }
+
+    // [writer] Make write buffer visible for reader and take a free one.
+    void publish() {
+        int prev = this->middle.exchange(this->back | FRESH_BIT, std::memory_order_acq_rel);
+        this->back = prev & INDEX_MASK;
+    }
+
+    // [reader] Switch to the newest published buffer. Returns false if nothing new was published.
+    bool fetch() {
+        if ((this->middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0) { return false; }
+        int prev = this->middle.exchange(this->front, std::memory_order_acq_rel);
+        this->front = prev & INDEX_MASK;
+        return true;
+    }
+
+    // [reader]
+    const T& readBuffer() const {
+        return this->buffers[this->front];
+    }
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Простой пул потоков для фоновых задач (загрузка ассетов и т.п.)
+class WorkerPool {
+private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    bool stopping;
+
+    void run() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->jobAvailable.wait(lock, [this]() { return this->stopping || !this->jobs.empty(); });
+                if (this->jobs.empty()) { return; }
+                job = std::move(this->jobs.front());
+                this->jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+public:
+    explicit WorkerPool(int threadsCount): stopping(false) {
+        for (int i = 0; i < threadsCount; i++) {
+            this->threads.emplace_back([this]() { this->run(); });
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+
+    // Дожидается выполнения уже поставленных задач
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->jobAvailable.notify_all();
+        for (auto& thread : this->threads) {
+            thread.join();
+        }
+    }
+
+    void submit(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->jobs.push_back(std::move(job));
+        }
+        this->jobAvailable.notify_one();
+    }
+};
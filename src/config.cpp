@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "utils.cpp"
+
+// Delayed auto shift: сколько держать клавишу до автоповтора
+#define DEFAULT_DAS_MS 150
+// Auto repeat rate: период автоповтора, 0 - сразу до стенки
+#define DEFAULT_ARR_MS 50
+// Ширина поля в клетках ("мега-поле" - сотни столбцов)
+#define DEFAULT_FIELD_W 10
+#define FIELD_W_MIN 4
+#define FIELD_W_MAX 512
+// Досок на экране (локальная игра на нескольких игроков)
+#define DEFAULT_BOARDS 1
+#define BOARDS_MAX 8
+// Сетевая игра на двоих
+#define DEFAULT_NET_PORT 7777
+// Сколько следующих фигур показывать
+#define DEFAULT_PREVIEW 1
+#define PREVIEW_MAX 13
+// Уровень (сила тяжести); с LEVEL_20G фигура падает на дно в тот же тик
+#define DEFAULT_LEVEL 1
+#define LEVEL_MAX 20
+// Режим очистки по цвету убирает одноцветные группы больше стольких плиток
+#define DEFAULT_COLOR_GROUP 4
+// Громкость звуковых эффектов, 0 - без звука
+#define DEFAULT_VOLUME 50
+// Период подъема мусорной строки снизу в режиме дополнительных плиток
+#define DEFAULT_GARBAGE_INTERVAL_MS 5000
+
+enum CleaningMode { line = 0, color = 1 };
+
+enum ExtraTilesMode { off = 0, on = 1 };
+
+// =============
+// Настройки партии (задаются аргументами командной строки)
+
+class GameConfig {
+public:
+    int dasMs;
+    int arrMs;
+    int fieldWidth;
+    int boardsCount;
+    int previewCount;
+    int startLevel;
+    CleaningMode cleaningMode;
+    int colorGroupSize;
+    ExtraTilesMode extraTilesMode;
+    int garbageIntervalMs;
+    const char* versus; // NULL - без сети, "loopback" или HOST:PORT
+    int netPlayer;
+    int netPort;
+    int netDelayMs; // только loopback
+    int netLossPercent; // только loopback
+    const char* savePath; // NULL - без сохранения партии
+    const char* telemetryPath; // NULL - без телеметрии
+    bool measureLatency;
+    bool pcHint;
+    int volume; // 0..100
+    const char* assetsDir; // NULL - встроенные ассеты
+    const char* assetsPak;
+    const char* piecesPath; // NULL - стандартные тетрамино
+
+    GameConfig():
+            dasMs(DEFAULT_DAS_MS),
+            arrMs(DEFAULT_ARR_MS),
+            fieldWidth(DEFAULT_FIELD_W),
+            boardsCount(DEFAULT_BOARDS),
+            previewCount(DEFAULT_PREVIEW),
+            startLevel(DEFAULT_LEVEL),
+            cleaningMode(CleaningMode::line),
+            colorGroupSize(DEFAULT_COLOR_GROUP),
+            extraTilesMode(ExtraTilesMode::off),
+            garbageIntervalMs(DEFAULT_GARBAGE_INTERVAL_MS),
+            versus(NULL),
+            netPlayer(0),
+            netPort(DEFAULT_NET_PORT),
+            netDelayMs(0),
+            netLossPercent(0),
+            savePath(NULL),
+            telemetryPath(NULL),
+            measureLatency(false),
+            pcHint(false),
+            volume(DEFAULT_VOLUME),
+            assetsDir(NULL),
+            assetsPak(NULL),
+            piecesPath(NULL) {}
+};
+
+void printUsage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  --das=MS    delay before side auto repeat (default %d)\n", DEFAULT_DAS_MS);
+    printf("  --arr=MS    side auto repeat period, 0 moves to the wall (default %d)\n", DEFAULT_ARR_MS);
+    printf("  --width=N   field width, %d..%d (default %d)\n", FIELD_W_MIN, FIELD_W_MAX, DEFAULT_FIELD_W);
+    printf("  --players=N split screen with N boards, 1..%d (default %d)\n", BOARDS_MAX, DEFAULT_BOARDS);
+    printf("  --preview=N next pieces shown, 1..%d (default %d)\n", PREVIEW_MAX, DEFAULT_PREVIEW);
+    printf("  --level=N   starting level, %d..%d; level %d is 20G (default %d)\n", DEFAULT_LEVEL, LEVEL_MAX, LEVEL_MAX, DEFAULT_LEVEL);
+    printf("  --color     clear same-colored groups instead of full lines\n");
+    printf("  --color-group=N    groups larger than N are cleared in --color mode, N is at least the piece size (default %d)\n", DEFAULT_COLOR_GROUP);
+    printf("  --garbage   raise garbage rows from the bottom and mix single-tile pieces into the bag\n");
+    printf("  --garbage-interval=MS  period of garbage rows in --garbage mode (default %d)\n", DEFAULT_GARBAGE_INTERVAL_MS);
+    printf("  --versus=HOST:PORT two-player versus over UDP with rollback (--versus=loopback: both players local)\n");
+    printf("  --net-player=0|1   our side in a UDP match; both sides need the same game options (default 0)\n");
+    printf("  --net-port=PORT    local UDP port (default %d)\n", DEFAULT_NET_PORT);
+    printf("  --net-delay=MS --net-loss=PERCENT  simulated network for --versus=loopback\n");
+    printf("  --save=FILE keep the game in progress in FILE and resume it on the next start\n");
+    printf("  --telemetry=FILE   append per-piece and per-game statistics to FILE (CSV)\n");
+    printf("  --volume=N  sound effects volume, 0..100, 0 disables audio (default %d)\n", DEFAULT_VOLUME);
+    printf("  --latency   measure input-to-present latency, report percentiles on exit\n");
+    printf("  --pc-hint   show where to put the piece for a perfect clear with the known queue (first board,\n");
+    printf("              line mode, width up to 16; use with a long --preview)\n");
+    printf("  --assets-dir=DIR   load loose BMP textures from DIR instead of built-in ones (mods)\n");
+    printf("  --assets-pak=FILE  load textures from an asset archive instead of built-in ones\n");
+    printf("  --pieces=FILE      play with the piece set from FILE (format in piece_set.cpp);\n");
+    printf("                     saves and UDP matches need the same set\n");
+}
+
+bool parseGameConfig(int argc, char* args[], GameConfig* config) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = args[i];
+        bool isValid = true;
+
+        if (parseIntOption(arg, "--das=", &config->dasMs, &isValid)) {
+            isValid = isValid && config->dasMs >= 0;
+        } else if (parseIntOption(arg, "--arr=", &config->arrMs, &isValid)) {
+            isValid = isValid && config->arrMs >= 0;
+        } else if (parseIntOption(arg, "--width=", &config->fieldWidth, &isValid)) {
+            isValid = isValid && config->fieldWidth >= FIELD_W_MIN && config->fieldWidth <= FIELD_W_MAX;
+        } else if (parseIntOption(arg, "--players=", &config->boardsCount, &isValid)) {
+            isValid = isValid && config->boardsCount >= 1 && config->boardsCount <= BOARDS_MAX;
+        } else if (parseIntOption(arg, "--preview=", &config->previewCount, &isValid)) {
+            isValid = isValid && config->previewCount >= 1 && config->previewCount <= PREVIEW_MAX;
+        } else if (parseIntOption(arg, "--level=", &config->startLevel, &isValid)) {
+            isValid = isValid && config->startLevel >= 1 && config->startLevel <= LEVEL_MAX;
+        } else if (parseIntOption(arg, "--color-group=", &config->colorGroupSize, &isValid)) {
+            isValid = isValid && config->colorGroupSize >= 2;
+        } else if (strcmp(arg, "--color") == 0) {
+            config->cleaningMode = CleaningMode::color;
+        } else if (parseIntOption(arg, "--garbage-interval=", &config->garbageIntervalMs, &isValid)) {
+            isValid = isValid && config->garbageIntervalMs > 0;
+        } else if (strcmp(arg, "--garbage") == 0) {
+            config->extraTilesMode = ExtraTilesMode::on;
+        } else if (strncmp(arg, "--versus=", 9) == 0) {
+            config->versus = arg + 9;
+            isValid = *config->versus != '\0';
+        } else if (parseIntOption(arg, "--net-player=", &config->netPlayer, &isValid)) {
+            isValid = isValid && (config->netPlayer == 0 || config->netPlayer == 1);
+        } else if (parseIntOption(arg, "--net-port=", &config->netPort, &isValid)) {
+            isValid = isValid && config->netPort > 0 && config->netPort < 65536;
+        } else if (parseIntOption(arg, "--net-delay=", &config->netDelayMs, &isValid)) {
+            isValid = isValid && config->netDelayMs >= 0;
+        } else if (parseIntOption(arg, "--net-loss=", &config->netLossPercent, &isValid)) {
+            isValid = isValid && config->netLossPercent >= 0 && config->netLossPercent <= 100;
+        } else if (strncmp(arg, "--save=", 7) == 0) {
+            config->savePath = arg + 7;
+            isValid = *config->savePath != '\0';
+        } else if (strncmp(arg, "--telemetry=", 12) == 0) {
+            config->telemetryPath = arg + 12;
+            isValid = *config->telemetryPath != '\0';
+        } else if (parseIntOption(arg, "--volume=", &config->volume, &isValid)) {
+            isValid = isValid && config->volume >= 0 && config->volume <= 100;
+        } else if (strcmp(arg, "--latency") == 0) {
+            config->measureLatency = true;
+        } else if (strcmp(arg, "--pc-hint") == 0) {
+            config->pcHint = true;
+        } else if (strncmp(arg, "--assets-dir=", 13) == 0) {
+            config->assetsDir = arg + 13;
+            isValid = *config->assetsDir != '\0';
+        } else if (strncmp(arg, "--assets-pak=", 13) == 0) {
+            config->assetsPak = arg + 13;
+            isValid = *config->assetsPak != '\0';
+        } else if (strncmp(arg, "--pieces=", 9) == 0) {
+            config->piecesPath = arg + 9;
+            isValid = *config->piecesPath != '\0';
+        } else {
+            isValid = false;
+        }
+
+        if (!isValid) {
+            printf("Invalid argument: %s\n", arg);
+            printUsage(args[0]);
+            return false;
+        }
+    }
+    // Сетевая партия всегда на две доски
+    if (config->versus != NULL) {
+        config->boardsCount = 2;
+    }
+    return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "../log.cpp"
+
+// Отладочный счетчик выделений памяти в куче (сборка с TETRIS_COUNT_ALLOCATIONS).
+// Считаются все operator new; C malloc внутри SDL не учитывается.
+
+#ifdef TETRIS_COUNT_ALLOCATIONS
+
+thread_local uint64_t threadAllocations = 0;
+
+void* countedAlloc(size_t size) {
+    threadAllocations += 1;
+    void* p = malloc(size != 0 ? size : 1);
+    if (p == NULL) { throw std::bad_alloc(); }
+    return p;
+}
+
+void* countedAlignedAlloc(size_t size, std::align_val_t align) {
+    threadAllocations += 1;
+    size_t alignment = (size_t) align;
+    size_t rounded = (size + alignment - 1) / alignment * alignment;
+    void* p = aligned_alloc(alignment, rounded != 0 ? rounded : alignment);
+    if (p == NULL) { throw std::bad_alloc(); }
+    return p;
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try { return countedAlloc(size); } catch (...) { return NULL; }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try { return countedAlloc(size); } catch (...) { return NULL; }
+}
+void* operator new(size_t size, std::align_val_t align) { return countedAlignedAlloc(size, align); }
+void* operator new[](size_t size, std::align_val_t align) { return countedAlignedAlloc(size, align); }
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { free(p); }
+
+uint64_t threadAllocationCount() {
+    return threadAllocations;
+}
+
+#else
+
+uint64_t threadAllocationCount() {
+    return 0;
+}
+
+#endif
+
+// Проверка, что цикл после прогрева не выделяет память. Без TETRIS_COUNT_ALLOCATIONS ничего не делает.
+class AllocationGuard {
+private:
+    const char* name;
+    int warmupTicks;
+    int ticks;
+    uint64_t before;
+
+public:
+    AllocationGuard(const char* name, int warmupTicks): name(name), warmupTicks(warmupTicks), ticks(0), before(0) {}
+
+    void beginTick() {
+        this->before = threadAllocationCount();
+    }
+
+    void endTick() {
+        uint64_t allocations = threadAllocationCount() - this->before;
+        this->ticks += 1;
+        if (this->ticks > this->warmupTicks && allocations != 0) {
+            LOG_ERROR("%s: %llu heap allocation(s) in steady-state tick %d", this->name, (unsigned long long) allocations, this->ticks);
+            Logger::get().shutdown();
+            abort();
+        }
+    }
+};
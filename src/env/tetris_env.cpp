@@ -0,0 +1,210 @@
+// Библиотека среды для обучения: tetris_env.h, без SDL и окна.
+#include <cstring>
+#include <exception>
+#include <vector>
+#include "tetris_env.h"
+#include "../frame_input.cpp"
+
+static_assert(TETRIS_ENV_ROWS == FIELD_H, "Env rows must match field height");
+
+// Шаг в режиме TICK - как тик симуляции в игре
+#define ENV_TICK_DT 0.02f
+#define ENV_TICK_MS 20
+// Ходы размещением: повороты * ширина поля
+#define ENV_ROTATIONS 4
+#define ENV_TICK_ACTIONS (1 << InputKey::keyAction)
+
+// Зерно партии i пачки: соседние партии не должны получить похожие последовательности
+uint32_t envSeed(uint32_t seed, int index) {
+    return mixSeed(seed + 0x9E3779B9u * (uint32_t) (index + 1));
+}
+
+// Столбец самой левой плитки фигуры
+int shapeLeftColumn(const TetroActiveShape& shape) {
+    return shape.x + shape.prototype.orientation().minX;
+}
+
+int shapeTopRow(const TetroActiveShape& shape) {
+    return shape.y + shape.prototype.orientation().minY;
+}
+
+// =============
+// TetrisEnv: пачка партий. Вся память выделяется при создании.
+
+struct TetrisEnv {
+    GameConfig config;
+    TetrisEnvActionSpace actionSpace;
+    int boardWords;
+    std::vector<FramePlayer> players;
+    std::vector<uint32_t> frames; // кадр партии в режиме TICK
+    TetrisEnvBuffers buffers;
+
+    TetrisEnv(const GameConfig& config, TetrisEnvActionSpace actionSpace, int envsCount):
+            config(config),
+            actionSpace(actionSpace),
+            boardWords((config.fieldWidth + 63) / 64),
+            players(envsCount),
+            frames(envsCount, 0),
+            buffers() {
+        for (auto& player : this->players) {
+            player.game = TetroGame(config);
+        }
+    }
+
+    int envsCount() const {
+        return (int) this->players.size();
+    }
+
+    int actionCount() const {
+        if (this->actionSpace == TETRIS_ENV_TICK) { return ENV_TICK_ACTIONS; }
+        return ENV_ROTATIONS * this->config.fieldWidth;
+    }
+
+    void resetPlayer(int index, uint32_t seed) {
+        FramePlayer& player = this->players[index];
+        player.game.reset(seed);
+        player.input = InputState();
+        player.lastInput = 0;
+        this->frames[index] = 0;
+        // Ходу размещением нужна фигура сразу, а не через тик падения
+        if (this->actionSpace == TETRIS_ENV_PLACEMENT) { player.game.spawnNextShape(); }
+    }
+
+    void reset(uint32_t seed) {
+        for (int i = 0; i < this->envsCount(); i++) {
+            this->resetPlayer(i, envSeed(seed, i));
+            if (this->buffers.rewards != NULL) { this->buffers.rewards[i] = 0.0f; }
+            if (this->buffers.dones != NULL) { this->buffers.dones[i] = 0; }
+            this->writeObservation(i);
+        }
+    }
+
+    void step(const int32_t* actions) {
+        for (int i = 0; i < this->envsCount(); i++) {
+            FramePlayer& player = this->players[i];
+            int scoreBefore = player.game.score;
+
+            int32_t action = actions[i];
+            if (this->actionSpace == TETRIS_ENV_TICK) {
+                FrameInput bits = (FrameInput) (action & (ENV_TICK_ACTIONS - 1));
+                player.step(bits, 0, this->frames[i] * ENV_TICK_MS, ENV_TICK_DT, ENV_TICK_MS);
+                this->frames[i] += 1;
+            } else {
+                int width = this->config.fieldWidth;
+                int clamped = std::max(0, std::min(action, ENV_ROTATIONS * width - 1));
+                player.game.placeShape(clamped / width, clamped % width);
+            }
+
+            float reward = (float) (player.game.score - scoreBefore);
+            bool isDone = player.game.isLose;
+            // Новая партия сразу: вызывающая сторона видит done и первое наблюдение следующей
+            if (isDone) { this->resetPlayer(i, player.game.random.next()); }
+
+            if (this->buffers.rewards != NULL) { this->buffers.rewards[i] = reward; }
+            if (this->buffers.dones != NULL) { this->buffers.dones[i] = isDone ? 1 : 0; }
+            this->writeObservation(i);
+        }
+    }
+
+    void writeObservation(int index) {
+        TetroGame& game = this->players[index].game;
+
+        if (this->buffers.board != NULL) {
+            uint64_t* board = this->buffers.board + (size_t) index * FIELD_H * this->boardWords;
+            for (int y = 0; y < FIELD_H; y++) {
+                memcpy(board + y * this->boardWords, game.field.rowBits(y), sizeof(uint64_t) * this->boardWords);
+            }
+        }
+
+        if (this->buffers.piece != NULL) {
+            int32_t* piece = this->buffers.piece + (size_t) index * TETRIS_ENV_PIECE_FIELDS;
+            if (game.activeShape.has_value()) {
+                const TetroActiveShape& shape = game.activeShape.value();
+                piece[0] = shape.prototype.clazz;
+                piece[1] = shapeLeftColumn(shape);
+                piece[2] = shapeTopRow(shape);
+                piece[3] = shape.prototype.variant % shapeOrientations(shape.prototype.clazz);
+            } else {
+                piece[0] = -1;
+                piece[1] = 0;
+                piece[2] = 0;
+                piece[3] = 0;
+            }
+        }
+
+        if (this->buffers.preview != NULL) {
+            int32_t* preview = this->buffers.preview + (size_t) index * this->config.previewCount;
+            for (int i = 0; i < this->config.previewCount; i++) {
+                preview[i] = i < game.nextQueue.size() ? game.nextQueue.at(i).clazz : -1;
+            }
+        }
+
+        if (this->buffers.actionMask != NULL && this->actionSpace == TETRIS_ENV_PLACEMENT) {
+            int width = this->config.fieldWidth;
+            uint8_t* mask = this->buffers.actionMask + (size_t) index * ENV_ROTATIONS * width;
+            memset(mask, 0, ENV_ROTATIONS * width);
+            if (game.activeShape.has_value()) {
+                int orientations = shapeOrientations(game.activeShape.value().prototype.clazz);
+                for (int r = 0; r < orientations; r++) {
+                    int minColumn = 0;
+                    int maxColumn = 0;
+                    if (!game.placementRange(r, &minColumn, &maxColumn)) { continue; }
+                    memset(mask + r * width + minColumn, 1, maxColumn - minColumn + 1);
+                }
+            }
+        }
+    }
+};
+
+// =============
+// C ABI
+
+TetrisEnv* tetris_env_create(const TetrisEnvConfig* config) {
+    if (config == NULL) { return NULL; }
+    bool isValid = config->envsCount >= 1
+            && (config->actionSpace == TETRIS_ENV_TICK || config->actionSpace == TETRIS_ENV_PLACEMENT)
+            && config->fieldWidth >= FIELD_W_MIN && config->fieldWidth <= FIELD_W_MAX
+            && config->previewCount >= 1 && config->previewCount <= PREVIEW_MAX
+            && config->startLevel >= 1 && config->startLevel <= LEVEL_MAX;
+    if (!isValid) {
+        LOG_ERROR("Invalid env config");
+        return NULL;
+    }
+
+    GameConfig gameConfig;
+    gameConfig.fieldWidth = config->fieldWidth;
+    gameConfig.previewCount = config->previewCount;
+    gameConfig.startLevel = config->startLevel;
+    gameConfig.cleaningMode = config->colorCleaning != 0 ? CleaningMode::color : CleaningMode::line;
+    // Исключения не должны уходить за границу C ABI
+    try {
+        return new TetrisEnv(gameConfig, (TetrisEnvActionSpace) config->actionSpace, config->envsCount);
+    } catch (const std::exception& error) {
+        LOG_ERROR("Unable create env: %s", error.what());
+        return NULL;
+    }
+}
+
+void tetris_env_destroy(TetrisEnv* env) {
+    delete env;
+}
+
+int32_t tetris_env_board_words(const TetrisEnv* env) {
+    return env->boardWords;
+}
+
+int32_t tetris_env_action_count(const TetrisEnv* env) {
+    return env->actionCount();
+}
+
+void tetris_env_set_buffers(TetrisEnv* env, const TetrisEnvBuffers* buffers) {
+    env->buffers = *buffers;
+}
+
+void tetris_env_reset(TetrisEnv* env, uint32_t seed) {
+    env->reset(seed);
+}
+
+void tetris_env_step(TetrisEnv* env, const int32_t* actions) {
+    env->step(actions);
+}
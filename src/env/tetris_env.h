@@ -0,0 +1,75 @@
+#pragma once
+
+// C ABI среды для обучения с подкреплением: пачка независимых партий, которые
+// шагают одновременно. Наблюдения пишутся в массивы вызывающей стороны
+// (numpy и т.п.), за шаг ничего не выделяется и не копируется между вызовами.
+//
+// Размеры массивов на одну партию (умножить на envsCount):
+//   board       uint64_t [TETRIS_ENV_ROWS][tetris_env_board_words()] - занятость, бит x строки y
+//   piece       int32_t  [TETRIS_ENV_PIECE_FIELDS] - фигура, столбец левой и строка верхней плитки,
+//                                                    поворот; фигура -1, если ее еще нет
+//   preview     int32_t  [previewCount] - следующие фигуры
+//   rewards     float    [1] - очки за шаг
+//   dones       uint8_t  [1] - партия закончилась, наблюдение уже от новой партии
+//   actionMask  uint8_t  [tetris_env_action_count()] - допустимые ходы размещением (или NULL)
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define TETRIS_ENV_API __declspec(dllexport)
+#else
+#define TETRIS_ENV_API __attribute__((visibility("default")))
+#endif
+
+#define TETRIS_ENV_ROWS 24
+#define TETRIS_ENV_PIECE_FIELDS 4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Пространство действий.
+// TICK: действие - биты зажатых клавиш на тик 20 мс (1 - вправо, 2 - поворот, 4 - влево, 8 - вниз),
+// с силой тяжести, задержкой фиксации и автоповтором, как в игре.
+// PLACEMENT: действие - поворот * ширина + столбец левой плитки, фигура сразу бросается на дно.
+enum TetrisEnvActionSpace { TETRIS_ENV_TICK = 0, TETRIS_ENV_PLACEMENT = 1 };
+
+typedef struct TetrisEnvConfig {
+    int32_t envsCount;
+    int32_t actionSpace;
+    int32_t fieldWidth;
+    int32_t previewCount;
+    int32_t startLevel;
+    int32_t colorCleaning; // 0 - очистка линий, 1 - одноцветных групп
+} TetrisEnvConfig;
+
+typedef struct TetrisEnvBuffers {
+    uint64_t* board;
+    int32_t* piece;
+    int32_t* preview;
+    float* rewards;
+    uint8_t* dones;
+    uint8_t* actionMask;
+} TetrisEnvBuffers;
+
+typedef struct TetrisEnv TetrisEnv;
+
+// NULL, если настройки вне допустимых границ
+TETRIS_ENV_API TetrisEnv* tetris_env_create(const TetrisEnvConfig* config);
+TETRIS_ENV_API void tetris_env_destroy(TetrisEnv* env);
+
+TETRIS_ENV_API int32_t tetris_env_board_words(const TetrisEnv* env);
+TETRIS_ENV_API int32_t tetris_env_action_count(const TetrisEnv* env);
+
+// Массивы должны жить, пока среда ими пользуется
+TETRIS_ENV_API void tetris_env_set_buffers(TetrisEnv* env, const TetrisEnvBuffers* buffers);
+
+// Новые партии; партия i получает свое зерно, производное от seed. Пишет наблюдения.
+TETRIS_ENV_API void tetris_env_reset(TetrisEnv* env, uint32_t seed);
+
+// actions[envsCount]. Пишет наблюдения, награды и признаки конца партии.
+TETRIS_ENV_API void tetris_env_step(TetrisEnv* env, const int32_t* actions);
+
+#ifdef __cplusplus
+}
+#endif
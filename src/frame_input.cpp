@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include "game.cpp"
+#include "input.cpp"
+
+// Биты зажатых клавиш за кадр (бит = InputKey)
+using FrameInput = uint8_t;
+
+FrameInput frameInputFromState(InputState& input) {
+    FrameInput bits = 0;
+    if (input.keyR.isDown()) { bits |= 1 << InputKey::keyRight; }
+    if (input.keyU.isDown()) { bits |= 1 << InputKey::keyUp; }
+    if (input.keyL.isDown()) { bits |= 1 << InputKey::keyLeft; }
+    if (input.keyD.isDown()) { bits |= 1 << InputKey::keyDown; }
+    if (input.keyAction.isDown()) { bits |= 1 << InputKey::keyAction; }
+    return bits;
+}
+
+// =============
+// FramePlayer: партия, которой управляют не события окна, а биты зажатых клавиш за кадр.
+// Кадр полностью детерминирован (сетевая игра с откатом, среда для обучения).
+
+class FramePlayer {
+public:
+    TetroGame game;
+    InputState input;
+    FrameInput lastInput;
+
+    FramePlayer(): game(TetroGame()), input(InputState()), lastInput(0) {}
+
+    // Изменения битов превращаются в события нажатия и отпускания в начале кадра
+    void step(FrameInput bits, int board, uint32_t time, float frameDt, uint32_t frameMs) {
+        FrameInput changed = bits ^ this->lastInput;
+
+        InputEvent events[InputKey::keyBack];
+        int eventsCount = 0;
+        this->input.update();
+        for (int key = 0; key < InputKey::keyBack; key++) {
+            if ((changed & (1 << key)) == 0) { continue; }
+            bool isDown = (bits & (1 << key)) != 0;
+            InputEvent event = InputEvent {
+                isDown ? InputEventType::keyPressed : InputEventType::keyReleased,
+                (InputKey) key, time, 0, board
+            };
+            this->input.apply(event);
+            events[eventsCount] = event;
+            eventsCount += 1;
+        }
+        this->lastInput = bits;
+
+        TickInput tickInput = TickInput { events, eventsCount, time, time + frameMs, NULL, board };
+        this->game.update(frameDt, this->input, tickInput);
+    }
+};
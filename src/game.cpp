@@ -0,0 +1,744 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <cstdint>
+#include <cstdlib>
+#include "ring_buffer.cpp"
+#include "tetromino.cpp"
+#include "color_groups.cpp"
+#include "input.cpp"
+#include "config.cpp"
+#include "utils.cpp"
+
+// Время падения на строку на первом уровне и задержка фиксации лежащей фигуры
+#define FALL_BASE_T 0.5
+#define LOCK_DELAY_T 0.5
+// Во сколько раз быстрее падение с зажатой клавишей вниз
+#define SOFT_DROP_FACTOR 12.0
+// Сколько очищенных строк (в режиме цвета - плиток, деленных на ширину) на уровень
+#define LINES_PER_LEVEL 10
+#define LEVEL_20G LEVEL_MAX
+
+#define VIEWABLE_FIELD_H 20
+#define VIEWABLE_FIELD_Y (FIELD_H - VIEWABLE_FIELD_H)
+
+#define SHAPE_BAG_CAPACITY 32
+#define COLOR_BAG_CAPACITY 16
+
+using ShapeBag = RingBuffer<TetroShapeClass, SHAPE_BAG_CAPACITY>;
+using ColorBag = RingBuffer<TetroColor, COLOR_BAG_CAPACITY>;
+// Очередь следующих фигур с уже посчитанной ориентацией
+using NextQueue = RingBuffer<TetroShapePrototype, PREVIEW_MAX>;
+
+// Генератор случайных чисел партии (xorshift32). Свой, а не std::rand, чтобы партия
+// полностью определялась зерном: это нужно сетевой игре с откатом.
+class GameRandom {
+public:
+    uint32_t state;
+
+    GameRandom(): GameRandom(1) {}
+    GameRandom(uint32_t seed): state(seed != 0 ? seed : 0x9E3779B9u) {}
+
+    uint32_t next() {
+        return xorshift32(&this->state);
+    }
+
+    int below(int n) {
+        return (int) (this->next() % (uint32_t) n);
+    }
+};
+
+// Мешок из набора фигур; withExtra - добавить дополнительные фигуры (режим дополнительных плиток)
+void fillShapeBag(ShapeBag* bag, bool withExtra, GameRandom* random) {
+    bag->clear();
+    const PieceSet& pieces = PieceSet::active();
+    for (int i = 0; i < pieces.bagCount; i++) { bag->pushBack((TetroShapeClass) pieces.bag[i]); }
+    if (withExtra) {
+        for (int i = 0; i < pieces.extraCount; i++) { bag->pushBack((TetroShapeClass) pieces.extra[i]); }
+    }
+
+    int size = bag->size();
+    for (int i = 0; i < size; i++) {
+        int i1 = i;
+        int i2 = random->below(size);
+
+        auto class1 = bag->at(i1);
+        auto class2 = bag->at(i2);
+
+        bag->at(i1) = class2;
+        bag->at(i2) = class1;
+    }
+}
+
+void fillColorBag(ColorBag* bag, GameRandom* random) {
+    bag->clear();
+    for (int i = 0; i < 6; i++) { bag->pushBack(BASE_TILES[i]); }
+
+    int size = bag->size();
+    for (int i = 0; i < size; i++) {
+        int i1 = i;
+        int i2 = random->below(size);
+
+        auto class1 = bag->at(i1);
+        auto class2 = bag->at(i2);
+
+        bag->at(i1) = class2;
+        bag->at(i2) = class1;
+    }
+}
+
+// Время падения на одну строку: кривая гайдлайна, приведенная к FALL_BASE_T на первом уровне.
+// 0 - мгновенно до дна (20G).
+float fallTimeForLevel(int level) {
+    if (level >= LEVEL_20G) { return 0.0f; }
+    return (float) (FALL_BASE_T * std::pow(0.8 - (level - 1) * 0.007, level - 1));
+}
+
+// Сколько разных ориентаций у фигуры (поворот только в одну сторону)
+int shapeOrientations(TetroShapeClass clazz) {
+    return PieceSet::active().orientations(clazz);
+}
+
+// Точка появления фигуры: квадрат ее ориентаций по центру поля
+int spawnShapeX(int fieldWidth, TetroShapeClass clazz) {
+    return fieldWidth / 2 - PieceSet::active().classes[clazz].boxSize / 2;
+}
+
+// Наименьшее число нажатий, которым фигура доводится от точки появления до места фиксации:
+// повороты плюс сдвиг, где удержание до стенки считается одним нажатием. Препятствия не учитываются.
+int finesseMinimalInputs(const TetroShapePrototype& prototype, int spawnX, int x, int fieldWidth) {
+    int rotations = prototype.variant % shapeOrientations(prototype.clazz);
+
+    int minOffset = prototype.orientation().minX;
+    int maxOffset = prototype.orientation().maxX;
+    int shifts = 0;
+    if (x < spawnX) {
+        shifts = std::min(spawnX - x, 1 + (x + minOffset));
+    } else if (x > spawnX) {
+        shifts = std::min(x - spawnX, 1 + (fieldWidth - 1 - maxOffset - x));
+    }
+    return rotations + shifts;
+}
+
+// Итог одной зафиксированной фигуры (телеметрия)
+class PieceStats {
+public:
+    TetroShapeClass clazz;
+    int variant;
+    int x, y;
+    int inputs; // нажатия сдвига и поворота, без автоповтора
+    int finesseFaults; // лишние нажатия сверх finesseMinimalInputs
+    int clearedTiles;
+    int scoreDelta;
+    int level;
+    float lockTime; // от начала партии, с
+    float pieceTime; // от появления до фиксации, с
+
+    PieceStats():
+            clazz(TetroShapeClass::O),
+            variant(0),
+            x(0), y(0),
+            inputs(0),
+            finesseFaults(0),
+            clearedTiles(0),
+            scoreDelta(0),
+            level(0),
+            lockTime(0.0f),
+            pieceTime(0.0f) {}
+};
+
+// Статистика партии. Фигура, зафиксированная за тик, ждет takeLockedPiece: очки и очищенные
+// плитки за нее известны только к концу тика.
+class GameStats {
+public:
+    float playTime;
+    int pieces;
+    int finesseFaults;
+
+    float spawnTime;
+    int inputs;
+
+    bool hasLockedPiece;
+    PieceStats lockedPiece;
+    int scoreBeforeLock;
+    int clearedBeforeLock;
+
+    GameStats():
+            playTime(0.0f),
+            pieces(0),
+            finesseFaults(0),
+            spawnTime(0.0f),
+            inputs(0),
+            hasLockedPiece(false),
+            lockedPiece(PieceStats()),
+            scoreBeforeLock(0),
+            clearedBeforeLock(0) {}
+};
+
+// События партии за тик (битовая маска), для звука
+enum GameEvent {
+    gameEventMove = 1 << 0,
+    gameEventRotate = 1 << 1,
+    gameEventLock = 1 << 2,
+    gameEventClear = 1 << 3,
+    gameEventGameOver = 1 << 4
+};
+
+// Автоповтор сдвига в сторону. Время берется из событий ввода,
+// поэтому задержка и частота повтора не привязаны к длине тика.
+class AutoShift {
+public:
+    bool leftDown;
+    bool rightDown;
+    int direction; // -1 влево, 1 вправо, 0 нет
+    uint32_t repeatTime; // ms, когда следующий автосдвиг
+
+    AutoShift():
+            leftDown(false),
+            rightDown(false),
+            direction(0),
+            repeatTime(0) {}
+
+    void press(int direction, uint32_t time, int dasMs) {
+        if (direction < 0) { this->leftDown = true; } else { this->rightDown = true; }
+        this->direction = direction;
+        this->repeatTime = time + dasMs;
+    }
+
+    void release(int direction, uint32_t time, int dasMs) {
+        if (direction < 0) { this->leftDown = false; } else { this->rightDown = false; }
+        if (this->direction != direction) { return; }
+
+        // Если другая сторона еще зажата - переключаемся на нее и заново ждем DAS
+        if (this->leftDown) {
+            this->direction = -1;
+            this->repeatTime = time + dasMs;
+        } else if (this->rightDown) {
+            this->direction = 1;
+            this->repeatTime = time + dasMs;
+        } else {
+            this->direction = 0;
+        }
+    }
+
+    void releaseAll() {
+        this->leftDown = false;
+        this->rightDown = false;
+        this->direction = 0;
+    }
+};
+
+// =============
+// Game (состояние одной партии, без рендера и SDL)
+
+class TetroGame {
+public:
+    TetroField field;
+    std::optional<TetroActiveShape> activeShape;
+    float tickAccDown;
+    float tickAccLock; // сколько фигура уже лежит на опоре
+    float tickAccGarbage;
+    AutoShift shift;
+    int score;
+    int level;
+    int clearedTiles; // всего очищено плиток, по ним растет уровень
+    ShapeBag shapeBag;
+    ColorBag colorBag;
+    NextQueue nextQueue;
+    GameRandom random;
+    GameStats stats;
+    int outgoingGarbage; // мусорные строки для соперника, забирает takeOutgoingGarbage
+    uint32_t events; // GameEvent, забирает takeEvents
+    bool isLose;
+    GameConfig config;
+
+    TetroGame(): TetroGame(GameConfig()) {}
+
+    TetroGame(GameConfig config):
+            field(TetroField(config.fieldWidth)),
+            activeShape(std::nullopt),
+            tickAccDown(0.0),
+            tickAccLock(0.0),
+            tickAccGarbage(0.0),
+            shift(AutoShift()),
+            score(0),
+            level(config.startLevel),
+            clearedTiles(0),
+            shapeBag(ShapeBag()),
+            colorBag(ColorBag()),
+            nextQueue(NextQueue()),
+            random(GameRandom()),
+            stats(GameStats()),
+            outgoingGarbage(0),
+            events(0),
+            isLose(false),
+            config(config)
+    {}
+
+    TetroShapeClass takeShapeClass() {
+        if (this->shapeBag.empty()) {
+            fillShapeBag(&this->shapeBag, this->config.extraTilesMode == ExtraTilesMode::on, &this->random);
+        }
+        return this->shapeBag.popFront();
+    }
+
+    TetroColor takeShapeColor() {
+        if (this->colorBag.empty()) {
+            fillColorBag(&this->colorBag, &this->random);
+        }
+        return this->colorBag.popFront();
+    }
+
+    // Дополняет очередь до нужной глубины; мешки тянутся только когда очередь короче
+    void fillNextQueue() {
+        while (this->nextQueue.size() < this->config.previewCount) {
+            auto shapeClass = this->takeShapeClass();
+            auto shapeColor = this->takeShapeColor();
+            this->nextQueue.pushBack(TetroShapePrototype(shapeClass, 0, shapeColor));
+        }
+    }
+
+    void spawnNextShape() {
+        this->fillNextQueue();
+        TetroShapePrototype next = this->nextQueue.popFront();
+        this->activeShape = std::optional(
+            TetroActiveShape(
+                spawnShapeX(this->field.getWidth(), next.clazz),
+                0,
+                next
+            )
+        );
+        this->fillNextQueue();
+        this->stats.spawnTime = this->stats.playTime;
+        this->stats.inputs = 0;
+    }
+
+    void reset() {
+        this->reset((uint32_t) std::rand());
+    }
+
+    // Партия полностью определяется зерном и последовательностью ввода
+    void reset(uint32_t seed) {
+        this->random = GameRandom(seed);
+        this->stats = GameStats();
+        this->outgoingGarbage = 0;
+        this->events = 0;
+        this->tickAccDown = 0.0;
+        this->tickAccLock = 0.0;
+        this->tickAccGarbage = 0.0;
+        this->shift = AutoShift();
+        this->score = 0;
+        this->level = this->config.startLevel;
+        this->clearedTiles = 0;
+        this->isLose = false;
+        this->activeShape = std::nullopt;
+        this->shapeBag.clear();
+        this->colorBag.clear();
+        this->nextQueue.clear();
+        this->fillNextQueue();
+        this->field.clear();
+    }
+
+    bool shapeInField(const TetroActiveShape& shape) const {
+        const PieceOrientation& orientation = shape.prototype.orientation();
+        return shape.x + orientation.minX >= 0 && shape.x + orientation.maxX < this->field.getWidth()
+                && shape.y + orientation.minY >= 0 && shape.y + orientation.maxY < FIELD_H;
+    }
+
+    // По маскам столбцов ориентации: одна проверка на столбец фигуры, а не на плитку
+    bool shapeCanPlaced(TetroActiveShape& shape) {
+        if (!this->shapeInField(shape)) { return false; }
+        const PieceOrientation& orientation = shape.prototype.orientation();
+        for (int dx = orientation.minX; dx <= orientation.maxX; dx++) {
+            uint32_t column = this->field.columnBits(shape.x + dx);
+            uint32_t tiles = shape.y >= 0 ? orientation.columnMasks[dx] << shape.y : orientation.columnMasks[dx] >> -shape.y;
+            if ((column & tiles) != 0) { return false; }
+        }
+        return true;
+    }
+
+    // На сколько строк фигура может упасть - по маскам столбцов, без пошаговых проверок
+    int landingDistance(const TetroActiveShape& shape) const {
+        int distance = FIELD_H;
+        for (int i = 0; i < shape.prototype.tilesCount; i++) {
+            int x = shape.x + shape.prototype.offsetsX[i];
+            int y = shape.y + shape.prototype.offsetsY[i];
+            distance = std::min(distance, this->field.dropDistance(x, y));
+        }
+        return distance;
+    }
+
+    void addClearedTiles(int tiles) {
+        this->clearedTiles += tiles;
+        int lines = this->clearedTiles / this->field.getWidth();
+        this->level = std::min(this->config.startLevel + lines / LINES_PER_LEVEL, LEVEL_MAX);
+    }
+
+    void lockShape() {
+        const TetroActiveShape& shape = this->activeShape.value();
+        this->recordLockedPiece(shape);
+        this->events |= GameEvent::gameEventLock;
+        for (int i = 0; i < shape.prototype.tilesCount; i++) {
+            int x = shape.x + shape.prototype.offsetsX[i];
+            int y = shape.y + shape.prototype.offsetsY[i];
+            this->field.set(x, y, std::optional(shape.prototype.color));
+        }
+        if (this->config.cleaningMode == CleaningMode::color) {
+            this->removeColorGroups(shape);
+        }
+        this->spawnNextShape();
+    }
+
+    void recordLockedPiece(const TetroActiveShape& shape) {
+        int spawnX = spawnShapeX(this->field.getWidth(), shape.prototype.clazz);
+        int minimal = finesseMinimalInputs(shape.prototype, spawnX, shape.x, this->field.getWidth());
+
+        PieceStats& piece = this->stats.lockedPiece;
+        piece.clazz = shape.prototype.clazz;
+        piece.variant = shape.prototype.variant % shapeOrientations(shape.prototype.clazz);
+        piece.x = shape.x;
+        piece.y = shape.y;
+        piece.inputs = this->stats.inputs;
+        piece.finesseFaults = std::max(this->stats.inputs - minimal, 0);
+        piece.level = this->level;
+        piece.lockTime = this->stats.playTime;
+        piece.pieceTime = this->stats.playTime - this->stats.spawnTime;
+
+        this->stats.hasLockedPiece = true;
+        this->stats.scoreBeforeLock = this->score;
+        this->stats.clearedBeforeLock = this->clearedTiles;
+        this->stats.pieces += 1;
+        this->stats.finesseFaults += piece.finesseFaults;
+    }
+
+    // Зафиксированная за последний тик фигура, если была
+    bool takeLockedPiece(PieceStats* piece) {
+        if (!this->stats.hasLockedPiece) { return false; }
+        this->stats.hasLockedPiece = false;
+        *piece = this->stats.lockedPiece;
+        piece->scoreDelta = this->score - this->stats.scoreBeforeLock;
+        piece->clearedTiles = this->clearedTiles - this->stats.clearedBeforeLock;
+        return true;
+    }
+
+    // Сила тяжести: за тик фигура опускается на столько строк, сколько набежало по времени,
+    // сразу на нужную высоту. Лежащая на опоре фигура фиксируется после задержки.
+    void updateFall(float dt, bool downPressed) {
+        float fallT = fallTimeForLevel(this->level);
+        if (downPressed) { fallT = std::min(fallT, (float) (FALL_BASE_T / SOFT_DROP_FACTOR)); }
+        this->tickAccDown += dt;
+
+        if (!this->activeShape.has_value()) {
+            if (this->tickAccDown >= fallT) {
+                this->tickAccDown = 0.0;
+                this->spawnNextShape();
+            }
+            return;
+        }
+
+        int rows = FIELD_H;
+        if (fallT > 0.0f) {
+            rows = (int) std::min(this->tickAccDown / fallT, (float) FIELD_H);
+            this->tickAccDown -= (float) rows * fallT;
+        } else {
+            this->tickAccDown = 0.0;
+        }
+
+        TetroActiveShape& shape = this->activeShape.value();
+        int distance = this->landingDistance(shape);
+        int moved = std::min(rows, distance);
+        if (moved > 0) {
+            shape.y += moved;
+            this->tickAccLock = 0.0;
+        }
+        if (moved < distance) { return; }
+
+        // На опоре: падение не копится, а фиксация ждет задержку (с зажатой клавишей вниз - короче)
+        this->tickAccDown = 0.0;
+        this->tickAccLock += dt;
+        float lockT = (float) (downPressed ? LOCK_DELAY_T / SOFT_DROP_FACTOR : LOCK_DELAY_T);
+        if (this->tickAccLock >= lockT) {
+            this->tickAccLock = 0.0;
+            this->lockShape();
+        }
+    }
+
+    bool moveSide(int direction) {
+        if (!this->activeShape.has_value()) { return false; }
+
+        TetroActiveShape movedShape = this->activeShape.value();
+        movedShape.x += direction;
+        if (!this->shapeCanPlaced(movedShape)) { return false; }
+
+        this->activeShape.value() = movedShape;
+        this->events |= GameEvent::gameEventMove;
+        return true;
+    }
+
+    bool rotate() {
+        if (!this->activeShape.has_value()) { return false; }
+
+        TetroActiveShape shape = this->activeShape.value();
+        auto rotatedPrototype = shape.prototype.rotated();
+        shape.prototype = rotatedPrototype;
+
+        if (!shapeCanPlaced(shape)) { return false; }
+
+        this->activeShape.value() = shape;
+        this->events |= GameEvent::gameEventRotate;
+        return true;
+    }
+
+    // Выполняет все автосдвиги, которые должны были случиться до момента time
+    void advanceShift(uint32_t time) {
+        if (this->shift.direction == 0) { return; }
+
+        while (this->shift.repeatTime <= time) {
+            if (this->config.arrMs == 0) {
+                // Нулевой ARR: сразу до стенки, и так каждый раз, пока клавиша зажата
+                while (this->moveSide(this->shift.direction)) {}
+                break;
+            }
+            this->moveSide(this->shift.direction);
+            this->shift.repeatTime += this->config.arrMs;
+        }
+    }
+
+    // Возвращает true, если событие изменило положение фигуры
+    bool handleInputEvent(const InputEvent& event, uint32_t time) {
+        int dasMs = this->config.dasMs;
+
+        if (event.type == InputEventType::keyPressed) {
+            bool isMoveKey = event.key == InputKey::keyLeft || event.key == InputKey::keyRight || event.key == InputKey::keyUp;
+            if (isMoveKey && this->activeShape.has_value()) { this->stats.inputs += 1; }
+
+            switch (event.key) {
+                case InputKey::keyLeft:
+                    this->shift.press(-1, time, dasMs);
+                    return this->moveSide(-1);
+                case InputKey::keyRight:
+                    this->shift.press(1, time, dasMs);
+                    return this->moveSide(1);
+                case InputKey::keyUp:
+                    return this->rotate();
+                default:
+                    break;
+            }
+        } else if (event.type == InputEventType::keyReleased) {
+            switch (event.key) {
+                case InputKey::keyLeft: this->shift.release(-1, time, dasMs); break;
+                case InputKey::keyRight: this->shift.release(1, time, dasMs); break;
+                default: break;
+            }
+        } else if (event.type == InputEventType::focusLost) {
+            this->shift.releaseAll();
+        }
+        return false;
+    }
+
+    // Поднимает поле на rows мусорных строк (одна дырка на всю пачку).
+    // Активная фигура, если в нее въехал мусор, поднимается вместе с полем.
+    void raiseGarbage(int rows) {
+        this->field.insertGarbageRows(rows, this->random.below(this->field.getWidth()));
+
+        if (!this->activeShape.has_value()) { return; }
+        TetroActiveShape& shape = this->activeShape.value();
+        for (int lift = 0; lift <= rows; lift++) {
+            TetroActiveShape liftedShape = shape;
+            liftedShape.y -= lift;
+            if (this->shapeCanPlaced(liftedShape)) {
+                shape = liftedShape;
+                return;
+            }
+        }
+        // Фигуре некуда деться - поле переполнено
+        this->isLose = true;
+        this->events |= GameEvent::gameEventGameOver;
+    }
+
+    void updateGarbage(float dt) {
+        this->tickAccGarbage += dt;
+        float interval = (float) this->config.garbageIntervalMs / 1000.0f;
+
+        int rows = 0;
+        while (this->tickAccGarbage >= interval) {
+            this->tickAccGarbage -= interval;
+            rows += 1;
+        }
+        if (rows > 0) { this->raiseGarbage(rows); }
+    }
+
+    uint32_t takeEvents() {
+        uint32_t events = this->events;
+        this->events = 0;
+        return events;
+    }
+
+    int takeOutgoingGarbage() {
+        int rows = this->outgoingGarbage;
+        this->outgoingGarbage = 0;
+        return rows;
+    }
+
+    void removeLines() {
+        int removed = this->field.removeFullLines();
+        if (removed > 0) {
+            this->events |= GameEvent::gameEventClear;
+            this->addClearedTiles(removed * this->field.getWidth());
+            // Соперник получает мусор: 1 строка - ничего, 4 строки - все 4
+            this->outgoingGarbage += removed >= 4 ? removed : removed - 1;
+
+            int dScore = 0;
+            switch (removed) {
+                case 1: dScore = 10 + 0; break;
+                case 2: dScore = 20 + 5; break;
+                case 3: dScore = 30 + 15; break;
+                case 4: dScore = 40 + 20; break;
+                default: dScore = 13 * removed; break;
+            }
+            this->score += dScore;
+        }
+    }
+
+    // Режим очистки по цвету: после фиксации фигуры убираются крупные одноцветные группы,
+    // оставшиеся плитки падают, и так до тех пор, пока новые группы не перестанут появляться.
+    void removeColorGroups(const TetroActiveShape& lockedShape) {
+        // Рабочие массивы поиска групп не входят в состояние партии, чтобы копия партии была дешевой
+        static thread_local ColorGroups colorGroups;
+        // Фигура одного цвета: порог ниже ее размера убирал бы каждую фигуру сразу после фиксации
+        int groupThreshold = std::max(this->config.colorGroupSize, PieceSet::active().largestPiece());
+        colorGroups.markPiece(lockedShape, this->field.getWidth());
+        int chain = 0;
+        while (true) {
+            int removed = colorGroups.removeGroups(&this->field, groupThreshold);
+            if (removed == 0) { break; }
+            chain += 1;
+            this->events |= GameEvent::gameEventClear;
+            // Каждое следующее звено цепочки стоит дороже
+            this->score += removed * chain;
+            this->addClearedTiles(removed);
+            this->field.dropTiles();
+            colorGroups.markDropped(this->field);
+        }
+    }
+
+    // Проигрыш - плитки выше видимой части поля
+    void updateLose() {
+        for (int y = 0; y < VIEWABLE_FIELD_Y; y++) {
+            if (!this->field.lineIsEmpty(y)) {
+                this->isLose = true;
+                this->events |= GameEvent::gameEventGameOver;
+                return;
+            }
+        }
+    }
+
+    // Куда фигура может дойти сдвигами из точки появления после rotations поворотов:
+    // столбцы ее левой плитки [*minColumn, *maxColumn]. false, если повороты упираются.
+    bool placementRange(int rotations, int* minColumn, int* maxColumn) {
+        if (!this->activeShape.has_value()) { return false; }
+        TetroActiveShape shape = this->activeShape.value();
+        for (int i = 0; i < rotations; i++) {
+            shape.prototype = shape.prototype.rotated();
+            if (!this->shapeCanPlaced(shape)) { return false; }
+        }
+
+        int left = 0;
+        while (true) {
+            shape.x -= 1;
+            if (!this->shapeCanPlaced(shape)) { break; }
+            left += 1;
+        }
+        shape.x += left + 1;
+        int right = 0;
+        while (true) {
+            shape.x += 1;
+            if (!this->shapeCanPlaced(shape)) { break; }
+            right += 1;
+        }
+
+        int leftOffset = shape.prototype.orientation().minX;
+        int spawnColumn = this->activeShape.value().x + leftOffset;
+        *minColumn = spawnColumn - left;
+        *maxColumn = spawnColumn + right;
+        return true;
+    }
+
+    // Ход размещением, без времени и силы тяжести: повернуть, сдвинуть левую плитку в столбец column
+    // и бросить на дно. Недостижимый столбец заменяется ближайшим достижимым,
+    // недостижимый поворот - исходным. Возвращает false, если фигуры нет.
+    bool placeShape(int rotations, int column) {
+        if (this->isLose) { return false; }
+        if (!this->activeShape.has_value()) { this->spawnNextShape(); }
+
+        int minColumn = 0;
+        int maxColumn = 0;
+        if (!this->placementRange(rotations, &minColumn, &maxColumn)) {
+            rotations = 0;
+            if (!this->placementRange(0, &minColumn, &maxColumn)) { return false; }
+        }
+        column = std::max(minColumn, std::min(column, maxColumn));
+
+        this->stats.inputs = 0;
+        TetroActiveShape& shape = this->activeShape.value();
+        for (int i = 0; i < rotations; i++) {
+            shape.prototype = shape.prototype.rotated();
+            this->stats.inputs += 1;
+        }
+        int leftOffset = shape.prototype.orientation().minX;
+        int shift = column - (shape.x + leftOffset);
+        shape.x += shift;
+        this->stats.inputs += std::abs(shift);
+        shape.y += this->landingDistance(shape);
+
+        this->lockShape();
+        if (this->config.cleaningMode == CleaningMode::line) {
+            this->removeLines();
+        }
+        this->updateLose();
+        return true;
+    }
+
+    void update(float dt, InputState& input, const TickInput& tickInput) {
+        // Проверка проигрыша
+        if (this->isLose) {
+            if (input.keyAction.isPressed()) {
+                this->reset(this->random.next());
+            }
+            return;
+        }
+        this->stats.playTime += dt;
+
+        // Управление фигурой: события обрабатываются в порядке их времени внутри тика
+        for (int i = 0; i < tickInput.eventsCount; i++) {
+            const InputEvent& event = tickInput.events[i];
+            if (event.board != BOARD_ALL && event.board != tickInput.board) { continue; }
+            uint32_t time = event.timestamp;
+            if (time < tickInput.startTime) { time = tickInput.startTime; }
+            if (time > tickInput.endTime) { time = tickInput.endTime; }
+
+            this->advanceShift(time);
+            bool changed = this->handleInputEvent(event, time);
+            if (changed && event.pollStamp != 0 && tickInput.stamps != NULL) {
+                tickInput.stamps->push(event.pollStamp);
+            }
+        }
+        this->advanceShift(tickInput.endTime);
+
+        // Падение фигуры
+        this->updateFall(dt, input.keyD.isDown());
+
+        if (this->config.extraTilesMode == ExtraTilesMode::on) {
+            this->updateGarbage(dt);
+        }
+
+        // обработка полных линий
+        if (this->config.cleaningMode == CleaningMode::line) {
+            this->removeLines();
+        }
+
+        this->updateLose();
+    }
+};
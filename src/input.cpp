@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+
+// Сколько последних штампов ввода несет снимок состояния
+#define LATENCY_STAMPS 16
+// Событие для всех досок (потеря фокуса, выход)
+#define BOARD_ALL -1
+
+// ===========
+// InputState
+
+class KeyState {
+private:
+    bool f_isDown;
+    bool f_isPressed;
+
+public:
+    KeyState() {
+        this->f_isDown = false;
+        this->f_isPressed = false;
+    }
+
+    bool isDown() {
+        return this->f_isDown;
+    }
+
+    bool isUp() {
+        return !this->f_isDown;
+    }
+
+    bool isPressed() {
+        return this->f_isPressed;
+    }
+
+    void press() {
+        if (this->f_isDown) {
+            this->f_isDown = true;
+        } else {
+            this->f_isDown = true;
+            this->f_isPressed = true;
+        }
+    }
+
+    void release() {
+        this->f_isDown = false;
+        this->f_isPressed = false;
+    }
+
+    void update() {
+        if (this->f_isPressed) {
+            this->f_isPressed = false;
+        }
+    }
+};
+
+// Логические клавиши игры (не зависят от раскладки)
+enum InputKey { keyRight = 0, keyUp = 1, keyLeft = 2, keyDown = 3, keyAction = 4, keyBack = 5 };
+
+enum InputEventType { keyPressed = 0, keyReleased = 1, focusLost = 2, quitRequested = 3 };
+
+// Событие ввода, переданное из потока окна в поток симуляции
+struct InputEvent {
+    InputEventType type;
+    InputKey key;
+    uint32_t timestamp; // SDL ticks, ms
+    uint64_t pollStamp; // SDL_GetPerformanceCounter при выходе из SDL_PollEvent, 0 если замер выключен
+    int board; // доска (игрок), к которой относится клавиша, или BOARD_ALL
+};
+
+// Штампы событий ввода, изменивших состояние игры. Кольцо с монотонным счетчиком,
+// чтобы поток рендера не терял штампы снимков, которые он пропустил.
+class InputStamps {
+public:
+    uint64_t stamps[LATENCY_STAMPS];
+    uint64_t count; // всего записано штампов
+
+    InputStamps(): stamps(), count(0) {}
+
+    void push(uint64_t stamp) {
+        this->stamps[this->count % LATENCY_STAMPS] = stamp;
+        this->count += 1;
+    }
+};
+
+class InputState {
+public:
+    KeyState keyR; // right
+    KeyState keyU; // isUp
+    KeyState keyL; // left
+    KeyState keyD; // isDown
+    KeyState keyAction; // z or space
+    KeyState keyBack; // x or esc
+    bool exitRequired;
+
+    InputState():
+            keyR(KeyState()),
+            keyU(KeyState()),
+            keyL(KeyState()),
+            keyD(KeyState()),
+            keyAction(KeyState()),
+            keyBack(KeyState()),
+            exitRequired(false) {}
+
+    KeyState& key(InputKey key) {
+        switch (key) {
+            case InputKey::keyRight: return this->keyR;
+            case InputKey::keyUp: return this->keyU;
+            case InputKey::keyLeft: return this->keyL;
+            case InputKey::keyDown: return this->keyD;
+            case InputKey::keyAction: return this->keyAction;
+            case InputKey::keyBack: return this->keyBack;
+        }
+        return this->keyBack;
+    }
+
+    void update() {
+        this->keyAction.update();
+        this->keyBack.update();
+        this->keyR.update();
+        this->keyU.update();
+        this->keyL.update();
+        this->keyD.update();
+    }
+
+    void releaseAll() {
+        this->keyAction.release();
+        this->keyBack.release();
+        this->keyR.release();
+        this->keyU.release();
+        this->keyL.release();
+        this->keyD.release();
+    }
+
+    void apply(const InputEvent& event) {
+        switch (event.type) {
+            case InputEventType::keyPressed: this->key(event.key).press(); break;
+            case InputEventType::keyReleased: this->key(event.key).release(); break;
+            case InputEventType::focusLost: this->releaseAll(); break;
+            case InputEventType::quitRequested: this->exitRequired = true; break;
+        }
+    }
+};
+
+// События, пришедшие за один тик симуляции, в порядке их времени
+struct TickInput {
+    const InputEvent* events;
+    int eventsCount;
+    uint32_t startTime; // ms, время начала тика
+    uint32_t endTime; // ms, время конца тика
+    InputStamps* stamps; // сюда пишутся штампы событий, изменивших состояние
+    int board; // события других досок пропускаются
+};
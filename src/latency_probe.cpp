@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <SDL2/SDL.h>
+#include "input.cpp"
+#include "log.cpp"
+
+#define LATENCY_MAX_SAMPLES (1 << 16)
+
+// =============
+// LatencyProbe: задержка от SDL_PollEvent до SDL_RenderPresent, показавшего результат
+
+class LatencyProbe {
+private:
+    std::vector<uint64_t> samples; // в тиках SDL_GetPerformanceCounter
+    uint64_t seenCount;
+    uint64_t droppedCount;
+
+public:
+    bool enabled;
+
+    LatencyProbe(bool enabled): seenCount(0), droppedCount(0), enabled(enabled) {
+        if (enabled) {
+            this->samples.reserve(LATENCY_MAX_SAMPLES);
+        }
+    }
+
+    uint64_t stamp() {
+        return this->enabled ? SDL_GetPerformanceCounter() : 0;
+    }
+
+    // Вызывается сразу после SDL_RenderPresent для показанного снимка
+    void presented(const InputStamps& stamps) {
+        if (!this->enabled || stamps.count == this->seenCount) { return; }
+
+        uint64_t now = SDL_GetPerformanceCounter();
+        uint64_t first = this->seenCount;
+        if (stamps.count - first > LATENCY_STAMPS) {
+            this->droppedCount += stamps.count - first - LATENCY_STAMPS;
+            first = stamps.count - LATENCY_STAMPS;
+        }
+
+        for (uint64_t i = first; i < stamps.count; i++) {
+            if (this->samples.size() >= LATENCY_MAX_SAMPLES) {
+                this->droppedCount += 1;
+                continue;
+            }
+            this->samples.push_back(now - stamps.stamps[i % LATENCY_STAMPS]);
+        }
+        this->seenCount = stamps.count;
+    }
+
+    void report() {
+        if (!this->enabled) { return; }
+        if (this->samples.empty()) {
+            LOG_INFO("Input latency: no samples");
+            return;
+        }
+
+        std::sort(this->samples.begin(), this->samples.end());
+        double msPerTick = 1000.0 / (double) SDL_GetPerformanceFrequency();
+        auto percentile = [&](double p) {
+            size_t i = (size_t) (p * (double) (this->samples.size() - 1) + 0.5);
+            return (double) this->samples[i] * msPerTick;
+        };
+
+        LOG_INFO("Input latency (poll -> present), %zu samples, %llu dropped: p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms",
+                 this->samples.size(), (unsigned long long) this->droppedCount,
+                 percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0));
+    }
+};
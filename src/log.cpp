@@ -0,0 +1,353 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include <type_traits>
+#include "concurrent/mpsc_queue.cpp"
+
+// =================================================
+// Асинхронный лог с уровнями.
+//   LOG_INFO("Texture %s created", name);
+// Сообщения ниже LOG_MIN_LEVEL вырезаются при компиляции. На месте вызова аргументы только
+// копируются в запись фиксированного размера (строки - во встроенный буфер) и запись кладется
+// в lock-free очередь; форматирование и вывод - в фоновом потоке.
+// Каждое место вызова пропускает не больше LOG_RATE_LIMIT сообщений в секунду, остальные
+// считаются и упоминаются в следующем выведенном сообщении.
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_FATAL 4
+
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_QUEUE_SIZE 512
+#define LOG_ARGS_MAX 8
+#define LOG_TEXT_MAX 192 // все строковые аргументы одной записи
+#define LOG_LINE_MAX 1024
+#define LOG_RATE_LIMIT 10
+#define LOG_RATE_WINDOW_US 1000000
+#define LOG_IDLE_MS 5
+
+#define LOG_AT(level, ...) do { \
+    if ((level) >= LOG_MIN_LEVEL) { \
+        static LogSite logSite; \
+        logWrite((level), &logSite, __VA_ARGS__); \
+    } \
+} while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+// Выводит все накопленное и завершает процесс
+#define LOG_FATAL(...) do { \
+    static LogSite logSite; \
+    logWrite(LOG_LEVEL_FATAL, &logSite, __VA_ARGS__); \
+    Logger::get().shutdown(); \
+    exit(1); \
+} while (0)
+
+const char* LOG_LEVEL_NAMES[5] = { "DEBUG", "INFO ", "WARN ", "ERROR", "FATAL" };
+
+enum LogArgType { logArgInt = 0, logArgUint = 1, logArgDouble = 2, logArgText = 3, logArgPointer = 4 };
+
+struct LogArg {
+    uint8_t type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        uint32_t textOffset;
+        const void* p;
+    };
+};
+
+struct LogRecord {
+    uint8_t level;
+    uint8_t argsCount;
+    uint16_t textUsed;
+    uint32_t suppressed; // сколько сообщений этого места было пропущено до этой записи
+    uint64_t timeUs;
+    const char* format; // строковый литерал, живет всю программу
+    LogArg args[LOG_ARGS_MAX];
+    char text[LOG_TEXT_MAX];
+};
+
+uint64_t logNowUs() {
+    static const auto start = std::chrono::steady_clock::now();
+    return (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// =============
+// LogSite: ограничение частоты для одного места вызова (окно в секунду, без блокировок)
+
+class LogSite {
+private:
+    std::atomic<uint64_t> windowStart;
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> suppressed;
+
+public:
+    LogSite(): windowStart(0), count(0), suppressed(0) {}
+
+    // true - сообщение выводится; *suppressedBefore - сколько пропущено до него
+    bool allow(uint64_t now, uint32_t* suppressedBefore) {
+        uint64_t start = this->windowStart.load(std::memory_order_relaxed);
+        if (now - start >= LOG_RATE_WINDOW_US && this->windowStart.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+            this->count.store(0, std::memory_order_relaxed);
+        }
+        if (this->count.fetch_add(1, std::memory_order_relaxed) >= LOG_RATE_LIMIT) {
+            this->suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        *suppressedBefore = this->suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+};
+
+// =============
+// Захват аргументов в запись
+
+void logCaptureText(LogRecord* record, LogArg* arg, const char* text) {
+    if (text == NULL) { text = "(null)"; }
+    arg->type = LogArgType::logArgText;
+    size_t free = LOG_TEXT_MAX - record->textUsed;
+    if (free == 0) {
+        // Буфер кончился: последний байт - ноль от предыдущей строки, выйдет пустая строка
+        arg->textOffset = LOG_TEXT_MAX - 1;
+        return;
+    }
+    size_t length = strnlen(text, free - 1);
+    arg->textOffset = record->textUsed;
+    memcpy(record->text + record->textUsed, text, length);
+    record->text[record->textUsed + length] = '\0';
+    record->textUsed = (uint16_t) (record->textUsed + length + 1);
+}
+
+template<typename T>
+void logCapture(LogRecord* record, const T& value) {
+    if (record->argsCount == LOG_ARGS_MAX) { return; }
+    LogArg* arg = &record->args[record->argsCount];
+    record->argsCount += 1;
+
+    using Value = std::decay_t<T>;
+    if constexpr (std::is_same_v<Value, const char*> || std::is_same_v<Value, char*>) {
+        logCaptureText(record, arg, value);
+    } else if constexpr (std::is_floating_point_v<Value>) {
+        arg->type = LogArgType::logArgDouble;
+        arg->d = (double) value;
+    } else if constexpr (std::is_enum_v<Value> || (std::is_integral_v<Value> && std::is_signed_v<Value>)) {
+        arg->type = LogArgType::logArgInt;
+        arg->i = (int64_t) value;
+    } else if constexpr (std::is_integral_v<Value>) {
+        arg->type = LogArgType::logArgUint;
+        arg->u = (uint64_t) value;
+    } else {
+        static_assert(std::is_pointer_v<Value>, "Unsupported log argument type");
+        arg->type = LogArgType::logArgPointer;
+        arg->p = (const void*) value;
+    }
+}
+
+// Массивы char (строковые литералы) приходят сюда, а не в шаблон
+template<size_t N>
+void logCapture(LogRecord* record, const char (&value)[N]) {
+    logCapture(record, (const char*) value);
+}
+
+// =============
+// Logger: очередь записей и фоновый поток, который их форматирует и пишет в stdout
+
+class Logger {
+private:
+    MpscQueue<LogRecord, LOG_QUEUE_SIZE> queue;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> dropped;
+    std::thread thread;
+
+    Logger(): running(true), dropped(0) {
+        logNowUs();
+        this->thread = std::thread([this]() { this->run(); });
+        // Необработанное исключение: сначала дописать лог, иначе сообщение перед throw потеряется
+        logPreviousTerminate = std::set_terminate(logTerminate);
+    }
+
+    static inline std::terminate_handler logPreviousTerminate = NULL;
+
+    static void logTerminate() {
+        Logger::get().shutdown();
+        if (logPreviousTerminate != NULL) { logPreviousTerminate(); }
+        abort();
+    }
+
+    void run() {
+        while (true) {
+            bool isRunning = this->running.load();
+            if (!this->drain() && !isRunning) { break; }
+            if (!isRunning) { continue; }
+            std::this_thread::sleep_for(std::chrono::milliseconds(LOG_IDLE_MS));
+        }
+    }
+
+    // Возвращает true, если что-то было выведено
+    bool drain() {
+        bool wrote = false;
+        LogRecord record;
+        while (this->queue.pop(&record)) {
+            char line[LOG_LINE_MAX];
+            size_t length = formatLogRecord(record, line, sizeof(line));
+            fwrite(line, 1, length, stdout);
+            wrote = true;
+        }
+        uint64_t droppedCount = this->dropped.exchange(0);
+        if (droppedCount > 0) {
+            printf("[log] %llu messages dropped (queue full)\n", (unsigned long long) droppedCount);
+            wrote = true;
+        }
+        if (wrote) { fflush(stdout); }
+        return wrote;
+    }
+
+public:
+    Logger(const Logger&) = delete;
+
+    ~Logger() {
+        this->shutdown();
+    }
+
+    static Logger& get() {
+        static Logger logger;
+        return logger;
+    }
+
+    // Дописывает все, что уже в очереди, и останавливает поток. Дальнейшие сообщения теряются.
+    void shutdown() {
+        this->running = false;
+        if (this->thread.joinable()) {
+            this->thread.join();
+        }
+    }
+
+    void push(const LogRecord& record) {
+        if (!this->queue.push(record)) {
+            this->dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    static size_t formatLogRecord(const LogRecord& record, char* line, size_t capacity);
+};
+
+// Разворачивает format, подставляя каждый аргумент своим спецификатором через snprintf
+size_t Logger::formatLogRecord(const LogRecord& record, char* line, size_t capacity) {
+    size_t used = 0;
+    auto append = [&](int written) {
+        if (written > 0) { used = std::min(used + (size_t) written, capacity - 1); }
+    };
+    append(snprintf(line, capacity, "[%10.3f] %s ", (double) record.timeUs / 1e6, LOG_LEVEL_NAMES[record.level]));
+
+    int argIndex = 0;
+    const char* f = record.format;
+    while (*f != '\0' && used < capacity - 1) {
+        if (*f != '%') {
+            line[used] = *f;
+            used += 1;
+            f += 1;
+            continue;
+        }
+        if (f[1] == '%') {
+            line[used] = '%';
+            used += 1;
+            f += 2;
+            continue;
+        }
+
+        // %[flags][width][.precision][length]conversion
+        char spec[32];
+        size_t specLength = 0;
+        spec[specLength++] = *f++;
+        while (*f != '\0' && strchr("-+ #0", *f) != NULL && specLength < 12) { spec[specLength++] = *f++; }
+        while (*f >= '0' && *f <= '9' && specLength < 20) { spec[specLength++] = *f++; }
+        if (*f == '.') {
+            spec[specLength++] = *f++;
+            while (*f >= '0' && *f <= '9' && specLength < 26) { spec[specLength++] = *f++; }
+        }
+        while (*f != '\0' && strchr("hlzjtL", *f) != NULL) { f++; } // длина берется из захваченного типа
+        char conversion = *f;
+        if (conversion == '\0') { break; }
+        f++;
+
+        char* out = line + used;
+        size_t left = capacity - used;
+        if (argIndex >= record.argsCount) {
+            append(snprintf(out, left, "(missing)"));
+            continue;
+        }
+        const LogArg& arg = record.args[argIndex];
+        argIndex += 1;
+
+        if (strchr("diouxXc", conversion) != NULL) {
+            if (conversion != 'c') {
+                spec[specLength++] = 'l';
+                spec[specLength++] = 'l';
+            }
+            spec[specLength++] = conversion;
+            spec[specLength] = '\0';
+            long long value = arg.type == LogArgType::logArgDouble ? (long long) arg.d : (long long) arg.i;
+            if (conversion == 'c') {
+                append(snprintf(out, left, spec, (int) value));
+            } else {
+                append(snprintf(out, left, spec, value));
+            }
+        } else if (strchr("fFeEgGaA", conversion) != NULL) {
+            spec[specLength++] = conversion;
+            spec[specLength] = '\0';
+            double value = arg.type == LogArgType::logArgDouble ? arg.d
+                    : arg.type == LogArgType::logArgUint ? (double) arg.u : (double) arg.i;
+            append(snprintf(out, left, spec, value));
+        } else if (conversion == 's') {
+            spec[specLength++] = 's';
+            spec[specLength] = '\0';
+            const char* text = arg.type == LogArgType::logArgText ? record.text + arg.textOffset : "(?)";
+            append(snprintf(out, left, spec, text));
+        } else if (conversion == 'p') {
+            append(snprintf(out, left, "%p", arg.type == LogArgType::logArgPointer ? arg.p : NULL));
+        } else {
+            append(snprintf(out, left, "(?)"));
+        }
+    }
+
+    if (record.suppressed > 0) {
+        append(snprintf(line + used, capacity - used, " (%u similar suppressed)", record.suppressed));
+    }
+    line[used] = '\n';
+    used += 1;
+    return used;
+}
+
+template<typename... Args>
+void logWrite(int level, LogSite* site, const char* format, const Args&... args) {
+    uint64_t now = logNowUs();
+    uint32_t suppressed = 0;
+    if (!site->allow(now, &suppressed)) { return; }
+
+    LogRecord record;
+    record.level = (uint8_t) level;
+    record.argsCount = 0;
+    record.textUsed = 0;
+    record.suppressed = suppressed;
+    record.timeUs = now;
+    record.format = format;
+    (logCapture(&record, args), ...);
+    Logger::get().push(record);
+}
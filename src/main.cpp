@@ -12,12 +12,20 @@ int main( int argc, char* args[] )
 {
     std::srand(time(NULL));
 
-    auto app = Tetris_initApplication();
+    GameConfig config;
+    if (!parseGameConfig(argc, args, &config)) {
+        return 1;
+    }
+    // Набор фигур - до запуска потоков игры: дальше таблицы только читаются
+    if (config.piecesPath != NULL && !PieceSet::load(config.piecesPath)) {
+        return 1;
+    }
+
+    auto app = Tetris_initApplication(config);
 
     bool doLoop = true;
     while (doLoop) {
-        std::this_thread::sleep_for(20ms);
-        doLoop = app.tick(0.02);
+        doLoop = app.tick();
     }
 
     Tetris_closeApplication(&app);
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "game.cpp"
+
+// Сдвиг индекса столбца: начало фигуры может быть левее поля (пустые столбцы ее квадрата)
+#define MOVEGEN_X_PAD (PIECE_BOX_MAX - 1)
+#define MOVEGEN_COLUMNS (FIELD_W_MAX + MOVEGEN_X_PAD)
+#define MOVEGEN_ROTATIONS PIECE_ORIENTATIONS_MAX
+#define MOVEGEN_ROWS_MASK ((uint32_t) (((uint64_t) 1 << FIELD_H) - 1))
+
+// Место фиксации: ориентация (variant % shapeOrientations) и начало фигуры
+struct Placement {
+    int8_t variant;
+    int16_t x;
+    int16_t y;
+};
+
+// =============
+// MoveGen: все различные места фиксации фигуры, достижимые по правилам игры из точки появления:
+// сдвиги, поворот (только по часовой, без отскоков от стен) и падение, фиксация - когда падать некуда.
+// Все y столбца обрабатываются одним 32-битным словом: где фигура помещается - по маскам
+// столбцов поля, заливка достижимых положений - сдвигами масок до неподвижной точки.
+
+class MoveGen {
+private:
+    uint32_t fits[MOVEGEN_ROTATIONS][MOVEGEN_COLUMNS]; // бит y - фигура помещается в (x, y)
+    uint32_t reach[MOVEGEN_ROTATIONS][MOVEGEN_COLUMNS]; // бит y - положение достижимо
+
+    // Маски столбцов ориентации: каждый столбец поля читается один раз на столбец фигуры
+    template<typename Field>
+    void computeFits(const Field& field, const PieceOrientation& orientation, uint32_t* columnFits) {
+        int width = field.getWidth();
+        for (int i = 0; i < width + MOVEGEN_X_PAD; i++) {
+            int x = i - MOVEGEN_X_PAD;
+            if (x + orientation.minX < 0 || x + orientation.maxX >= width) {
+                columnFits[i] = 0;
+                continue;
+            }
+            uint32_t mask = MOVEGEN_ROWS_MASK;
+            for (int dx = orientation.minX; dx <= orientation.maxX && mask != 0; dx++) {
+                // Клетки (x + dx, y + dy) свободны и не ниже дна
+                uint32_t free = ~field.columnBits(x + dx) & MOVEGEN_ROWS_MASK;
+                uint32_t tiles = orientation.columnMasks[dx];
+                while (tiles != 0) {
+                    mask &= free >> countTrailingZeros32(tiles);
+                    tiles &= tiles - 1;
+                }
+            }
+            columnFits[i] = mask;
+        }
+    }
+
+    // Падение: каждое достижимое положение продолжается вниз, пока фигура помещается
+    static uint32_t fillDown(uint32_t reached, uint32_t fits) {
+        while (true) {
+            uint32_t next = reached | ((reached << 1) & fits);
+            if (next == reached) { return reached; }
+            reached = next;
+        }
+    }
+
+public:
+    MoveGen(): fits(), reach() {}
+
+    // Дописывает места фиксации в out. Возвращает их число (0, если фигуре негде появиться).
+    // Field - TetroField или другое поле с getWidth() и columnBits(x) в тех же координатах.
+    template<typename Field>
+    int generate(const Field& field, TetroShapeClass clazz, std::vector<Placement>* out) {
+        int width = field.getWidth();
+        int columns = width + MOVEGEN_X_PAD;
+        const PieceSet& pieces = PieceSet::active();
+        int orientations = pieces.orientations(clazz);
+        for (int v = 0; v < orientations; v++) {
+            this->computeFits(field, pieces.orientation(clazz, v), this->fits[v]);
+            std::fill(this->reach[v], this->reach[v] + columns, 0);
+        }
+
+        int spawn = spawnShapeX(width, clazz) + MOVEGEN_X_PAD;
+        if ((this->fits[0][spawn] & 1) == 0) { return 0; }
+        this->reach[0][spawn] = 1;
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int v = 0; v < orientations; v++) {
+                uint32_t* reach = this->reach[v];
+                const uint32_t* fits = this->fits[v];
+                // Сдвиги вправо и влево с падением: проходы в обе стороны, пока что-то добавляется
+                bool spread = true;
+                while (spread) {
+                    spread = false;
+                    for (int i = 0; i < columns; i++) {
+                        uint32_t reached = reach[i];
+                        if (i > 0) { reached |= reach[i - 1] & fits[i]; }
+                        reached = fillDown(reached, fits[i]);
+                        if (reached != reach[i]) { reach[i] = reached; spread = true; }
+                    }
+                    for (int i = columns - 2; i >= 0; i--) {
+                        uint32_t reached = reach[i] | (reach[i + 1] & fits[i]);
+                        reached = fillDown(reached, fits[i]);
+                        if (reached != reach[i]) { reach[i] = reached; spread = true; }
+                    }
+                }
+                // Поворот на месте в следующую ориентацию
+                int nextV = (v + 1) % orientations;
+                for (int i = 0; i < columns; i++) {
+                    uint32_t rotated = reach[i] & this->fits[nextV][i];
+                    if ((rotated & ~this->reach[nextV][i]) != 0) {
+                        this->reach[nextV][i] |= rotated;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        int count = 0;
+        for (int v = 0; v < orientations; v++) {
+            for (int i = 0; i < columns; i++) {
+                // Фиксация: положение достижимо, а на строку ниже фигура уже не помещается
+                uint32_t locks = this->reach[v][i] & ~(this->fits[v][i] >> 1);
+                while (locks != 0) {
+                    int y = countTrailingZeros32(locks);
+                    locks &= locks - 1;
+                    out->push_back(Placement { (int8_t) v, (int16_t) (i - MOVEGEN_X_PAD), (int16_t) y });
+                    count += 1;
+                }
+            }
+        }
+        return count;
+    }
+};
+
+// Фиксирует фигуру в поле и убирает полные строки (режим очистки линий).
+// Возвращает false, если фигура осталась выше видимой части поля - партия проиграна.
+bool applyPlacement(TetroField* field, TetroShapeClass clazz, const Placement& placement) {
+    const PieceOrientation& orientation = PieceSet::active().orientation(clazz, placement.variant);
+    for (int i = 0; i < orientation.tilesCount; i++) {
+        field->set(placement.x + orientation.offsetsX[i], placement.y + orientation.offsetsY[i], std::optional(TetroColor::red));
+    }
+    field->removeFullLines();
+    for (int y = 0; y < VIEWABLE_FIELD_Y; y++) {
+        if (!field->lineIsEmpty(y)) { return false; }
+    }
+    return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstring>
+#include "transport.cpp"
+#include "../ring_buffer.cpp"
+#include "../utils.cpp"
+
+#define LOOPBACK_QUEUE_SIZE 128
+
+// =============
+// Loopback: два конца в одном процессе, с задержкой и потерями.
+// Время - кадры симуляции, поэтому прогон полностью воспроизводим.
+
+class LoopbackPacket {
+public:
+    uint32_t deliverFrame;
+    uint16_t size;
+    uint8_t data[NET_PACKET_MAX];
+
+    LoopbackPacket(): deliverFrame(0), size(0), data() {}
+};
+
+class LoopbackLink {
+public:
+    RingBuffer<LoopbackPacket, LOOPBACK_QUEUE_SIZE> queues[2]; // queues[i] - пакеты для конца i
+    uint32_t frame;
+    int delayFrames;
+    int lossPercent;
+    uint32_t randomState;
+
+    LoopbackLink(int delayFrames, int lossPercent):
+            queues(),
+            frame(0),
+            delayFrames(delayFrames),
+            lossPercent(lossPercent),
+            randomState(0x2545F491u) {}
+
+    LoopbackLink(const LoopbackLink&) = delete;
+
+    void advance() {
+        this->frame += 1;
+    }
+
+    bool lost() {
+        // xorshift32: свой генератор, чтобы не трогать std::rand игры
+        return (int) (xorshift32(&this->randomState) % 100) < this->lossPercent;
+    }
+};
+
+class LoopbackTransport: public NetTransport {
+private:
+    LoopbackLink* link;
+    int side;
+
+public:
+    LoopbackTransport(LoopbackLink* link, int side): link(link), side(side) {}
+
+    bool send(const void* data, size_t size) override {
+        auto& queue = this->link->queues[1 - this->side];
+        if (size > NET_PACKET_MAX || queue.full()) { return false; }
+        if (this->link->lost()) { return true; }
+
+        LoopbackPacket packet;
+        packet.deliverFrame = this->link->frame + this->link->delayFrames;
+        packet.size = (uint16_t) size;
+        memcpy(packet.data, data, size);
+        queue.pushBack(packet);
+        return true;
+    }
+
+    size_t receive(void* buffer, size_t capacity) override {
+        auto& queue = this->link->queues[this->side];
+        if (queue.empty() || queue.at(0).deliverFrame > this->link->frame) { return 0; }
+
+        const LoopbackPacket& packet = queue.at(0);
+        size_t size = packet.size < capacity ? packet.size : capacity;
+        memcpy(buffer, packet.data, size);
+        queue.popFront();
+        return size;
+    }
+};
@@ -0,0 +1,407 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include "../log.cpp"
+#include "../game.cpp"
+#include "../frame_input.cpp"
+#include "transport.cpp"
+#include "loopback_transport.cpp"
+#include "udp_transport.cpp"
+
+#define NET_PLAYERS 2
+// На сколько кадров симуляция может уйти вперед от подтвержденного ввода соперника.
+// Столько же кадров в худшем случае пересчитывается за один тик.
+#define ROLLBACK_MAX_FRAMES 10
+// Сохраненные состояния; степень двойки больше ROLLBACK_MAX_FRAMES
+#define ROLLBACK_WINDOW 16
+// Ввод собственного игрока применяется с задержкой - меньше откатов при малом пинге
+#define NET_INPUT_DELAY 2
+// История ввода; степень двойки
+#define NET_INPUT_HISTORY 64
+// Сколько последних кадров ввода повторяет каждый пакет (защита от потерь)
+#define NET_INPUT_REDUNDANCY 24
+#define NET_PACKET_MAGIC 0x54524E31u
+
+// Пакет: подтверждение и последние кадры ввода отправителя.
+// match - номер партии у игрока 0. match = 0 от игрока 1 - он вышел из партии seed
+// и ждет новую.
+struct NetPacket {
+    uint32_t magic;
+    uint32_t match;
+    uint32_t seed;
+    int32_t ackFrame; // последний кадр соперника, полученный без пропусков
+    int32_t firstFrame;
+    uint8_t count;
+    FrameInput inputs[NET_INPUT_REDUNDANCY];
+};
+static_assert(sizeof(NetPacket) <= NET_PACKET_MAX, "Net packet too large");
+
+// =============
+// Состояние, которое сохраняется и восстанавливается при откате
+
+class NetFrameState {
+public:
+    FramePlayer players[NET_PLAYERS];
+
+    NetFrameState(): players() {}
+
+    // Один детерминированный кадр: ввод задан битами, время - номером кадра
+    void step(const FrameInput inputs[NET_PLAYERS], int frame, float frameDt, uint32_t frameMs) {
+        uint32_t time = (uint32_t) frame * frameMs;
+
+        for (int p = 0; p < NET_PLAYERS; p++) {
+            this->players[p].step(inputs[p], p, time, frameDt, frameMs);
+        }
+
+        // Мусор за очищенные линии уходит сопернику после шага обоих игроков
+        int garbage0 = this->players[0].game.takeOutgoingGarbage();
+        int garbage1 = this->players[1].game.takeOutgoingGarbage();
+        if (garbage0 > 0) { this->players[1].game.raiseGarbage(garbage0); }
+        if (garbage1 > 0) { this->players[0].game.raiseGarbage(garbage1); }
+    }
+
+    // Для сравнения состояний двух сторон (проверка детерминизма)
+    uint32_t checksum() const {
+        uint32_t hash = 2166136261u;
+        auto mix = [&hash](uint32_t value) { hash = (hash ^ value) * 16777619u; };
+        for (auto& player : this->players) {
+            const TetroGame& game = player.game;
+            for (int y = 0; y < FIELD_H; y++) {
+                if (game.field.lineIsEmpty(y)) { mix(0xFFFF); continue; }
+                for (int x = 0; x < game.field.getWidth(); x++) {
+                    auto tile = game.field.getAssured(x, y);
+                    mix(tile.has_value() ? tile.value() + 1 : 0);
+                }
+            }
+            mix((uint32_t) game.score);
+            mix((uint32_t) game.level);
+            mix(game.isLose ? 1 : 0);
+            mix(game.random.state);
+            if (game.activeShape.has_value()) {
+                mix((uint32_t) game.activeShape.value().x);
+                mix((uint32_t) game.activeShape.value().y);
+                mix((uint32_t) game.activeShape.value().prototype.variant);
+            }
+        }
+        return hash;
+    }
+};
+
+// =============
+// RollbackSession: одна сторона сетевой партии на двоих.
+// Ввод соперника предсказывается повтором последнего известного; когда настоящий
+// ввод приходит и не совпадает с предсказанием, состояние откатывается к этому кадру
+// и пропущенные кадры пересчитываются в том же тике.
+
+class RollbackStats {
+public:
+    uint64_t frames;
+    uint64_t rollbacks;
+    uint64_t resimulatedFrames;
+    int maxResimulated;
+    uint64_t stalls;
+    double stepSeconds; // время всех шагов симуляции, включая пересчет
+
+    RollbackStats(): frames(0), rollbacks(0), resimulatedFrames(0), maxResimulated(0), stalls(0), stepSeconds(0.0) {}
+};
+
+class RollbackSession {
+private:
+    NetTransport* transport;
+    int localPlayer;
+    GameConfig config; // правила партии должны совпадать у обеих сторон
+    float frameDt;
+    uint32_t frameMs;
+
+    bool started;
+    uint32_t match;
+    uint32_t seed;
+
+    int frame; // следующий кадр для симуляции
+    NetFrameState current;
+    NetFrameState saved[ROLLBACK_WINDOW]; // saved[f % WINDOW] - состояние перед кадром f
+
+    FrameInput localInputs[NET_INPUT_HISTORY];
+    int localInputFrame; // последний кадр с известным своим вводом
+    FrameInput remoteInputs[NET_INPUT_HISTORY];
+    int remoteConfirmed; // последний кадр соперника, полученный без пропусков
+    FrameInput usedRemote[NET_INPUT_HISTORY]; // чем был предсказан ввод соперника при симуляции кадра
+    int peerAck;
+    int rollbackFrom;
+
+public:
+    RollbackStats stats;
+    bool recordChecksums;
+    uint32_t checksums[NET_INPUT_HISTORY]; // checksums[f] - состояние перед кадром f
+
+    RollbackSession(NetTransport* transport, int localPlayer, const GameConfig& config, float frameDt):
+            transport(transport),
+            localPlayer(localPlayer),
+            config(config),
+            frameDt(frameDt),
+            frameMs((uint32_t) (frameDt * 1000.0f + 0.5f)),
+            started(false),
+            match(0),
+            seed(0),
+            frame(0),
+            current(),
+            saved(),
+            localInputs(),
+            localInputFrame(-1),
+            remoteInputs(),
+            remoteConfirmed(-1),
+            usedRemote(),
+            peerAck(-1),
+            rollbackFrom(-1),
+            stats(),
+            recordChecksums(false),
+            checksums() {}
+
+    RollbackSession(const RollbackSession&) = delete;
+
+    const NetFrameState& state() const {
+        return this->current;
+    }
+
+    int currentFrame() const {
+        return this->frame;
+    }
+
+    int confirmedFrame() const {
+        return this->remoteConfirmed;
+    }
+
+    // Новая партия. Зерно выбирает игрок 0, игрок 1 ждет его пакетов.
+    void restart(uint32_t newSeed) {
+        this->started = false;
+        if (this->localPlayer == 0) {
+            this->match += 1;
+            this->seed = newSeed;
+            this->begin();
+        } else {
+            this->seed = 0;
+        }
+    }
+
+    void tick(FrameInput localInput) {
+        this->receivePackets();
+
+        if (this->started) {
+            if (this->rollbackFrom >= 0 && this->rollbackFrom < this->frame) {
+                this->rollback(this->rollbackFrom);
+            }
+            this->rollbackFrom = -1;
+
+            if (this->frame - this->remoteConfirmed <= ROLLBACK_MAX_FRAMES) {
+                this->localInputFrame += 1;
+                this->localInputs[this->localInputFrame % NET_INPUT_HISTORY] = localInput;
+                this->simulate(this->frame);
+                this->frame += 1;
+            } else {
+                // Соперник слишком отстал: ждем, а не уходим дальше окна отката
+                this->stats.stalls += 1;
+            }
+        }
+
+        this->sendPacket();
+    }
+
+private:
+    void begin() {
+        this->started = true;
+        this->frame = 0;
+        this->current = NetFrameState();
+        for (int p = 0; p < NET_PLAYERS; p++) {
+            this->current.players[p].game = TetroGame(this->config);
+            this->current.players[p].game.reset(this->seed);
+        }
+        // Первые кадры задержки ввода - без нажатий
+        this->localInputFrame = NET_INPUT_DELAY - 1;
+        for (int f = 0; f < NET_INPUT_DELAY; f++) { this->localInputs[f] = 0; }
+        this->remoteConfirmed = -1;
+        this->peerAck = -1;
+        this->rollbackFrom = -1;
+    }
+
+    FrameInput remoteInputFor(int f) {
+        if (f <= this->remoteConfirmed) { return this->remoteInputs[f % NET_INPUT_HISTORY]; }
+        if (this->remoteConfirmed < 0) { return 0; }
+        return this->remoteInputs[this->remoteConfirmed % NET_INPUT_HISTORY];
+    }
+
+    void simulate(int f) {
+        this->saved[f % ROLLBACK_WINDOW] = this->current;
+        if (this->recordChecksums) {
+            this->checksums[f % NET_INPUT_HISTORY] = this->current.checksum();
+        }
+
+        FrameInput inputs[NET_PLAYERS];
+        FrameInput remote = this->remoteInputFor(f);
+        inputs[this->localPlayer] = this->localInputs[f % NET_INPUT_HISTORY];
+        inputs[1 - this->localPlayer] = remote;
+        this->usedRemote[f % NET_INPUT_HISTORY] = remote;
+
+        auto start = std::chrono::steady_clock::now();
+        this->current.step(inputs, f, this->frameDt, this->frameMs);
+        this->stats.stepSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        this->stats.frames += 1;
+    }
+
+    void rollback(int fromFrame) {
+        this->current = this->saved[fromFrame % ROLLBACK_WINDOW];
+        int resimulated = this->frame - fromFrame;
+        for (int f = fromFrame; f < this->frame; f++) {
+            this->simulate(f);
+        }
+        this->stats.rollbacks += 1;
+        this->stats.resimulatedFrames += resimulated;
+        if (resimulated > this->stats.maxResimulated) { this->stats.maxResimulated = resimulated; }
+    }
+
+    void receivePackets() {
+        NetPacket packet;
+        size_t size;
+        while ((size = this->transport->receive(&packet, sizeof(packet))) != 0) {
+            if (size != sizeof(packet) || packet.magic != NET_PACKET_MAGIC) { continue; }
+            this->handlePacket(packet);
+        }
+    }
+
+    void handlePacket(const NetPacket& packet) {
+        if (this->localPlayer == 0) {
+            if (packet.match == 0) {
+                // Соперник вышел из текущей партии - начинаем новую
+                if (this->match != 0 && packet.seed == this->match) { this->restart(this->seed * 2654435761u + 1); }
+                return;
+            }
+            if (packet.match != this->match) { return; }
+        } else {
+            if (packet.match > this->match) {
+                // Новая партия игрока 0
+                this->match = packet.match;
+                this->seed = packet.seed;
+                this->begin();
+            }
+            if (packet.match != this->match || !this->started) { return; }
+        }
+
+        if (packet.ackFrame > this->peerAck) { this->peerAck = packet.ackFrame; }
+
+        // Принимаются только кадры подряд после уже подтвержденных
+        for (int i = 0; i < packet.count && i < NET_INPUT_REDUNDANCY; i++) {
+            int f = packet.firstFrame + i;
+            if (f != this->remoteConfirmed + 1) { continue; }
+            FrameInput input = packet.inputs[i];
+            this->remoteInputs[f % NET_INPUT_HISTORY] = input;
+            this->remoteConfirmed = f;
+
+            bool mispredicted = f < this->frame && this->usedRemote[f % NET_INPUT_HISTORY] != input;
+            if (mispredicted && (this->rollbackFrom < 0 || f < this->rollbackFrom)) {
+                this->rollbackFrom = f;
+            }
+        }
+    }
+
+    void sendPacket() {
+        NetPacket packet;
+        memset(&packet, 0, sizeof(packet));
+        packet.magic = NET_PACKET_MAGIC;
+        if (this->localPlayer == 1 && !this->started) {
+            packet.match = 0;
+            packet.seed = this->match;
+        } else {
+            packet.match = this->match;
+            packet.seed = this->seed;
+        }
+        packet.ackFrame = this->remoteConfirmed;
+
+        if (this->started) {
+            int first = this->peerAck + 1;
+            if (first < this->localInputFrame - NET_INPUT_REDUNDANCY + 1) { first = this->localInputFrame - NET_INPUT_REDUNDANCY + 1; }
+            if (first < 0) { first = 0; }
+            int count = this->localInputFrame - first + 1;
+            if (count < 0) { count = 0; }
+            packet.firstFrame = first;
+            packet.count = (uint8_t) count;
+            for (int i = 0; i < count; i++) {
+                packet.inputs[i] = this->localInputs[(first + i) % NET_INPUT_HISTORY];
+            }
+        }
+        this->transport->send(&packet, sizeof(packet));
+    }
+};
+
+// =============
+// NetVersus: партия на двоих по сети или через loopback на одной машине.
+// В режиме loopback обе стороны живут в этом процессе, а показывается сторона игрока 0.
+
+class NetVersus {
+private:
+    std::unique_ptr<LoopbackLink> link;
+    std::unique_ptr<NetTransport> transports[NET_PLAYERS];
+    std::unique_ptr<RollbackSession> sessions[NET_PLAYERS];
+    int sessionsCount;
+
+public:
+    NetVersus(const GameConfig& config, float frameDt): sessionsCount(0) {
+        if (strcmp(config.versus, "loopback") == 0) {
+            int delayFrames = (int) ((float) config.netDelayMs / (frameDt * 1000.0f) + 0.5f);
+            this->link = std::make_unique<LoopbackLink>(delayFrames, config.netLossPercent);
+            for (int p = 0; p < NET_PLAYERS; p++) {
+                this->transports[p] = std::make_unique<LoopbackTransport>(this->link.get(), p);
+                this->sessions[p] = std::make_unique<RollbackSession>(this->transports[p].get(), p, config, frameDt);
+            }
+            this->sessionsCount = NET_PLAYERS;
+        } else {
+            // HOST:PORT
+            char host[256];
+            const char* colon = strrchr(config.versus, ':');
+            size_t hostLength = colon != NULL ? (size_t) (colon - config.versus) : 0;
+            if (colon == NULL || hostLength == 0 || hostLength >= sizeof(host)) {
+                LOG_ERROR("Invalid versus address: %s", config.versus);
+                throw std::runtime_error("Invalid versus address");
+            }
+            memcpy(host, config.versus, hostLength);
+            host[hostLength] = '\0';
+            int remotePort = atoi(colon + 1);
+
+            this->transports[0] = std::make_unique<UdpTransport>(host, remotePort, config.netPort);
+            this->sessions[0] = std::make_unique<RollbackSession>(this->transports[0].get(), config.netPlayer, config, frameDt);
+            this->sessionsCount = 1;
+        }
+    }
+
+    NetVersus(const NetVersus&) = delete;
+
+    void restart(uint32_t seed) {
+        for (int i = 0; i < this->sessionsCount; i++) {
+            this->sessions[i]->restart(seed);
+        }
+    }
+
+    // boardInputs[i] - клавиши i-го локального игрока
+    void tick(InputState* boardInputs) {
+        if (this->link) { this->link->advance(); }
+        for (int i = 0; i < this->sessionsCount; i++) {
+            this->sessions[i]->tick(frameInputFromState(boardInputs[i]));
+        }
+    }
+
+    const TetroGame& game(int player) const {
+        return this->sessions[0]->state().players[player].game;
+    }
+
+    void report() {
+        for (int i = 0; i < this->sessionsCount; i++) {
+            const RollbackStats& stats = this->sessions[i]->stats;
+            double usPerFrame = stats.frames > 0 ? stats.stepSeconds * 1e6 / (double) stats.frames : 0.0;
+            LOG_INFO("Rollback session %d: %llu frames simulated, %llu rollbacks, %llu resimulated (max %d per tick), %llu stalls, %.1f us per frame",
+                   i, (unsigned long long) stats.frames, (unsigned long long) stats.rollbacks,
+                   (unsigned long long) stats.resimulatedFrames, stats.maxResimulated,
+                   (unsigned long long) stats.stalls, usPerFrame);
+        }
+    }
+};
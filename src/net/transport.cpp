@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define NET_PACKET_MAX 512
+
+// =============
+// NetTransport: ненадежная доставка датаграмм. Пакеты могут теряться и
+// опаздывать - протокол отката это переживает, поэтому ошибки отправки не фатальны.
+
+class NetTransport {
+public:
+    virtual ~NetTransport() = default;
+
+    // false - пакет не ушел
+    virtual bool send(const void* data, size_t size) = 0;
+
+    // Размер принятого пакета, 0 - пакетов больше нет. Не блокирует.
+    virtual size_t receive(void* buffer, size_t capacity) = 0;
+};
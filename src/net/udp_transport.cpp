@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include "../log.cpp"
+#include "transport.cpp"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using NetSocket = SOCKET;
+#define NET_INVALID_SOCKET INVALID_SOCKET
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using NetSocket = int;
+#define NET_INVALID_SOCKET (-1)
+#endif
+
+// =============
+// UdpTransport: неблокирующий UDP-сокет, связанный с одним соперником
+
+class UdpTransport: public NetTransport {
+private:
+    NetSocket socketHandle;
+    sockaddr_storage remoteAddress;
+    socklen_t remoteAddressSize;
+
+    void closeSocket() {
+        if (this->socketHandle == NET_INVALID_SOCKET) { return; }
+#ifdef _WIN32
+        closesocket(this->socketHandle);
+        WSACleanup();
+#else
+        close(this->socketHandle);
+#endif
+        this->socketHandle = NET_INVALID_SOCKET;
+    }
+
+    void fail(const char* what) {
+        LOG_ERROR("UDP transport: %s", what);
+        this->closeSocket();
+        throw std::runtime_error("Unable open UDP transport");
+    }
+
+public:
+    UdpTransport(const char* remoteHost, int remotePort, int localPort):
+            socketHandle(NET_INVALID_SOCKET),
+            remoteAddress(),
+            remoteAddressSize(0) {
+#ifdef _WIN32
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+            LOG_ERROR("UDP transport: WSAStartup failed");
+            throw std::runtime_error("Unable open UDP transport");
+        }
+#endif
+        char portText[16];
+        snprintf(portText, sizeof(portText), "%d", remotePort);
+
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* resolved = NULL;
+        if (getaddrinfo(remoteHost, portText, &hints, &resolved) != 0 || resolved == NULL) {
+            LOG_ERROR("UDP transport: unable resolve %s", remoteHost);
+            throw std::runtime_error("Unable open UDP transport");
+        }
+        memcpy(&this->remoteAddress, resolved->ai_addr, resolved->ai_addrlen);
+        this->remoteAddressSize = (socklen_t) resolved->ai_addrlen;
+        freeaddrinfo(resolved);
+
+        this->socketHandle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (this->socketHandle == NET_INVALID_SOCKET) { this->fail("unable create socket"); }
+
+        sockaddr_in local;
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        local.sin_port = htons((uint16_t) localPort);
+        if (bind(this->socketHandle, (const sockaddr*) &local, sizeof(local)) != 0) { this->fail("unable bind local port"); }
+
+#ifdef _WIN32
+        u_long nonBlocking = 1;
+        bool isNonBlocking = ioctlsocket(this->socketHandle, FIONBIO, &nonBlocking) == 0;
+#else
+        bool isNonBlocking = fcntl(this->socketHandle, F_SETFL, fcntl(this->socketHandle, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+        if (!isNonBlocking) { this->fail("unable make socket non-blocking"); }
+
+        LOG_INFO("UDP transport: port %d -> %s:%d", localPort, remoteHost, remotePort);
+    }
+
+    UdpTransport(const UdpTransport&) = delete;
+
+    ~UdpTransport() override {
+        this->closeSocket();
+    }
+
+    bool send(const void* data, size_t size) override {
+        auto sent = sendto(this->socketHandle, (const char*) data, (int) size, 0, (const sockaddr*) &this->remoteAddress, this->remoteAddressSize);
+        return sent == (decltype(sent)) size;
+    }
+
+    size_t receive(void* buffer, size_t capacity) override {
+        while (true) {
+            sockaddr_storage from;
+            socklen_t fromSize = sizeof(from);
+            auto received = recvfrom(this->socketHandle, (char*) buffer, (int) capacity, 0, (sockaddr*) &from, &fromSize);
+            if (received <= 0) { return 0; }
+            // Пакеты не от соперника пропускаются
+            auto fromIn = (const sockaddr_in*) &from;
+            auto remoteIn = (const sockaddr_in*) &this->remoteAddress;
+            if (fromIn->sin_family != AF_INET || fromIn->sin_port != remoteIn->sin_port
+                || fromIn->sin_addr.s_addr != remoteIn->sin_addr.s_addr) { continue; }
+            return (size_t) received;
+        }
+    }
+};
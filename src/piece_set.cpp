@@ -0,0 +1,328 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "log.cpp"
+#include "shape_lines.cpp"
+
+// Ориентации фигуры задаются в квадрате со стороной до PIECE_BOX_MAX
+#define PIECE_BOX_MAX 8
+#define PIECE_TILES_MAX 16
+#define PIECE_ORIENTATIONS_MAX 4
+#define PIECE_CLASSES_MAX 32
+#define PIECE_NAME_MAX 8
+// Фигур в одном мешке вместе с дополнительными
+#define PIECE_BAG_MAX 32
+
+// =================================================
+// Формат файла набора фигур (// - комментарий до конца строки):
+//
+//   piece NAME [letter=C] [extra] [rotate]
+//   ....  ....        <- ориентации одна за другой через пробелы, '#' - плитка;
+//   .##.  .#..           каждая - квадрат N x N, строки сверху вниз
+//   ...
+//   bag NAME NAME ...   <- состав мешка (повторы - чаще выпадает); по умолчанию все не extra по разу
+//
+// rotate - ориентации получаются поворотом единственной сетки по часовой стрелке внутри квадрата,
+// пока фигура не совпадет с исходной. extra - только в режиме дополнительных плиток (--garbage),
+// по одной на мешок. letter - буква фигуры в очередях утилит (по умолчанию первая буква имени).
+
+// Ориентация, разобранная при загрузке: все, что нужно горячим проверкам, без разбора строк
+struct PieceOrientation {
+    int tilesCount;
+    int offsetsX[PIECE_TILES_MAX]; // по строкам сверху вниз, в строке слева направо
+    int offsetsY[PIECE_TILES_MAX];
+    uint32_t columnMasks[PIECE_BOX_MAX]; // бит dy - плитка в (dx, dy)
+    int minX, maxX, minY, maxY;
+    int parity; // плиток в четных столбцах минус в нечетных, если фигура стоит в четном x
+};
+
+struct PieceClass {
+    char name[PIECE_NAME_MAX];
+    char letter;
+    bool isExtra;
+    int boxSize;
+    int orientationsCount;
+    PieceOrientation orientations[PIECE_ORIENTATIONS_MAX];
+};
+
+// =============
+// PieceSet: набор фигур, скомпилированный в плотные таблицы. Класс фигуры (TetroShapeClass) -
+// индекс в classes. Набор процесса - active(): стандартный, пока не загружен другой;
+// меняется только до запуска игровых потоков.
+
+class PieceSet {
+public:
+    int count;
+    PieceClass classes[PIECE_CLASSES_MAX];
+    int bagCount;
+    uint8_t bag[PIECE_BAG_MAX];
+    int extraCount;
+    uint8_t extra[PIECE_BAG_MAX];
+    uint32_t fingerprint; // FNV-1a таблиц: сохранения и партии с другим набором несовместимы
+
+    PieceSet(): count(0), classes(), bagCount(0), bag(), extraCount(0), extra(), fingerprint(0) {}
+
+    static PieceSet& active() {
+        static PieceSet set = PieceSet::standard();
+        return set;
+    }
+
+    static PieceSet standard() {
+        PieceSet set;
+        if (!set.compile(STANDARD_PIECE_SET, "built-in")) {
+            LOG_FATAL("Built-in piece set is invalid");
+        }
+        return set;
+    }
+
+    // Заменяет набор процесса набором из файла. false - файл не прочитан или с ошибкой (в лог).
+    static bool load(const char* path) {
+        FILE* file = fopen(path, "rb");
+        if (file == NULL) {
+            LOG_ERROR("Unable open piece set: %s", path);
+            return false;
+        }
+        std::string text;
+        char chunk[4096];
+        size_t read;
+        while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            text.append(chunk, read);
+        }
+        fclose(file);
+
+        PieceSet set;
+        if (!set.compile(text.c_str(), path)) { return false; }
+        PieceSet::active() = set;
+        LOG_INFO("Piece set %s: %d pieces, %d in bag", path, set.count, set.bagCount);
+        return true;
+    }
+
+    const PieceOrientation& orientation(int clazz, int variant) const {
+        const PieceClass& piece = this->classes[clazz];
+        return piece.orientations[variant % piece.orientationsCount];
+    }
+
+    int orientations(int clazz) const {
+        return this->classes[clazz].orientationsCount;
+    }
+
+    // Плиток в самой крупной фигуре набора
+    int largestPiece() const {
+        int tiles = 0;
+        for (int i = 0; i < this->count; i++) {
+            tiles = std::max(tiles, this->classes[i].orientations[0].tilesCount);
+        }
+        return tiles;
+    }
+
+    // -1 - такой фигуры нет
+    int findByLetter(char letter) const {
+        for (int i = 0; i < this->count; i++) {
+            if (this->classes[i].letter == letter) { return i; }
+        }
+        return -1;
+    }
+
+    int findByName(const std::string& name) const {
+        for (int i = 0; i < this->count; i++) {
+            if (name == this->classes[i].name) { return i; }
+        }
+        return -1;
+    }
+
+    bool compile(const char* text, const char* source) {
+        *this = PieceSet();
+        std::vector<std::string> lines;
+        for (const char* c = text; *c != 0;) {
+            const char* end = c + strcspn(c, "\n");
+            std::string line(c, end);
+            size_t comment = line.find("//");
+            if (comment != std::string::npos) { line.resize(comment); }
+            lines.push_back(line);
+            c = *end == '\n' ? end + 1 : end;
+        }
+
+        bool hasBag = false;
+        for (size_t i = 0; i < lines.size(); i++) {
+            std::vector<std::string> tokens = splitTokens(lines[i]);
+            if (tokens.empty()) { continue; }
+            int lineNumber = (int) i + 1;
+
+            if (tokens[0] == "bag") {
+                if (hasBag) { return fail(source, lineNumber, "second bag line"); }
+                hasBag = true;
+                for (size_t t = 1; t < tokens.size(); t++) {
+                    int clazz = this->findByName(tokens[t]);
+                    if (clazz < 0) { return fail(source, lineNumber, "bag names unknown piece"); }
+                    if (this->classes[clazz].isExtra) { return fail(source, lineNumber, "extra piece in bag"); }
+                    if (this->bagCount == PIECE_BAG_MAX) { return fail(source, lineNumber, "bag is too large"); }
+                    this->bag[this->bagCount++] = (uint8_t) clazz;
+                }
+                continue;
+            }
+            if (tokens[0] != "piece" || tokens.size() < 2) { return fail(source, lineNumber, "expected 'piece NAME' or 'bag'"); }
+            if (this->count == PIECE_CLASSES_MAX) { return fail(source, lineNumber, "too many pieces"); }
+
+            PieceClass& piece = this->classes[this->count];
+            if (tokens[1].size() >= PIECE_NAME_MAX) { return fail(source, lineNumber, "piece name is too long"); }
+            if (this->findByName(tokens[1]) >= 0) { return fail(source, lineNumber, "duplicate piece name"); }
+            strcpy(piece.name, tokens[1].c_str());
+            piece.letter = tokens[1][0];
+            bool rotate = false;
+            for (size_t t = 2; t < tokens.size(); t++) {
+                if (tokens[t] == "extra") {
+                    piece.isExtra = true;
+                } else if (tokens[t] == "rotate") {
+                    rotate = true;
+                } else if (tokens[t].size() == 8 && tokens[t].compare(0, 7, "letter=") == 0) {
+                    piece.letter = tokens[t][7];
+                } else {
+                    return fail(source, lineNumber, "unknown piece option");
+                }
+            }
+            if (this->findByLetter(piece.letter) >= 0) { return fail(source, lineNumber, "duplicate piece letter"); }
+
+            // Сетки - следующие непустые строки
+            std::vector<std::vector<std::string>> rows;
+            while (i + 1 < lines.size()) {
+                std::vector<std::string> gridTokens = splitTokens(lines[i + 1]);
+                if (gridTokens.empty() || gridTokens[0] == "piece" || gridTokens[0] == "bag") { break; }
+                rows.push_back(gridTokens);
+                i += 1;
+            }
+            if (!this->compilePiece(rows, rotate, &piece)) { return fail(source, lineNumber, "invalid piece grid"); }
+            this->count += 1;
+        }
+
+        if (!hasBag) {
+            for (int i = 0; i < this->count && this->bagCount < PIECE_BAG_MAX; i++) {
+                if (!this->classes[i].isExtra) { this->bag[this->bagCount++] = (uint8_t) i; }
+            }
+        }
+        for (int i = 0; i < this->count; i++) {
+            if (this->classes[i].isExtra) { this->extra[this->extraCount++] = (uint8_t) i; }
+        }
+        if (this->bagCount == 0) { return fail(source, 0, "bag is empty"); }
+        if (this->bagCount + this->extraCount > PIECE_BAG_MAX) { return fail(source, 0, "bag with extra pieces is too large"); }
+
+        this->fingerprint = this->computeFingerprint();
+        return true;
+    }
+
+private:
+    static bool fail(const char* source, int line, const char* message) {
+        LOG_ERROR("Piece set %s:%d: %s", source, line, message);
+        return false;
+    }
+
+    static std::vector<std::string> splitTokens(const std::string& line) {
+        std::vector<std::string> tokens;
+        size_t i = 0;
+        while (i < line.size()) {
+            while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) { i++; }
+            size_t start = i;
+            while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r') { i++; }
+            if (i > start) { tokens.push_back(line.substr(start, i - start)); }
+        }
+        return tokens;
+    }
+
+    // rows[r][k] - строка r сетки ориентации k
+    bool compilePiece(const std::vector<std::vector<std::string>>& rows, bool rotate, PieceClass* piece) {
+        int size = (int) rows.size();
+        if (size == 0 || size > PIECE_BOX_MAX) { return false; }
+        int grids = (int) rows[0].size();
+        if (grids > PIECE_ORIENTATIONS_MAX || (rotate && grids != 1)) { return false; }
+        for (auto& row : rows) {
+            if ((int) row.size() != grids) { return false; }
+            for (auto& token : row) {
+                if ((int) token.size() != size) { return false; }
+            }
+        }
+        piece->boxSize = size;
+
+        std::vector<std::string> grid(size);
+        for (int k = 0; k < grids; k++) {
+            for (int r = 0; r < size; r++) { grid[r] = rows[r][k]; }
+            if (!compileOrientation(grid, &piece->orientations[k])) { return false; }
+            if (piece->orientations[k].tilesCount != piece->orientations[0].tilesCount) { return false; }
+        }
+        piece->orientationsCount = grids;
+        if (!rotate) { return true; }
+
+        // Поворот по часовой: (x, y) -> (size - 1 - y, x), пока фигура не совпадет с исходной
+        while (piece->orientationsCount < PIECE_ORIENTATIONS_MAX) {
+            std::vector<std::string> turned(size, std::string(size, '.'));
+            for (int y = 0; y < size; y++) {
+                for (int x = 0; x < size; x++) { turned[x][size - 1 - y] = grid[y][x]; }
+            }
+            grid = turned;
+            PieceOrientation next;
+            compileOrientation(grid, &next);
+            if (sameShape(next, piece->orientations[0])) { break; }
+            piece->orientations[piece->orientationsCount++] = next;
+        }
+        return true;
+    }
+
+    static bool compileOrientation(const std::vector<std::string>& grid, PieceOrientation* out) {
+        *out = PieceOrientation();
+        int size = (int) grid.size();
+        out->minX = size;
+        out->minY = size;
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                if (grid[y][x] != '#' && grid[y][x] != '.') { return false; }
+                if (grid[y][x] != '#') { continue; }
+                if (out->tilesCount == PIECE_TILES_MAX) { return false; }
+                out->offsetsX[out->tilesCount] = x;
+                out->offsetsY[out->tilesCount] = y;
+                out->tilesCount += 1;
+                out->columnMasks[x] |= (uint32_t) 1 << y;
+                out->minX = std::min(out->minX, x);
+                out->maxX = std::max(out->maxX, x);
+                out->minY = std::min(out->minY, y);
+                out->maxY = std::max(out->maxY, y);
+                out->parity += x % 2 == 0 ? 1 : -1;
+            }
+        }
+        return out->tilesCount > 0;
+    }
+
+    // Одинаковая фигура с точностью до сдвига (плитки перечислены в одном порядке)
+    static bool sameShape(const PieceOrientation& a, const PieceOrientation& b) {
+        if (a.tilesCount != b.tilesCount) { return false; }
+        for (int i = 0; i < a.tilesCount; i++) {
+            if (a.offsetsX[i] - a.minX != b.offsetsX[i] - b.minX || a.offsetsY[i] - a.minY != b.offsetsY[i] - b.minY) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint32_t computeFingerprint() const {
+        uint32_t hash = 2166136261u;
+        auto mix = [&hash](uint32_t value) { hash = (hash ^ value) * 16777619u; };
+        mix((uint32_t) this->count);
+        for (int i = 0; i < this->count; i++) {
+            const PieceClass& piece = this->classes[i];
+            for (const char* c = piece.name; *c != 0; c++) { mix((uint8_t) *c); }
+            mix(piece.isExtra ? 1 : 0);
+            mix((uint32_t) piece.orientationsCount);
+            for (int v = 0; v < piece.orientationsCount; v++) {
+                const PieceOrientation& orientation = piece.orientations[v];
+                mix((uint32_t) orientation.tilesCount);
+                for (int t = 0; t < orientation.tilesCount; t++) {
+                    mix((uint32_t) (orientation.offsetsX[t] * PIECE_BOX_MAX + orientation.offsetsY[t]));
+                }
+            }
+        }
+        for (int i = 0; i < this->bagCount; i++) { mix(this->bag[i]); }
+        return hash;
+    }
+};
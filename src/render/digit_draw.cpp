@@ -4,10 +4,10 @@
 #define DIGIT_TEX_W 24
 #define DIGIT_TEX_H 32
 
-void drawNumber(SDL_Renderer* renderer, Texture* texture, int x, int y, int number, int length) {
+// digitW, digitH - размер цифры на экране
+void drawNumber(SDL_Renderer* renderer, Texture* texture, int x, int y, int number, int length, int digitW, int digitH) {
     if (length > 10) {
-        printf("Invalid number length");
-        exit(1);
+        LOG_FATAL("Invalid number length %d", length);
     }
 
     int w = texture->width();
@@ -37,10 +37,14 @@ void drawNumber(SDL_Renderer* renderer, Texture* texture, int x, int y, int numb
         int texY = 0;
 
         SDL_Rect srcRect = SDL_Rect { texX, texY, DIGIT_TEX_W, DIGIT_TEX_H };
-        SDL_Rect dstRect = SDL_Rect { x + dx, y, DIGIT_TEX_W, DIGIT_TEX_H };
+        SDL_Rect dstRect = SDL_Rect { x + dx, y, digitW, digitH };
 
-        SDL_RenderCopy(renderer, texture->sldHandle(), &srcRect, &dstRect);
+        SDL_CHECK(SDL_RenderCopy(renderer, texture->sldHandle(), &srcRect, &dstRect));
 
-        dx += DIGIT_TEX_W;
+        dx += digitW;
     }
 }
+
+void drawNumber(SDL_Renderer* renderer, Texture* texture, int x, int y, int number, int length) {
+    drawNumber(renderer, texture, x, y, number, length, DIGIT_TEX_W, DIGIT_TEX_H);
+}
@@ -1,10 +1,21 @@
+#pragma once
+
 #include "../utils.cpp"
+#include "../log.cpp"
+#include <new>
+#include <utility>
+
+// Ошибка SDL проверяется там, где она возникла, вместо опроса SDL_GetError каждый тик.
+// Сообщения ограничены по частоте логгером, так что ошибка в каждом кадре не забьет вывод.
+#define SDL_CHECK(call) do { \
+    if ((call) != 0) { LOG_WARN("%s failed: %s", #call, SDL_GetError()); } \
+} while (0)
 
 
 SDL_Texture* loadTexture(SDL_Renderer* renderer, const char* path, int* width, int* height) {
     auto surface = SDL_LoadBMP(path);
     if (surface == NULL) {
-        printf("Unable load textureHandle: %s!\nSDL Error: %s\n", path, SDL_GetError());
+        LOG_ERROR("Unable load textureHandle: %s! SDL Error: %s", path, SDL_GetError());
         throw std::runtime_error("Error on load textureHandle");
     }
 
@@ -13,7 +24,7 @@ SDL_Texture* loadTexture(SDL_Renderer* renderer, const char* path, int* width, i
 
     auto texture = SDL_CreateTextureFromSurface(renderer, surface);
     if (texture == NULL) {
-        printf("Unable create textureHandle: %s!\nSDL Error: %s\n", path, SDL_GetError());
+        LOG_ERROR("Unable create textureHandle: %s! SDL Error: %s", path, SDL_GetError());
         throw std::runtime_error("Error on creating textureHandle");
     }
 
@@ -22,6 +33,23 @@ SDL_Texture* loadTexture(SDL_Renderer* renderer, const char* path, int* width, i
     return texture;
 }
 
+// Пиксели уже в нужном формате (из архива или после конвертации в фоне): только загрузка в GPU
+SDL_Texture* loadTextureFromPixels(SDL_Renderer* renderer, const char* name, Uint32 format, int width, int height, const void* pixels, int pitch, bool blend) {
+    auto texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STATIC, width, height);
+    if (texture == NULL) {
+        LOG_ERROR("Unable create textureHandle: %s! SDL Error: %s", name, SDL_GetError());
+        throw std::runtime_error("Error on creating textureHandle");
+    }
+    if (SDL_UpdateTexture(texture, NULL, pixels, pitch) != 0) {
+        SDL_DestroyTexture(texture);
+        LOG_ERROR("Unable upload textureHandle: %s! SDL Error: %s", name, SDL_GetError());
+        throw std::runtime_error("Error on uploading textureHandle");
+    }
+    if (blend) {
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    }
+    return texture;
+}
 
 class Texture {
 private:
@@ -31,8 +59,11 @@ private:
     int sizeHeight;
 
 public:
+    // Пустая текстура: ресурс еще не загружен
+    Texture(): textureHandle(NULL), sourcePath(NULL), sizeWidth(0), sizeHeight(0) {}
+
     Texture(SDL_Texture* texture, int width, int height) {
-        printf("Texture <no_path> created.\n");
+        LOG_DEBUG("Texture <no_path> created.");
 
         {
             this->textureHandle = texture;
@@ -46,7 +77,7 @@ public:
         int w = 0;
         int h = 0;
         auto t = loadTexture(renderer, path, &w, &h);
-        printf("Texture %s created.\n", path);
+        LOG_DEBUG("Texture %s created.", path);
 
         {
             this->textureHandle = t;
@@ -56,13 +87,25 @@ public:
         }
     }
 
+    Texture(SDL_Texture* texture, int width, int height, const char name[]) {
+        LOG_DEBUG("Texture %s created.", name);
+
+        {
+            this->textureHandle = texture;
+            this->sourcePath = copyStr(name);
+            this->sizeWidth = width;
+            this->sizeHeight = height;
+        }
+    }
+
     ~Texture() {
         if (this->textureHandle != NULL) {
             auto path = "<no_path>";
             if(this->sourcePath != NULL) { path = this->sourcePath; }
-            printf("Texture %s deleted.\n", path);
+            LOG_DEBUG("Texture %s deleted.", path);
             SDL_DestroyTexture(this->textureHandle);
         }
+        free((void*) this->sourcePath);
 
         {
             this->textureHandle = NULL;
@@ -86,6 +129,18 @@ public:
         other.sizeHeight = 0;
     };
 
+    Texture& operator=(Texture&& other) {
+        if (this != &other) {
+            this->~Texture();
+            new (this) Texture(std::move(other));
+        }
+        return *this;
+    }
+
+    bool isLoaded() {
+        return this->textureHandle != NULL;
+    }
+
     SDL_Texture* sldHandle() {
         return this->textureHandle;
     }
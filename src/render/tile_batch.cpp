@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <SDL2/SDL.h>
+#include "texture.cpp"
+
+// Плиток в одной пачке; при переполнении пачка отправляется раньше
+#define TILE_BATCH_MAX 8192
+
+// =============
+// TileBatch: все плитки кадра (всех досок) одной текстурой за один вызов SDL_RenderGeometry.
+// Цвет плитки - цвет вершин, поэтому SDL_SetTextureColorMod на каждую плитку не нужен.
+
+class TileBatch {
+private:
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices; // одинаковы для любого кадра, заполняются один раз
+    std::vector<SDL_Rect> frames;
+    int tilesCount;
+
+public:
+    TileBatch(): tilesCount(0) {
+        this->vertices.resize(TILE_BATCH_MAX * 4);
+        this->indices.resize(TILE_BATCH_MAX * 6);
+        for (int i = 0; i < TILE_BATCH_MAX; i++) {
+            int v = i * 4;
+            int* quad = &this->indices[i * 6];
+            quad[0] = v + 0; quad[1] = v + 1; quad[2] = v + 2;
+            quad[3] = v + 2; quad[4] = v + 1; quad[5] = v + 3;
+        }
+        this->frames.reserve(TILE_BATCH_MAX);
+    }
+
+    TileBatch(const TileBatch&) = delete;
+    TileBatch(TileBatch&&) = default;
+
+    void addTile(SDL_Renderer* renderer, Texture& texture, SDL_Rect rect, SDL_Color color) {
+        if (this->tilesCount == TILE_BATCH_MAX) {
+            this->flushTiles(renderer, texture);
+        }
+
+        float x1 = (float) rect.x;
+        float y1 = (float) rect.y;
+        float x2 = (float) (rect.x + rect.w);
+        float y2 = (float) (rect.y + rect.h);
+        SDL_Vertex* quad = &this->vertices[this->tilesCount * 4];
+        quad[0] = SDL_Vertex { SDL_FPoint { x1, y1 }, color, SDL_FPoint { 0.0f, 0.0f } };
+        quad[1] = SDL_Vertex { SDL_FPoint { x2, y1 }, color, SDL_FPoint { 1.0f, 0.0f } };
+        quad[2] = SDL_Vertex { SDL_FPoint { x1, y2 }, color, SDL_FPoint { 0.0f, 1.0f } };
+        quad[3] = SDL_Vertex { SDL_FPoint { x2, y2 }, color, SDL_FPoint { 1.0f, 1.0f } };
+        this->tilesCount += 1;
+    }
+
+    // Рамка рисуется снаружи прямоугольника, как раньше линиями
+    void addFrame(int x, int y, int w, int h) {
+        if (this->frames.size() == this->frames.capacity()) { return; }
+        this->frames.push_back(SDL_Rect { x - 1, y - 1, w + 2, h + 2 });
+    }
+
+    void flushTiles(SDL_Renderer* renderer, Texture& texture) {
+        if (this->tilesCount == 0) { return; }
+        SDL_CHECK(SDL_RenderGeometry(
+                renderer, texture.sldHandle(),
+                this->vertices.data(), this->tilesCount * 4,
+                this->indices.data(), this->tilesCount * 6
+        ));
+        this->tilesCount = 0;
+    }
+
+    void flush(SDL_Renderer* renderer, Texture& texture, SDL_Color frameColor) {
+        this->flushTiles(renderer, texture);
+
+        if (!this->frames.empty()) {
+            SDL_SetRenderDrawColor(renderer, frameColor.r, frameColor.g, frameColor.b, frameColor.a);
+            SDL_CHECK(SDL_RenderDrawRects(renderer, this->frames.data(), (int) this->frames.size()));
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+            this->frames.clear();
+        }
+    }
+};
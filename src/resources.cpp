@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <thread>
+#include <SDL2/SDL.h>
+#include "render/texture.cpp"
+#include "assets/asset_archive.cpp"
+#include "concurrent/worker_pool.cpp"
+#include "config.cpp"
+
+#define ASSET_SLOTS_MAX 16
+#define ASSET_LOADER_THREADS_MAX 4
+#define LOOSE_PIXEL_FORMAT SDL_PIXELFORMAT_ARGB8888
+
+// ==============
+// Resources
+
+class Resources {
+public:
+    Texture texBlock;
+
+    Texture menuNewGame;
+    Texture menuExit;
+
+    Texture scoreText;
+    Texture digits;
+    Texture gameOver;
+
+    Resources() = default;
+    Resources(const Resources&) = delete;
+    Resources(Resources&&) = default;
+    ~Resources() = default;
+
+    bool menuLoaded() {
+        return this->menuNewGame.isLoaded() && this->menuExit.isLoaded();
+    }
+};
+
+void destroyResources(SDL_Renderer* renderer, Resources* res) {
+
+}
+
+// Архив ассетов, встроенный при сборке (см. cmake/embed_file.cmake)
+extern const unsigned char EMBEDDED_ASSETS[];
+extern const size_t EMBEDDED_ASSETS_SIZE;
+
+// Встроенный архив по умолчанию, файлы с диска - только если заданы явно.
+// nullptr - грузить отдельные BMP из config.assetsDir.
+std::unique_ptr<AssetArchive> openAssetArchive(const GameConfig& config) {
+    if (config.assetsDir != NULL) {
+        LOG_INFO("Loading loose textures from %s", config.assetsDir);
+        return nullptr;
+    }
+    if (config.assetsPak != NULL) {
+        return std::make_unique<AssetArchive>(config.assetsPak);
+    }
+    return std::make_unique<AssetArchive>(EMBEDDED_ASSETS, EMBEDDED_ASSETS_SIZE);
+}
+
+// ==============
+// AssetLoader: чтение и декодирование в пуле потоков, загрузка в GPU - только в потоке рендера
+
+enum AssetSlotState { assetQueued = 0, assetDecoded = 1, assetUploaded = 2, assetFailed = 3 };
+
+class AssetSlot {
+public:
+    const char* name;
+    Texture Resources::* target;
+    std::atomic<int> state;
+    SDL_Surface* surface; // готовые к загрузке пиксели, формат совпадает с текстурой
+    bool blend;
+
+    AssetSlot(): name(NULL), target(NULL), state(AssetSlotState::assetQueued), surface(NULL), blend(false) {}
+};
+
+class AssetLoader {
+private:
+    std::unique_ptr<AssetArchive> archive;
+    std::string looseDir;
+    AssetSlot slots[ASSET_SLOTS_MAX];
+    int slotsCount;
+    int finishedCount;
+    WorkerPool pool; // объявлен последним: потоки останавливаются раньше, чем закрывается архив
+
+    void decode(AssetSlot* slot) {
+        if (this->archive) {
+            auto entry = this->archive->find(slot->name);
+            if (entry == NULL) {
+                LOG_ERROR("Asset %s not found in archive", slot->name);
+                slot->state = AssetSlotState::assetFailed;
+                return;
+            }
+            // Чтение с диска происходит здесь, а не при загрузке в GPU
+            this->archive->prefetch(*entry);
+            slot->surface = SDL_CreateRGBSurfaceWithFormatFrom(
+                    (void*) this->archive->pixels(*entry),
+                    (int) entry->width, (int) entry->height, 32, (int) entry->pitch, entry->pixelFormat
+            );
+            slot->blend = (entry->flags & ASSET_FLAG_BLEND) != 0;
+        } else {
+            auto path = this->looseDir + "/" + slot->name;
+            auto loaded = SDL_LoadBMP(path.c_str());
+            if (loaded == NULL) {
+                LOG_ERROR("Unable load textureHandle: %s! SDL Error: %s", path.c_str(), SDL_GetError());
+                slot->state = AssetSlotState::assetFailed;
+                return;
+            }
+            slot->blend = loaded->format->Amask != 0;
+            slot->surface = SDL_ConvertSurfaceFormat(loaded, LOOSE_PIXEL_FORMAT, 0);
+            SDL_FreeSurface(loaded);
+        }
+
+        if (slot->surface == NULL) {
+            LOG_ERROR("Unable decode textureHandle: %s! SDL Error: %s", slot->name, SDL_GetError());
+            slot->state = AssetSlotState::assetFailed;
+            return;
+        }
+        slot->state.store(AssetSlotState::assetDecoded, std::memory_order_release);
+    }
+
+public:
+    AssetLoader(const GameConfig& config):
+            archive(openAssetArchive(config)),
+            looseDir(config.assetsDir != NULL ? config.assetsDir : ""),
+            slotsCount(0),
+            finishedCount(0),
+            pool((int) std::clamp(std::thread::hardware_concurrency(), 1u, (unsigned) ASSET_LOADER_THREADS_MAX)) {}
+
+    AssetLoader(const AssetLoader&) = delete;
+
+    // Задачи выполняются в порядке запроса: сначала то, что нужно для первого кадра
+    void request(const char* name, Texture Resources::* target) {
+        if (this->slotsCount >= ASSET_SLOTS_MAX) {
+            LOG_ERROR("Too many assets requested");
+            throw std::runtime_error("Asset slots overflow");
+        }
+        AssetSlot* slot = &this->slots[this->slotsCount];
+        slot->name = name;
+        slot->target = target;
+        this->slotsCount += 1;
+
+        this->pool.submit([this, slot]() { this->decode(slot); });
+    }
+
+    // [render thread] Загружает в GPU все декодированные текстуры.
+    // Возвращает true, если что-то загрузилось.
+    bool pump(SDL_Renderer* renderer, Resources* resources) {
+        bool uploadedAny = false;
+        for (int i = 0; i < this->slotsCount; i++) {
+            AssetSlot* slot = &this->slots[i];
+            int state = slot->state.load(std::memory_order_acquire);
+
+            if (state == AssetSlotState::assetFailed) {
+                throw std::runtime_error("Error on load textureHandle");
+            }
+            if (state != AssetSlotState::assetDecoded) { continue; }
+
+            auto surface = slot->surface;
+            auto texture = loadTextureFromPixels(
+                    renderer, slot->name, surface->format->format,
+                    surface->w, surface->h, surface->pixels, surface->pitch, slot->blend
+            );
+            resources->*(slot->target) = Texture(texture, surface->w, surface->h, slot->name);
+
+            SDL_FreeSurface(surface);
+            slot->surface = NULL;
+            slot->state = AssetSlotState::assetUploaded;
+            this->finishedCount += 1;
+            uploadedAny = true;
+        }
+        return uploadedAny;
+    }
+
+    bool isFinished() {
+        return this->finishedCount == this->slotsCount;
+    }
+};
+
+std::unique_ptr<AssetLoader> startLoadResources(const GameConfig& config) {
+    auto loader = std::make_unique<AssetLoader>(config);
+
+    // Меню - первым, чтобы показать его, пока грузится остальное
+    loader->request("textures/menu/new-game.bmp", &Resources::menuNewGame);
+    loader->request("textures/menu/exit.bmp", &Resources::menuExit);
+
+    loader->request("textures/t-block-s.bmp", &Resources::texBlock);
+
+    loader->request("textures/common_ui/score-l.bmp", &Resources::scoreText);
+    loader->request("textures/common_ui/digits.bmp", &Resources::digits);
+    loader->request("textures/common_ui/game-over.bmp", &Resources::gameOver);
+
+    return loader;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdexcept>
+
+// Очередь фиксированной емкости без выделений памяти
+template<typename T, int CAPACITY>
+class RingBuffer {
+private:
+    T items[CAPACITY];
+    int head;
+    int count;
+
+public:
+    RingBuffer(): items(), head(0), count(0) {}
+
+    int size() const {
+        return this->count;
+    }
+
+    bool empty() const {
+        return this->count == 0;
+    }
+
+    bool full() const {
+        return this->count == CAPACITY;
+    }
+
+    static constexpr int capacity() {
+        return CAPACITY;
+    }
+
+    void clear() {
+        this->head = 0;
+        this->count = 0;
+    }
+
+    void pushBack(const T& item) {
+        if (this->full()) {
+            throw std::overflow_error("Ring buffer overflow");
+        }
+        this->items[(this->head + this->count) % CAPACITY] = item;
+        this->count += 1;
+    }
+
+    T popFront() {
+        if (this->empty()) {
+            throw std::out_of_range("Ring buffer is empty");
+        }
+        T item = this->items[this->head];
+        this->head = (this->head + 1) % CAPACITY;
+        this->count -= 1;
+        return item;
+    }
+
+    // i-й элемент от начала очереди
+    T& at(int i) {
+        if (i < 0 || i >= this->count) {
+            throw std::out_of_range("Out of ring buffer range");
+        }
+        return this->items[(this->head + i) % CAPACITY];
+    }
+
+    const T& at(int i) const {
+        if (i < 0 || i >= this->count) {
+            throw std::out_of_range("Out of ring buffer range");
+        }
+        return this->items[(this->head + i) % CAPACITY];
+    }
+};
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "game.cpp"
+#include "log.cpp"
+#include "utils.cpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// =================================================
+// Формат сохранения незаконченной партии (порядок байт - родной для машины):
+//   SaveHeader
+//   для каждой доски: SaveBoardHeader, затем поле TetroField::serialize
+// Поле пишется строками целиком, поэтому загрузка - одно чтение файла и memcpy по строкам.
+
+#define SAVE_MAGIC 0x56415354 // "TSAV"
+#define SAVE_VERSION 3
+#define SAVE_BAG_MAX 32
+#define SAVE_NEXT_MAX 16
+#define SAVE_FIELD_MAX (FIELD_H * (BIT_ROW_BITS / 8 + FIELD_W_MAX))
+#define SAVE_BLOB_MAX (sizeof(SaveHeader) + BOARDS_MAX * (sizeof(SaveBoardHeader) + SAVE_FIELD_MAX))
+
+struct SaveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size; // весь блоб вместе с заголовком
+    uint32_t checksum; // FNV-1a всего, что после заголовка
+    uint32_t boardsCount;
+    uint32_t pieceSet; // PieceSet::fingerprint: классы фигур в сохранении - индексы этого набора
+};
+
+struct SaveBoardHeader {
+    // Правила, с которыми шла партия
+    int32_t fieldWidth;
+    int32_t previewCount;
+    int32_t cleaningMode;
+    int32_t colorGroupSize;
+    int32_t extraTilesMode;
+    int32_t garbageIntervalMs;
+    int32_t startLevel;
+
+    int32_t score;
+    int32_t outgoingGarbage;
+    float tickAccDown;
+    float tickAccLock;
+    float tickAccGarbage;
+    int32_t level;
+    int32_t clearedTiles;
+    uint32_t randomState;
+    uint32_t shiftRepeatTime;
+    int32_t activeX;
+    int32_t activeY;
+
+    int8_t shiftDirection;
+    uint8_t shiftLeftDown;
+    uint8_t shiftRightDown;
+    uint8_t isLose;
+    uint8_t hasActive;
+    uint8_t activeClass;
+    uint8_t activeVariant;
+    uint8_t activeColor;
+    uint8_t shapeBagCount;
+    uint8_t colorBagCount;
+    uint8_t nextCount;
+    uint8_t reserved;
+
+    uint8_t shapeBag[SAVE_BAG_MAX];
+    uint8_t colorBag[SAVE_BAG_MAX];
+    uint8_t nextClass[SAVE_NEXT_MAX];
+    uint8_t nextVariant[SAVE_NEXT_MAX];
+    uint8_t nextColor[SAVE_NEXT_MAX];
+};
+
+static_assert(sizeof(SaveHeader) == 24, "SaveHeader layout");
+static_assert(sizeof(SaveBoardHeader) == 84 + 2 * SAVE_BAG_MAX + 3 * SAVE_NEXT_MAX, "SaveBoardHeader layout");
+static_assert(SHAPE_BAG_CAPACITY <= SAVE_BAG_MAX && COLOR_BAG_CAPACITY <= SAVE_BAG_MAX, "Bags must fit into save");
+static_assert(PREVIEW_MAX <= SAVE_NEXT_MAX, "Next queue must fit into save");
+
+uint32_t saveChecksum(const uint8_t* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// =============
+// SaveBlob: сохранение фиксированной емкости, без выделений памяти в игровом цикле.
+// size = 0 - сохранения нет (партия закончена, файл надо удалить).
+
+class SaveBlob {
+public:
+    uint32_t size;
+    uint8_t data[SAVE_BLOB_MAX];
+
+    SaveBlob(): size(0) {}
+};
+
+void saveGames(const TetroGame* games, int count, SaveBlob* blob) {
+    uint8_t* out = blob->data + sizeof(SaveHeader);
+
+    for (int i = 0; i < count; i++) {
+        const TetroGame& game = games[i];
+        SaveBoardHeader board;
+        memset(&board, 0, sizeof(board));
+
+        board.fieldWidth = game.field.getWidth();
+        board.previewCount = game.config.previewCount;
+        board.cleaningMode = game.config.cleaningMode;
+        board.colorGroupSize = game.config.colorGroupSize;
+        board.extraTilesMode = game.config.extraTilesMode;
+        board.garbageIntervalMs = game.config.garbageIntervalMs;
+        board.startLevel = game.config.startLevel;
+
+        board.score = game.score;
+        board.outgoingGarbage = game.outgoingGarbage;
+        board.tickAccDown = game.tickAccDown;
+        board.tickAccGarbage = game.tickAccGarbage;
+        board.tickAccLock = game.tickAccLock;
+        board.level = game.level;
+        board.clearedTiles = game.clearedTiles;
+        board.randomState = game.random.state;
+        board.shiftRepeatTime = game.shift.repeatTime;
+        board.shiftDirection = (int8_t) game.shift.direction;
+        board.shiftLeftDown = game.shift.leftDown;
+        board.shiftRightDown = game.shift.rightDown;
+        board.isLose = game.isLose;
+
+        if (game.activeShape.has_value()) {
+            const TetroActiveShape& shape = game.activeShape.value();
+            board.hasActive = 1;
+            board.activeX = shape.x;
+            board.activeY = shape.y;
+            board.activeClass = shape.prototype.clazz;
+            board.activeVariant = (uint8_t) shape.prototype.variant;
+            board.activeColor = shape.prototype.color;
+        }
+
+        board.shapeBagCount = (uint8_t) game.shapeBag.size();
+        for (int j = 0; j < game.shapeBag.size(); j++) { board.shapeBag[j] = game.shapeBag.at(j); }
+        board.colorBagCount = (uint8_t) game.colorBag.size();
+        for (int j = 0; j < game.colorBag.size(); j++) { board.colorBag[j] = game.colorBag.at(j); }
+        board.nextCount = (uint8_t) game.nextQueue.size();
+        for (int j = 0; j < game.nextQueue.size(); j++) {
+            const TetroShapePrototype& next = game.nextQueue.at(j);
+            board.nextClass[j] = next.clazz;
+            board.nextVariant[j] = (uint8_t) next.variant;
+            board.nextColor[j] = next.color;
+        }
+
+        memcpy(out, &board, sizeof(board));
+        out += sizeof(board);
+        game.field.serialize(out);
+        out += game.field.serializedSize();
+    }
+
+    SaveHeader header;
+    header.magic = SAVE_MAGIC;
+    header.version = SAVE_VERSION;
+    header.size = (uint32_t) (out - blob->data);
+    header.checksum = saveChecksum(blob->data + sizeof(SaveHeader), header.size - sizeof(SaveHeader));
+    header.boardsCount = (uint32_t) count;
+    header.pieceSet = PieceSet::active().fingerprint;
+    memcpy(blob->data, &header, sizeof(header));
+    blob->size = header.size;
+}
+
+bool validShapeClass(uint8_t clazz, uint8_t color) {
+    return clazz < PieceSet::active().count && color <= TetroColor::black;
+}
+
+// Восстанавливает партии из блоба; правила каждой доски берутся из сохранения,
+// остальные настройки (DAS, ARR) - из config. Возвращает число досок или -1, если блоб испорчен.
+int loadGames(const SaveBlob& blob, TetroGame* games, int maxCount, const GameConfig& config) {
+    SaveHeader header;
+    if (blob.size < sizeof(header)) { return -1; }
+    memcpy(&header, blob.data, sizeof(header));
+    if (header.magic != SAVE_MAGIC || header.version != SAVE_VERSION) {
+        LOG_WARN("Save has unknown format (magic %08x, version %u)", header.magic, header.version);
+        return -1;
+    }
+    if (header.size != blob.size || header.boardsCount > (uint32_t) maxCount) { return -1; }
+    if (header.checksum != saveChecksum(blob.data + sizeof(header), blob.size - sizeof(header))) {
+        LOG_WARN("Save checksum mismatch");
+        return -1;
+    }
+    if (header.pieceSet != PieceSet::active().fingerprint) {
+        LOG_WARN("Save was made with another piece set (%08x, current %08x)", header.pieceSet, PieceSet::active().fingerprint);
+        return -1;
+    }
+
+    const uint8_t* in = blob.data + sizeof(header);
+    const uint8_t* end = blob.data + blob.size;
+    for (uint32_t i = 0; i < header.boardsCount; i++) {
+        SaveBoardHeader board;
+        if ((size_t) (end - in) < sizeof(board)) { return -1; }
+        memcpy(&board, in, sizeof(board));
+        in += sizeof(board);
+
+        bool isValid = board.fieldWidth >= FIELD_W_MIN && board.fieldWidth <= FIELD_W_MAX
+                && board.previewCount >= 1 && board.previewCount <= PREVIEW_MAX
+                && board.shapeBagCount <= SHAPE_BAG_CAPACITY && board.colorBagCount <= COLOR_BAG_CAPACITY
+                && board.nextCount <= PREVIEW_MAX
+                && board.colorGroupSize >= 2
+                && board.garbageIntervalMs > 0
+                && board.startLevel >= 1 && board.startLevel <= LEVEL_MAX
+                && board.level >= 1 && board.level <= LEVEL_MAX
+                && (!board.hasActive || validShapeClass(board.activeClass, board.activeColor));
+        for (int j = 0; isValid && j < board.shapeBagCount; j++) { isValid = validShapeClass(board.shapeBag[j], 0); }
+        for (int j = 0; isValid && j < board.colorBagCount; j++) { isValid = validShapeClass(0, board.colorBag[j]); }
+        for (int j = 0; isValid && j < board.nextCount; j++) { isValid = validShapeClass(board.nextClass[j], board.nextColor[j]); }
+        if (!isValid) { return -1; }
+
+        GameConfig gameConfig = config;
+        gameConfig.fieldWidth = board.fieldWidth;
+        gameConfig.previewCount = board.previewCount;
+        gameConfig.cleaningMode = board.cleaningMode == CleaningMode::color ? CleaningMode::color : CleaningMode::line;
+        gameConfig.colorGroupSize = board.colorGroupSize;
+        gameConfig.extraTilesMode = board.extraTilesMode == ExtraTilesMode::on ? ExtraTilesMode::on : ExtraTilesMode::off;
+        gameConfig.garbageIntervalMs = board.garbageIntervalMs;
+        gameConfig.startLevel = board.startLevel;
+
+        TetroGame& game = games[i];
+        game = TetroGame(gameConfig);
+        if ((size_t) (end - in) < game.field.serializedSize()) { return -1; }
+        if (!game.field.deserialize(in)) { return -1; }
+        in += game.field.serializedSize();
+
+        game.score = board.score;
+        game.outgoingGarbage = board.outgoingGarbage;
+        game.tickAccDown = board.tickAccDown;
+        game.tickAccGarbage = board.tickAccGarbage;
+        game.tickAccLock = board.tickAccLock;
+        game.level = board.level;
+        game.clearedTiles = board.clearedTiles;
+        game.random.state = board.randomState;
+        game.shift.repeatTime = board.shiftRepeatTime;
+        game.shift.direction = board.shiftDirection;
+        game.shift.leftDown = board.shiftLeftDown != 0;
+        game.shift.rightDown = board.shiftRightDown != 0;
+        game.isLose = board.isLose != 0;
+
+        if (board.hasActive) {
+            TetroShapePrototype prototype((TetroShapeClass) board.activeClass, board.activeVariant, (TetroColor) board.activeColor);
+            game.activeShape = TetroActiveShape(board.activeX, board.activeY, prototype);
+            // Контрольная сумма не защищает от правки файла: фигура вне поля упала бы при фиксации.
+            // У проигранной доски фигура может лежать поверх плиток, но не за краем поля.
+            TetroActiveShape& shape = game.activeShape.value();
+            if (game.isLose ? !game.shapeInField(shape) : !game.shapeCanPlaced(shape)) { return -1; }
+        }
+        for (int j = 0; j < board.shapeBagCount; j++) { game.shapeBag.pushBack((TetroShapeClass) board.shapeBag[j]); }
+        for (int j = 0; j < board.colorBagCount; j++) { game.colorBag.pushBack((TetroColor) board.colorBag[j]); }
+        for (int j = 0; j < board.nextCount; j++) {
+            game.nextQueue.pushBack(TetroShapePrototype(
+                    (TetroShapeClass) board.nextClass[j], board.nextVariant[j], (TetroColor) board.nextColor[j]
+            ));
+        }
+    }
+    if (in != end) { return -1; }
+    return (int) header.boardsCount;
+}
+
+// =============
+// Файл сохранения. Чтение - одним вызовом, запись - во временный файл с переименованием,
+// чтобы выключение питания посреди записи не испортило прошлое сохранение.
+// Без stdio: запись идет из цикла рендера, где выделять память нельзя.
+
+bool readSaveFile(const char* path, SaveBlob* blob) {
+    blob->size = 0;
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { return false; }
+    ssize_t size = read(fd, blob->data, sizeof(blob->data));
+    close(fd);
+#else
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) { return false; }
+    long size = (long) fread(blob->data, 1, sizeof(blob->data), file);
+    fclose(file);
+#endif
+    if (size <= 0) { return false; }
+    blob->size = (uint32_t) size;
+    return true;
+}
+
+bool writeSaveFile(const char* path, const SaveBlob& blob) {
+    if (blob.size == 0) {
+        // Партия закончена - продолжать нечего
+        std::remove(path);
+        return true;
+    }
+
+    char tempPath[1024];
+    if (!tempFilePath(path, tempPath, sizeof(tempPath))) { return false; }
+#ifndef _WIN32
+    int fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { return false; }
+    bool isWritten = write(fd, blob.data, blob.size) == (ssize_t) blob.size;
+    close(fd);
+#else
+    FILE* file = fopen(tempPath, "wb");
+    if (file == NULL) { return false; }
+    bool isWritten = fwrite(blob.data, 1, blob.size, file) == blob.size;
+    fclose(file);
+#endif
+    if (!replaceWithTempFile(tempPath, path, isWritten)) {
+        LOG_WARN("Unable write save: %s", path);
+        return false;
+    }
+    return true;
+}
@@ -1,125 +1,57 @@
-
-// =========================
-// Shape O
-const char SHAPE_O[17] =
-        "...."
-        "...."
-        ".##."
-        ".##.";
-
-// =========================
-// Shape I
-const char SHAPE_I_0[17] =
-        ".#.."
-        ".#.."
-        ".#.."
-        ".#..";
-const char SHAPE_I_1[17] =
-        "...."
-        "...."
-        "####"
-        "....";
-
-// =========================
-// Shape L
-const char SHAPE_L_0[17] =
-        "...."
-        ".#.."
-        ".#.."
-        ".##.";
-const char SHAPE_L_1[17] =
-        "...."
-        "...."
-        "###."
-        "#...";
-const char SHAPE_L_2[17] =
-        "...."
-        "##.."
-        ".#.."
-        ".#..";
-const char SHAPE_L_3[17] =
-        "...."
-        "..#."
-        "###."
-        "....";
-
-// =========================
-// Shape J
-const char SHAPE_J_0[17] =
-        "...."
-        ".#.."
-        ".#.."
-        "##..";
-const char SHAPE_J_1[17] =
-        "...."
-        "#..."
-        "###."
-        "....";
-const char SHAPE_J_2[17] =
-        "...."
-        ".##."
-        ".#.."
-        ".#..";
-const char SHAPE_J_3[17] =
-        "...."
-        "...."
-        "###."
-        "..#.";
-
-// =========================
-// Shape T
-const char SHAPE_T_0[17] =
-        "...."
-        "...."
-        "###."
-        ".#..";
-const char SHAPE_T_1[17] =
-        "...."
-        ".#.."
-        "##.."
-        ".#..";
-const char SHAPE_T_2[17] =
-        "...."
-        ".#.."
-        "###."
-        "....";
-const char SHAPE_T_3[17] =
-        "...."
-        ".#.."
-        ".##."
-        ".#..";
-
-
-// =========================
-// Shape Z
-const char SHAPE_Z_0[17] =
-        "...."
-        "...."
-        "##.."
-        ".##.";
-const char SHAPE_Z_1[17] =
-        "...."
-        ".#.."
-        "##.."
-        "#...";
-
-// =========================
-// Shape S
-const char SHAPE_S_0[17] =
-        "...."
-        "...."
-        ".##."
-        "##..";
-const char SHAPE_S_1[17] =
-        "...."
-        "#..."
-        "##.."
-        ".#..";
-
-// =========================
-// Shape Dot
-const char SHAPE_DOT[17] =
-        "...."
-        "...."
-        "...."
-        ".#..";
+#pragma once
+
+// =========================
+// Стандартный набор фигур в формате файла наборов (--pieces=FILE, см. piece_set.cpp).
+// Порядок фигур - значения TetroShapeClass, порядок мешка - как был в коде.
+
+const char STANDARD_PIECE_SET[] = R"(
+piece I
+.#..  ....
+.#..  ....
+.#..  ####
+.#..  ....
+
+piece L
+....  ....  ....  ....
+.#..  ....  ##..  ..#.
+.#..  ###.  .#..  ###.
+.##.  #...  .#..  ....
+
+piece J
+....  ....  ....  ....
+.#..  #...  .##.  ....
+.#..  ###.  .#..  ###.
+##..  ....  .#..  ..#.
+
+piece T
+....  ....  ....  ....
+....  .#..  .#..  .#..
+###.  ##..  ###.  .##.
+.#..  .#..  ....  .#..
+
+piece S
+....  ....
+....  #...
+.##.  ##..
+##..  .#..
+
+piece Z
+....  ....
+....  .#..
+##..  ##..
+.##.  #...
+
+piece O
+....
+....
+.##.
+.##.
+
+piece Dot letter=. extra
+....
+....
+....
+.#..
+
+bag L J I T O Z S
+)";
@@ -0,0 +1,505 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <optional>
+#include <SDL2/SDL.h>
+#include "log.cpp"
+#include "game.cpp"
+#include "save_game.cpp"
+#include "telemetry.cpp"
+#include "audio/mixer.cpp"
+#include "solver/pc_hint.cpp"
+#include "concurrent/spsc_queue.cpp"
+#include "concurrent/triple_buffer.cpp"
+#include "debug/alloc_counter.cpp"
+#include "net/rollback_session.cpp"
+
+#define SIMULATION_DT 0.02
+#define INPUT_QUEUE_SIZE 256
+// После скольких тиков цикл не должен выделять память (проверка в сборке с TETRIS_COUNT_ALLOCATIONS)
+#define ALLOCATION_WARMUP_TICKS 50
+// Как часто незаконченная партия отдается на запись (--save)
+#define SAVE_INTERVAL_TICKS 50
+
+enum AppState { menu = 0, game = 1 };
+
+enum MenuElement { newGame = 0, quit = 1 };
+
+// Состояние одной доски в снимке
+class BoardSnapshot {
+public:
+    TetroField field;
+    std::optional<TetroActiveShape> activeShape;
+    std::optional<TetroActiveShape> hintShape; // куда поставить активную фигуру для perfect clear
+    NextQueue nextShapes;
+    int score;
+    bool isLose;
+
+    BoardSnapshot():
+            field(TetroField()),
+            activeShape(std::nullopt),
+            hintShape(std::nullopt),
+            nextShapes(NextQueue()),
+            score(0),
+            isLose(false) {}
+};
+
+// Неизменяемый снимок состояния, достаточный для отрисовки кадра.
+// Пишется потоком симуляции, читается потоком рендера.
+class GameSnapshot {
+public:
+    AppState state;
+    MenuElement menuElement;
+
+    int boardsCount;
+    BoardSnapshot boards[BOARDS_MAX];
+
+    InputStamps inputStamps;
+
+    // Отпечаток всего, что видно на экране: одинаковый - кадр перерисовывать незачем
+    uint64_t visibleDigest() const {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](uint64_t value) { hash = (hash ^ value) * 1099511628211ull; };
+        mix(this->state);
+        mix(this->menuElement);
+        mix(this->inputStamps.count);
+        if (this->state != AppState::game) { return hash; }
+
+        mix(this->boardsCount);
+        for (int i = 0; i < this->boardsCount; i++) {
+            const BoardSnapshot& board = this->boards[i];
+            // Цвета плиток меняются только вместе с занятостью клеток или счетом
+            int words = (board.field.getWidth() + 63) / 64;
+            for (int y = 0; y < FIELD_H; y++) {
+                const uint64_t* row = board.field.rowBits(y);
+                for (int w = 0; w < words; w++) { mix(row[w]); }
+            }
+            mix((uint64_t) board.score);
+            mix(board.isLose ? 1 : 0);
+            if (board.activeShape.has_value()) {
+                const TetroActiveShape& shape = board.activeShape.value();
+                mix(((uint64_t) (uint32_t) shape.x << 32) | (uint32_t) shape.y);
+                mix(((uint64_t) shape.prototype.clazz << 32) | (uint32_t) shape.prototype.variant);
+            }
+            if (board.hintShape.has_value()) {
+                const TetroActiveShape& hint = board.hintShape.value();
+                mix(((uint64_t) (uint32_t) hint.x << 32) | (uint32_t) hint.y);
+                mix((uint64_t) hint.prototype.variant);
+            }
+            for (int n = 0; n < board.nextShapes.size(); n++) {
+                mix(((uint64_t) board.nextShapes.at(n).clazz << 32) | board.nextShapes.at(n).color);
+            }
+        }
+        return hash;
+    }
+
+    GameSnapshot():
+            state(AppState::menu),
+            menuElement(MenuElement::newGame),
+            boardsCount(0),
+            boards(),
+            inputStamps(InputStamps()) {}
+};
+
+// =============
+// Simulation: игровая логика в отдельном потоке с фиксированным шагом
+
+class Simulation {
+public:
+    // [shared between threads]
+    SpscQueue<InputEvent, INPUT_QUEUE_SIZE> inputQueue; // window thread -> simulation
+    TripleBuffer<GameSnapshot> snapshots; // simulation -> render thread
+    TripleBuffer<SaveBlob> saves; // simulation -> main thread, который пишет их в файл
+    std::atomic<bool> exitRequired;
+    std::atomic<bool> gameAssetsReady; // пока false, новую игру начать нельзя
+    AudioMixer* audio; // NULL - без звука; задается до start()
+    uint32_t wakeEventType; // событие SDL, которым будится поток окна; 0 - не будить. Задается до start()
+    std::atomic<bool> wakePending; // событие отправлено, поток окна еще не забрал снимок
+
+private:
+    std::atomic<bool> running;
+    std::thread thread;
+
+    // [simulation thread only]
+    AppState __state;
+    InputState input; // все доски вместе - для меню и выхода
+    InputState boardInputs[BOARDS_MAX];
+    InputEvent tickEvents[INPUT_QUEUE_SIZE];
+    int tickEventsCount;
+    uint32_t lastTickTime;
+    uint64_t lastPressStamp; // штамп последнего нажатия за тик, для меню
+    InputStamps inputStamps;
+    AllocationGuard allocationGuard;
+    bool saveEnabled;
+    int ticksSinceSave;
+    bool resumePending; // партия загружена из сохранения, начнется, как только будут готовы ассеты
+    uint64_t publishedDigest; // visibleDigest последнего отданного снимка
+
+    // =================
+    // [menu state part]
+
+    MenuElement menuElement;
+    CleaningMode cleaningMode;
+    ExtraTilesMode extraTilesMode;
+
+    // [menu state part]
+    // =================
+    // [game state part]
+
+    int boardsCount;
+    TetroGame games[BOARDS_MAX];
+    std::unique_ptr<NetVersus> versus; // сетевая партия: доски ведет rollback-сессия, games не используются
+    std::unique_ptr<TelemetryWriter> telemetry; // NULL - выключена
+    std::unique_ptr<PcHintService> pcHint; // NULL - без подсказки; только первая доска
+    int hintPieces; // stats.pieces первой доски на момент последнего запроса подсказки, -1 - не было
+    bool boardLost[BOARDS_MAX]; // чтобы конец партии попал в телеметрию один раз
+
+    // [game state part]
+    // =================
+
+public:
+    Simulation(GameConfig config):
+            exitRequired(false),
+            gameAssetsReady(false),
+            audio(NULL),
+            wakeEventType(0),
+            wakePending(false),
+            running(false),
+            __state(AppState::menu),
+            tickEventsCount(0),
+            lastTickTime(0),
+            lastPressStamp(0),
+            inputStamps(InputStamps()),
+            allocationGuard(AllocationGuard("Simulation tick", ALLOCATION_WARMUP_TICKS)),
+            saveEnabled(config.savePath != NULL && config.versus == NULL),
+            ticksSinceSave(0),
+            resumePending(false),
+            publishedDigest(0),
+            menuElement(MenuElement::newGame),
+            cleaningMode(config.cleaningMode),
+            extraTilesMode(config.extraTilesMode),
+            boardsCount(config.boardsCount),
+            hintPieces(-1),
+            boardLost()
+    {
+        for (int i = 0; i < this->boardsCount; i++) {
+            this->games[i] = TetroGame(config);
+        }
+        if (config.versus != NULL) {
+            this->versus = std::make_unique<NetVersus>(config, (float) SIMULATION_DT);
+        }
+        // В сетевой партии откаты пересчитывают кадры, поэтому статистика по ним не пишется
+        if (config.telemetryPath != NULL && config.versus == NULL) {
+            this->telemetry = TelemetryWriter::open(config.telemetryPath);
+        }
+        if (config.pcHint) {
+            if (config.versus == NULL && config.cleaningMode == CleaningMode::line && config.fieldWidth <= PC_WIDTH_MAX) {
+                this->pcHint = std::make_unique<PcHintService>();
+            } else {
+                LOG_WARN("Perfect clear hint needs a local game in line mode with width up to %d", PC_WIDTH_MAX);
+            }
+        }
+    }
+
+    Simulation(const Simulation&) = delete;
+
+    ~Simulation() {
+        this->stop();
+    }
+
+    // Вызывать до start(). Если сохранение подходит, партия продолжится вместо меню.
+    bool resume(const SaveBlob& blob, const GameConfig& config) {
+        if (!this->saveEnabled) { return false; }
+
+        auto loaded = std::make_unique<TetroGame[]>(BOARDS_MAX);
+        int count = loadGames(blob, loaded.get(), BOARDS_MAX, config);
+        if (count != this->boardsCount) {
+            LOG_WARN("Save ignored: %s", count < 0 ? "corrupted" : "different players count");
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            this->games[i] = loaded[i];
+            // Клавиши, зажатые в момент сохранения, уже отпущены
+            this->games[i].shift.releaseAll();
+        }
+        this->resumePending = true;
+        return true;
+    }
+
+    // Вызывать после stop()
+    void report() {
+        if (this->versus) { this->versus->report(); }
+    }
+
+    void start() {
+        this->publishSnapshot();
+        this->lastTickTime = SDL_GetTicks();
+        this->running = true;
+        this->thread = std::thread([this]() { this->run(); });
+    }
+
+    void stop() {
+        this->running = false;
+        if (this->thread.joinable()) {
+            this->thread.join();
+        }
+        // Поток симуляции остановлен - последнее сохранение отдаем отсюда
+        if (this->__state == AppState::game) { this->publishSave(); }
+    }
+
+private:
+    void run() {
+        auto step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(SIMULATION_DT)
+        );
+        auto nextTick = std::chrono::steady_clock::now();
+
+        while (this->running) {
+            this->tick(SIMULATION_DT);
+
+            nextTick += step;
+            auto now = std::chrono::steady_clock::now();
+            if (nextTick < now - step * 5) {
+                // Сильно отстали (отладчик, сон системы) - не пытаемся догнать пачкой тиков
+                nextTick = now;
+            }
+            std::this_thread::sleep_until(nextTick);
+        }
+    }
+
+    void tick(float dt) {
+        this->allocationGuard.beginTick();
+
+        this->updateInput();
+        this->updateState(dt);
+        this->publishSnapshot();
+        this->updateSave();
+
+        this->allocationGuard.endTick();
+
+        if (this->input.exitRequired && !this->exitRequired) {
+            this->exitRequired = true;
+            this->wakeWindow();
+        }
+    }
+
+    // Поток окна спит в SDL_WaitEventTimeout, пока ему нечего рисовать. Одно событие на
+    // все снимки, пока он его не обработал: очередь событий SDL не растет.
+    void wakeWindow() {
+        if (this->wakeEventType == 0 || this->wakePending.exchange(true)) { return; }
+        SDL_Event event;
+        memset(&event, 0, sizeof(event));
+        event.type = this->wakeEventType;
+        SDL_PushEvent(&event);
+    }
+
+    void updateInput() {
+        this->input.update();
+        for (int i = 0; i < this->boardsCount; i++) {
+            this->boardInputs[i].update();
+        }
+
+        this->tickEventsCount = 0;
+        this->lastPressStamp = 0;
+        InputEvent event;
+        while (this->tickEventsCount < INPUT_QUEUE_SIZE && this->inputQueue.pop(&event)) {
+            this->input.apply(event);
+            if (event.board == BOARD_ALL) {
+                for (int i = 0; i < this->boardsCount; i++) { this->boardInputs[i].apply(event); }
+            } else if (event.board < this->boardsCount) {
+                this->boardInputs[event.board].apply(event);
+            }
+            if (event.type == InputEventType::keyPressed) { this->lastPressStamp = event.pollStamp; }
+            this->tickEvents[this->tickEventsCount] = event;
+            this->tickEventsCount += 1;
+        }
+    }
+
+    void setMainState(AppState state) {
+        if (this->__state == state) {
+            LOG_FATAL("Change app __state to same");
+        }
+        if (this->__state == AppState::menu && state == AppState::game) {
+            this->__state = state;
+            if (this->versus) {
+                this->versus->restart((uint32_t) std::rand());
+            }
+            for (int i = 0; i < this->boardsCount; i++) {
+                this->games[i].reset();
+            }
+            this->hintPieces = -1;
+        }
+        if (this->__state == AppState::game && state == AppState::menu) {
+            this->__state = state;
+            // Из партии вышли сами - продолжать нечего
+            this->publishSave();
+            if (this->telemetry) {
+                for (int i = 0; i < this->boardsCount; i++) {
+                    if (!this->games[i].isLose) { this->telemetry->pushGameEnd(i, this->games[i], TelemetryEvent::telemetryGameQuit); }
+                }
+            }
+        }
+    }
+
+    void updateStateMenu() {
+        if (this->resumePending && this->gameAssetsReady) {
+            this->resumePending = false;
+            this->__state = AppState::game;
+            return;
+        }
+
+        if (this->input.keyBack.isPressed()) {
+            this->input.exitRequired = true;
+        }
+
+        if (this->input.keyAction.isPressed()) {
+            switch (this->menuElement) {
+                case MenuElement::newGame:
+                    if (this->gameAssetsReady) {
+                        this->setMainState(AppState::game);
+                    }
+                    break;
+                case MenuElement::quit:
+                    this->input.exitRequired = true;
+                    break;
+                default:
+                    LOG_FATAL("UNREACHABLE");
+            }
+        }
+
+        if (this->input.keyD.isPressed()) {
+            this->menuElement = static_cast<MenuElement>(this->menuElement < 1 ? this->menuElement + 1 : 1);
+        }
+        if (this->input.keyU.isPressed()) {
+            this->menuElement = static_cast<MenuElement>(this->menuElement > 0 ? this->menuElement - 1 : 0);
+        }
+    }
+
+    void updateStateGame(float dt, const TickInput& tickInput) {
+        // Проверка выхода
+        if (this->input.keyBack.isPressed()) { this->setMainState(AppState::menu); return; }
+
+        if (this->versus) {
+            // Сетевой шаг идет от номера кадра, а не от времени тика - иначе симуляции разойдутся.
+            // Звука здесь нет: при откате события пересчитанных кадров прозвучали бы повторно.
+            this->versus->tick(this->boardInputs);
+            return;
+        }
+
+        for (int i = 0; i < this->boardsCount; i++) {
+            TickInput boardInput = tickInput;
+            boardInput.board = i;
+            this->games[i].update(dt, this->boardInputs[i], boardInput);
+            if (this->telemetry) { this->recordTelemetry(i); }
+            uint32_t events = this->games[i].takeEvents();
+            if (this->audio != NULL) { this->audio->playEvents(events); }
+        }
+        if (this->pcHint) { this->requestHint(); }
+    }
+
+    // Подсказка считается один раз на фигуру, как только она появилась
+    void requestHint() {
+        const TetroGame& game = this->games[0];
+        if (game.isLose || !game.activeShape.has_value() || game.stats.pieces == this->hintPieces) { return; }
+        this->hintPieces = game.stats.pieces;
+        this->pcHint->request(game);
+    }
+
+    void recordTelemetry(int board) {
+        TetroGame& game = this->games[board];
+        PieceStats piece;
+        if (game.takeLockedPiece(&piece)) {
+            this->telemetry->pushPiece(board, game, piece);
+        }
+        if (game.isLose && !this->boardLost[board]) {
+            this->telemetry->pushGameEnd(board, game, TelemetryEvent::telemetryGameOver);
+        }
+        this->boardLost[board] = game.isLose;
+    }
+
+    // Game logic
+    void updateState(float dt) {
+        uint32_t now = SDL_GetTicks();
+        TickInput tickInput = TickInput { this->tickEvents, this->tickEventsCount, this->lastTickTime, now, &this->inputStamps, BOARD_ALL };
+        this->lastTickTime = now;
+
+        AppState stateBefore = this->__state;
+        MenuElement menuElementBefore = this->menuElement;
+
+        switch (this->__state) {
+            case AppState::menu:
+                this->updateStateMenu();
+                break;
+            case AppState::game:
+                this->updateStateGame(dt, tickInput);
+                break;
+            default:
+                LOG_FATAL("UNREACHABLE");
+        }
+
+        // Переходы меню и выход из игры тоже считаются откликом на ввод
+        bool menuChanged = this->__state != stateBefore || this->menuElement != menuElementBefore;
+        if (menuChanged && this->lastPressStamp != 0) {
+            this->inputStamps.push(this->lastPressStamp);
+        }
+    }
+
+    void updateSave() {
+        if (!this->saveEnabled || this->__state != AppState::game) { return; }
+        this->ticksSinceSave += 1;
+        if (this->ticksSinceSave < SAVE_INTERVAL_TICKS) { return; }
+        this->ticksSinceSave = 0;
+        this->publishSave();
+    }
+
+    // Вне партии отдается пустое сохранение - файл удаляется
+    void publishSave() {
+        if (!this->saveEnabled) { return; }
+        SaveBlob& blob = this->saves.writeBuffer();
+        if (this->__state == AppState::game) {
+            saveGames(this->games, this->boardsCount, &blob);
+        } else {
+            blob.size = 0;
+        }
+        this->saves.publish();
+    }
+
+    void publishSnapshot() {
+        GameSnapshot& snapshot = this->snapshots.writeBuffer();
+        snapshot.state = this->__state;
+        snapshot.menuElement = this->menuElement;
+        snapshot.inputStamps = this->inputStamps;
+
+        if (this->__state == AppState::game) {
+            snapshot.boardsCount = this->boardsCount;
+            for (int i = 0; i < this->boardsCount; i++) {
+                BoardSnapshot& board = snapshot.boards[i];
+                const TetroGame& game = this->versus ? this->versus->game(i) : this->games[i];
+                board.field = game.field;
+                board.activeShape = game.activeShape;
+                board.nextShapes = game.nextQueue;
+                board.score = game.score;
+                board.isLose = game.isLose;
+                board.hintShape = std::nullopt;
+            }
+            PcHintResult hint;
+            const TetroGame& first = this->games[0];
+            if (this->pcHint && this->pcHint->fetch(&hint) && first.activeShape.has_value()
+                    && first.activeShape.value().prototype.clazz == hint.clazz) {
+                TetroShapePrototype prototype = TetroShapePrototype(hint.clazz, hint.placement.variant, TetroColor::black);
+                snapshot.boards[0].hintShape = TetroActiveShape(hint.placement.x, hint.placement.y, prototype);
+            }
+        }
+
+        // Ничего видимого не изменилось (меню, конец партии) - снимок не отдается, и кадр не рисуется
+        uint64_t digest = snapshot.visibleDigest();
+        if (digest == this->publishedDigest) { return; }
+        this->publishedDigest = digest;
+
+        this->snapshots.publish();
+        this->wakeWindow();
+    }
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "perfect_clear.cpp"
+#include "../concurrent/triple_buffer.cpp"
+
+// Как часто поток подсказок проверяет, нет ли новой фигуры
+#define PC_HINT_POLL_MS 5
+// Поиск на одну фигуру ограничен: безнадежная позиция не должна задерживать подсказку к следующей
+#define PC_HINT_NODE_LIMIT 300000
+#define PC_HINT_THREADS 2
+
+// Поле и известная очередь (активная фигура и превью) на момент появления фигуры
+class PcHintRequest {
+public:
+    uint32_t id;
+    TetroField field;
+    int queueCount;
+    TetroShapeClass queue[PC_PIECES_MAX];
+
+    PcHintRequest(): id(0), field(TetroField()), queueCount(0), queue() {}
+};
+
+// Куда поставить активную фигуру, чтобы очередь закончилась пустым полем
+class PcHintResult {
+public:
+    uint32_t id; // запрос, к которому относится ответ
+    bool found;
+    TetroShapeClass clazz;
+    Placement placement;
+    int piecesLeft; // фигур в решении, включая эту
+
+    PcHintResult(): id(0), found(false), clazz(TetroShapeClass::O), placement(), piecesLeft(0) {}
+};
+
+// =============
+// PcHintService: подсказка perfect clear в игре. Решатель работает в своем потоке,
+// тик симуляции только копирует запрос и забирает готовый ответ (без ожидания).
+// Пока идет поиск, новые запросы перезаписывают друг друга - считается только последний.
+
+class PcHintService {
+private:
+    TripleBuffer<PcHintRequest> requests; // simulation -> поток подсказок
+    TripleBuffer<PcHintResult> results; // поток подсказок -> simulation
+    std::atomic<bool> running;
+    std::thread thread;
+    PerfectClearSolver solver;
+    uint32_t lastId; // [simulation thread]
+
+    void run() {
+        while (this->running) {
+            if (!this->requests.fetch()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(PC_HINT_POLL_MS));
+                continue;
+            }
+            const PcHintRequest& request = this->requests.readBuffer();
+            PcSolution solution;
+            bool isSolved = this->solver.solve(request.field, request.queue, request.queueCount, PC_HINT_NODE_LIMIT, &solution)
+                    && solution.found;
+
+            PcHintResult& result = this->results.writeBuffer();
+            result.id = request.id;
+            result.found = isSolved;
+            if (isSolved) {
+                result.clazz = solution.pieces[0];
+                result.placement = solution.placements[0];
+                result.piecesLeft = solution.count;
+            }
+            this->results.publish();
+        }
+    }
+
+public:
+    PcHintService(): running(true), solver(PerfectClearSolver(PC_HINT_THREADS)), lastId(0) {
+        this->thread = std::thread([this]() { this->run(); });
+    }
+
+    PcHintService(const PcHintService&) = delete;
+
+    ~PcHintService() {
+        this->running = false;
+        if (this->thread.joinable()) {
+            this->thread.join();
+        }
+    }
+
+    // [simulation thread] Новая фигура: прежняя подсказка больше не действует
+    void request(const TetroGame& game) {
+        PcHintRequest& request = this->requests.writeBuffer();
+        this->lastId += 1;
+        request.id = this->lastId;
+        request.field = game.field;
+        request.queueCount = 0;
+        if (game.activeShape.has_value()) {
+            request.queue[request.queueCount++] = game.activeShape.value().prototype.clazz;
+        }
+        for (int i = 0; i < game.nextQueue.size() && request.queueCount < PC_PIECES_MAX; i++) {
+            request.queue[request.queueCount++] = game.nextQueue.at(i).clazz;
+        }
+        this->requests.publish();
+    }
+
+    // [simulation thread] Ответ на последний запрос, если он уже посчитан и решение есть
+    bool fetch(PcHintResult* out) {
+        this->results.fetch();
+        const PcHintResult& result = this->results.readBuffer();
+        if (result.id != this->lastId || !result.found) { return false; }
+        *out = result;
+        return true;
+    }
+};
@@ -0,0 +1,503 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+#include "../movegen.cpp"
+
+// Доска решателя - один uint64_t: ширина * высота не больше 64
+#define PC_CELLS 64
+#define PC_WIDTH_MAX 16
+#define PC_HEIGHT_MAX 6
+#define PC_PIECES_MAX 16
+// Узлы мельче этой глубины ставятся задачами в очереди потоков, глубже - обход в том же потоке
+#define PC_SPLIT_DEPTH 3
+// Таблица разобранных позиций: 2^N ячеек, при занятой ячейке - пробы по соседним
+#define PC_TABLE_BITS 20
+#define PC_TABLE_PROBES 8
+// Раз во сколько узлов поток добавляет свой счет к общему и сверяется с лимитом
+#define PC_NODES_BATCH 256
+#define PC_DEFAULT_NODE_LIMIT 20000000
+
+// Итог поиска: фигуры очереди по порядку и куда каждую ставить (координаты поля
+// после фиксации предыдущих фигур и очистки строк, как у MoveGen)
+struct PcSolution {
+    bool found;
+    bool aborted; // поиск остановлен лимитом узлов, решение может существовать
+    int height; // строк, которые очищает решение
+    int count;
+    TetroShapeClass pieces[PC_PIECES_MAX];
+    Placement placements[PC_PIECES_MAX];
+    uint64_t nodes;
+    double seconds;
+};
+
+// Столбцы доски решателя в координатах поля (строка 0 доски - нижняя строка поля), для MoveGen
+class PcColumns {
+private:
+    int width;
+    uint32_t columns[PC_WIDTH_MAX];
+
+public:
+    PcColumns(uint64_t cells, int width, int rows): width(width), columns() {
+        for (int r = 0; r < rows; r++) {
+            uint64_t row = cells >> (r * width);
+            for (int x = 0; x < width; x++) {
+                if ((row >> x) & 1) { this->columns[x] |= (uint32_t) 1 << (FIELD_H - 1 - r); }
+            }
+        }
+    }
+
+    int getWidth() const {
+        return this->width;
+    }
+
+    uint32_t columnBits(int x) const {
+        return this->columns[x];
+    }
+};
+
+// Задача очереди: позиция после depth фигур и путь к ней
+struct PcTask {
+    uint64_t cells;
+    int height;
+    int depth;
+    Placement path[PC_PIECES_MAX];
+};
+
+class PcWorker {
+public:
+    std::mutex mutex;
+    std::deque<PcTask> tasks; // свои - с конца (в глубину), чужие крадутся с начала (крупные поддеревья)
+    MoveGen moveGen;
+    std::vector<Placement> levels[PC_PIECES_MAX];
+    Placement path[PC_PIECES_MAX];
+    uint64_t nodes;
+    uint64_t batch;
+
+    PcWorker(): nodes(0), batch(0) {}
+};
+
+// =============
+// PerfectClearSolver: ищет порядок постановки известной очереди фигур (без удержания),
+// после которого поле пустое. Высота решения перебирается от высоты стопки вверх;
+// для каждой - поиск в глубину по местам фиксации MoveGen с отсечениями:
+//  - высота: фигура не может выйти выше строк, которые еще предстоит очистить;
+//  - пустые клетки заполняются ровно несколькими следующими фигурами очереди (по числу плиток);
+//  - четность столбцов: разницу пустых клеток в четных и нечетных столбцах должны выровнять
+//    эти фигуры. Каждая ориентация меняет ее на свое +-parity (у тетрамино L и J - 2, T и I -
+//    0 или 2 (4 у I), остальные 0): разница не больше суммы |parity| и по модулю 4 достижима.
+//    Очистка строк сдвигает клетки только по вертикали, поэтому оценка точна при любых очистках;
+//  - группы столбцов, между которыми фигуре не пройти, заполняются целыми фигурами: пустых
+//    клеток в каждой кратно НОД числа плиток (только для связных фигур).
+// Повторные позиции (доска, высота, номер фигуры) отсекаются по общей lock-free хеш-таблице.
+// Верх дерева делится на задачи: каждый поток берет свои с конца очереди, а без работы
+// крадет у других с начала.
+
+class PerfectClearSolver {
+private:
+    int threadsCount;
+    std::vector<std::unique_ptr<PcWorker>> workers;
+    std::unique_ptr<std::atomic<uint64_t>[]> table; // хеш позиции без младшего байта | поколение
+    uint8_t generation; // 0 - пустая ячейка, иначе номер поиска; старые записи считаются свободными
+
+    // Текущий поиск
+    int width;
+    int count;
+    const PieceSet* pieceSet;
+    TetroShapeClass pieces[PC_PIECES_MAX];
+    int8_t finishAt[PC_PIECES_MAX + 1][PC_CELLS + 1]; // [i][n] - n пустых клеток заполняют фигуры с i до этой, -1 - никакие
+    int parityAfter[PC_PIECES_MAX + 1]; // сумма наибольших |parity| фигур с i до конца
+    uint8_t residues[PC_PIECES_MAX + 1][PC_PIECES_MAX + 1]; // [i][j] - бит r: разница четностей фигур i..j-1 бывает r по модулю 4
+    uint8_t groupTiles[PC_PIECES_MAX + 1][PC_PIECES_MAX + 1]; // [i][j] - НОД плиток фигур i..j-1, 1 - проверки групп нет
+    uint64_t rowMask;
+    uint64_t evenColumns;
+    uint64_t columnMasks[PC_WIDTH_MAX];
+    uint64_t nodeLimit;
+
+    std::atomic<int> pending; // поставленные, но еще не разобранные задачи
+    std::atomic<bool> stopping;
+    std::atomic<bool> aborted;
+    std::atomic<uint64_t> nodes;
+    std::mutex resultMutex;
+    int resultCount;
+    Placement resultPath[PC_PIECES_MAX];
+
+    static uint64_t hashPosition(uint64_t cells, int height, int depth) {
+        uint64_t z = cells ^ ((uint64_t) (height * PC_PIECES_MAX + depth + 1) * 0xD6E8FEB86659FD93ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t areaMask(int rows) const {
+        return rows * this->width >= 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << (rows * this->width)) - 1;
+    }
+
+    // false - позиция уже встречалась (или разбирается другим потоком).
+    // Совпадение 56-битных хешей разных позиций считается невозможным.
+    bool markVisited(uint64_t cells, int height, int depth) {
+        uint64_t hash = hashPosition(cells, height, depth);
+        uint64_t entry = (hash & ~(uint64_t) 0xFF) | this->generation;
+        size_t mask = ((size_t) 1 << PC_TABLE_BITS) - 1;
+        size_t index = (size_t) (hash >> 8) & mask;
+        for (int probe = 0; probe < PC_TABLE_PROBES; probe++) {
+            std::atomic<uint64_t>& slot = this->table[(index + probe) & mask];
+            uint64_t current = slot.load(std::memory_order_relaxed);
+            while ((current & 0xFF) != this->generation) {
+                if (slot.compare_exchange_weak(current, entry, std::memory_order_relaxed)) { return true; }
+            }
+            if (current == entry) { return false; }
+        }
+        // Все пробы заняты - позиция просто разбирается еще раз
+        return true;
+    }
+
+    // Ставит фигуру и убирает заполненные строки. false - фигура выходит выше height.
+    bool place(uint64_t cells, int height, TetroShapeClass clazz, const Placement& placement,
+               uint64_t* nextCells, int* nextHeight) const {
+        const PieceOrientation& orientation = this->pieceSet->orientation(clazz, placement.variant);
+        for (int i = 0; i < orientation.tilesCount; i++) {
+            int row = FIELD_H - 1 - (placement.y + orientation.offsetsY[i]);
+            if (row >= height) { return false; }
+            cells |= (uint64_t) 1 << (row * this->width + placement.x + orientation.offsetsX[i]);
+        }
+        // Сверху вниз: номера нижних строк при удалении не меняются
+        for (int row = height - 1; row >= 0; row--) {
+            if (((cells >> (row * this->width)) & this->rowMask) != this->rowMask) { continue; }
+            uint64_t below = cells & this->areaMask(row);
+            uint64_t above = (row + 1) * this->width >= 64 ? 0 : cells >> ((row + 1) * this->width);
+            cells = below | (above << (row * this->width));
+            height -= 1;
+        }
+        *nextCells = cells;
+        *nextHeight = height;
+        return true;
+    }
+
+    // Отсечения по числу пустых клеток и четности столбцов для позиции перед фигурой depth
+    bool canFinish(uint64_t cells, int height, int depth) const {
+        uint64_t empty = ~cells & this->areaMask(height);
+        int emptyCount = countBits64(empty);
+        int last = this->finishAt[depth][emptyCount];
+        if (last < 0) { return false; }
+
+        int imbalance = 2 * countBits64(empty & this->evenColumns) - emptyCount;
+        if (std::abs(imbalance) > this->parityAfter[depth] - this->parityAfter[last]) { return false; }
+        if (((this->residues[depth][last] >> (imbalance & 3)) & 1) == 0) { return false; }
+
+        int groupTiles = this->groupTiles[depth][last];
+        if (groupTiles <= 1) { return true; }
+        // Группы столбцов: в соседний столбец фигура переходит только по строке, где пусты оба,
+        // а по вертикали - через любые строки (промежуточные могут очиститься). Значит, каждая
+        // группа связанных так столбцов заполняется целыми фигурами.
+        uint64_t links = empty & (empty >> 1) & ~this->columnMasks[this->width - 1];
+        int groupCount = 0;
+        for (int x = 0; x < this->width; x++) {
+            groupCount += countBits64(empty & this->columnMasks[x]);
+            if ((links & this->columnMasks[x]) != 0) { continue; }
+            if (groupCount % groupTiles != 0) { return false; }
+            groupCount = 0;
+        }
+        return true;
+    }
+
+    // Плитки ориентации связаны по сторонам: тогда между столбцами фигура проходит по одной строке
+    static bool isConnected(const PieceOrientation& orientation) {
+        uint32_t reached = 1;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int i = 0; i < orientation.tilesCount; i++) {
+                if ((reached >> i) & 1) { continue; }
+                for (int j = 0; j < orientation.tilesCount; j++) {
+                    int distance = std::abs(orientation.offsetsX[i] - orientation.offsetsX[j])
+                            + std::abs(orientation.offsetsY[i] - orientation.offsetsY[j]);
+                    if (((reached >> j) & 1) && distance == 1) {
+                        reached |= (uint32_t) 1 << i;
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+        return reached == ((uint32_t) 1 << orientation.tilesCount) - 1;
+    }
+
+    // Таблицы отсечений canFinish для очереди this->pieces
+    void preparePieces(const TetroShapeClass* queue) {
+        int tiles[PC_PIECES_MAX];
+        int maxParity[PC_PIECES_MAX];
+        uint8_t parities[PC_PIECES_MAX];
+        bool connected[PC_PIECES_MAX];
+        for (int i = 0; i < this->count; i++) {
+            this->pieces[i] = queue[i];
+            const PieceClass& piece = this->pieceSet->classes[queue[i]];
+            tiles[i] = piece.orientations[0].tilesCount;
+            maxParity[i] = 0;
+            parities[i] = 0;
+            connected[i] = true;
+            for (int v = 0; v < piece.orientationsCount; v++) {
+                int parity = piece.orientations[v].parity;
+                maxParity[i] = std::max(maxParity[i], std::abs(parity));
+                parities[i] |= (1 << (parity & 3)) | (1 << (-parity & 3));
+                connected[i] = connected[i] && isConnected(piece.orientations[v]);
+            }
+        }
+
+        this->parityAfter[this->count] = 0;
+        for (int i = this->count - 1; i >= 0; i--) {
+            this->parityAfter[i] = this->parityAfter[i + 1] + maxParity[i];
+        }
+        for (int i = 0; i <= this->count; i++) {
+            std::fill(this->finishAt[i], this->finishAt[i] + PC_CELLS + 1, -1);
+            int filled = 0;
+            uint8_t reachable = 1;
+            int divisor = 0;
+            bool isConnectedRange = true;
+            for (int j = i; j <= this->count; j++) {
+                if (j > i) {
+                    filled += tiles[j - 1];
+                    uint8_t next = 0;
+                    for (int a = 0; a < 4; a++) {
+                        if ((reachable >> a) & 1) {
+                            for (int b = 0; b < 4; b++) {
+                                if ((parities[j - 1] >> b) & 1) { next |= 1 << ((a + b) & 3); }
+                            }
+                        }
+                    }
+                    reachable = next;
+                    divisor = std::gcd(divisor, tiles[j - 1]);
+                    isConnectedRange = isConnectedRange && connected[j - 1];
+                }
+                if (filled <= PC_CELLS) { this->finishAt[i][filled] = (int8_t) j; }
+                this->residues[i][j] = reachable;
+                this->groupTiles[i][j] = (uint8_t) (isConnectedRange ? divisor : 1);
+            }
+        }
+    }
+
+    void pushTask(int workerIndex, uint64_t cells, int height, int depth, const Placement* path) {
+        PcWorker& worker = *this->workers[workerIndex];
+        PcTask task;
+        task.cells = cells;
+        task.height = height;
+        task.depth = depth;
+        std::copy(path, path + depth, task.path);
+        this->pending.fetch_add(1);
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(task);
+    }
+
+    bool popTask(int workerIndex, PcTask* task) {
+        {
+            PcWorker& worker = *this->workers[workerIndex];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if (!worker.tasks.empty()) {
+                *task = worker.tasks.back();
+                worker.tasks.pop_back();
+                return true;
+            }
+        }
+        for (int i = 1; i < this->threadsCount; i++) {
+            PcWorker& victim = *this->workers[(workerIndex + i) % this->threadsCount];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                *task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void publish(const Placement* path, int length) {
+        std::lock_guard<std::mutex> lock(this->resultMutex);
+        if (this->resultCount > 0) { return; }
+        std::copy(path, path + length, this->resultPath);
+        this->resultCount = length;
+        this->stopping = true;
+    }
+
+    // Возвращает true, когда поиск пора прекращать
+    bool expand(int workerIndex, uint64_t cells, int height, int depth) {
+        PcWorker& worker = *this->workers[workerIndex];
+        if (this->stopping.load(std::memory_order_relaxed)) { return true; }
+        worker.nodes += 1;
+        if (++worker.batch == PC_NODES_BATCH) {
+            worker.batch = 0;
+            if (this->nodes.fetch_add(PC_NODES_BATCH, std::memory_order_relaxed) + PC_NODES_BATCH > this->nodeLimit) {
+                this->aborted = true;
+                this->stopping = true;
+                return true;
+            }
+        }
+
+        TetroShapeClass clazz = this->pieces[depth];
+        std::vector<Placement>& placements = worker.levels[depth];
+        placements.clear();
+        worker.moveGen.generate(PcColumns(cells, this->width, height), clazz, &placements);
+
+        for (size_t i = 0; i < placements.size(); i++) {
+            uint64_t nextCells;
+            int nextHeight;
+            if (!this->place(cells, height, clazz, placements[i], &nextCells, &nextHeight)) { continue; }
+            worker.path[depth] = placements[i];
+            if (nextCells == 0) {
+                this->publish(worker.path, depth + 1);
+                return true;
+            }
+            if (depth + 1 == this->count) { continue; }
+            if (!this->canFinish(nextCells, nextHeight, depth + 1)) { continue; }
+            if (!this->markVisited(nextCells, nextHeight, depth + 1)) { continue; }
+
+            if (depth + 1 < PC_SPLIT_DEPTH) {
+                this->pushTask(workerIndex, nextCells, nextHeight, depth + 1, worker.path);
+            } else if (this->expand(workerIndex, nextCells, nextHeight, depth + 1)) {
+                return true;
+            }
+        }
+        return this->stopping.load(std::memory_order_relaxed);
+    }
+
+    void work(int workerIndex) {
+        PcWorker& worker = *this->workers[workerIndex];
+        PcTask task;
+        while (this->pending.load() > 0) {
+            if (!this->popTask(workerIndex, &task)) {
+                std::this_thread::yield();
+                continue;
+            }
+            // После остановки задачи только снимаются с очередей
+            if (!this->stopping.load(std::memory_order_relaxed)) {
+                std::copy(task.path, task.path + task.depth, worker.path);
+                this->expand(workerIndex, task.cells, task.height, task.depth);
+            }
+            this->pending.fetch_sub(1);
+        }
+    }
+
+    // Один поиск решения высоты height; остальные потоки подключаются на его время
+    bool searchHeight(uint64_t cells, int height) {
+        // Таблица чистится только при переполнении номера поиска
+        if (this->generation == 0xFF) {
+            for (size_t i = 0; i < ((size_t) 1 << PC_TABLE_BITS); i++) { this->table[i].store(0, std::memory_order_relaxed); }
+            this->generation = 0;
+        }
+        this->generation += 1;
+        this->stopping = false;
+        this->resultCount = 0;
+        this->pushTask(0, cells, height, 0, NULL);
+
+        std::vector<std::thread> helpers;
+        for (int i = 1; i < this->threadsCount; i++) {
+            helpers.emplace_back([this, i]() { this->work(i); });
+        }
+        this->work(0);
+        for (auto& helper : helpers) {
+            helper.join();
+        }
+        return this->resultCount > 0;
+    }
+
+public:
+    explicit PerfectClearSolver(int threadsCount):
+            threadsCount(std::max(1, threadsCount)),
+            table(new std::atomic<uint64_t>[(size_t) 1 << PC_TABLE_BITS]),
+            generation(0),
+            width(0),
+            count(0),
+            pieceSet(NULL),
+            pieces(),
+            finishAt(),
+            parityAfter(),
+            residues(),
+            groupTiles(),
+            rowMask(0),
+            evenColumns(0),
+            columnMasks(),
+            nodeLimit(PC_DEFAULT_NODE_LIMIT),
+            pending(0),
+            stopping(false),
+            aborted(false),
+            nodes(0),
+            resultCount(0),
+            resultPath() {
+        for (int i = 0; i < this->threadsCount; i++) {
+            this->workers.push_back(std::make_unique<PcWorker>());
+        }
+        for (size_t i = 0; i < ((size_t) 1 << PC_TABLE_BITS); i++) { this->table[i].store(0, std::memory_order_relaxed); }
+    }
+
+    PerfectClearSolver(const PerfectClearSolver&) = delete;
+
+    // queue - известные фигуры по порядку, первая ставится первой (удержания нет).
+    // Field - TetroField или другое поле с getWidth() и columnBits(x).
+    // Возвращает false, если поле не помещается в доску решателя (шире PC_WIDTH_MAX
+    // или занято выше PC_HEIGHT_MAX строк) - тогда решения в пределах решателя нет.
+    template<typename Field>
+    bool solve(const Field& field, const TetroShapeClass* queue, int queueCount, uint64_t nodeLimit, PcSolution* out) {
+        auto start = std::chrono::steady_clock::now();
+        *out = PcSolution();
+        int width = field.getWidth();
+        if (width > PC_WIDTH_MAX) { return false; }
+
+        int maxHeight = std::min(PC_HEIGHT_MAX, 64 / width);
+        uint64_t cells = 0;
+        int stackHeight = 0;
+        for (int x = 0; x < width; x++) {
+            uint32_t column = field.columnBits(x);
+            for (int row = 0; row < FIELD_H; row++) {
+                if (((column >> (FIELD_H - 1 - row)) & 1) == 0) { continue; }
+                if (row >= maxHeight) { return false; }
+                cells |= (uint64_t) 1 << (row * width + x);
+                stackHeight = std::max(stackHeight, row + 1);
+            }
+        }
+
+        this->width = width;
+        this->count = std::min(queueCount, PC_PIECES_MAX);
+        this->rowMask = ((uint64_t) 1 << width) - 1;
+        this->evenColumns = 0;
+        std::fill(this->columnMasks, this->columnMasks + PC_WIDTH_MAX, 0);
+        for (int bit = 0; bit < 64; bit++) {
+            if ((bit % width) % 2 == 0) { this->evenColumns |= (uint64_t) 1 << bit; }
+            this->columnMasks[bit % width] |= (uint64_t) 1 << bit;
+        }
+        this->pieceSet = &PieceSet::active();
+        this->preparePieces(queue);
+        this->nodeLimit = nodeLimit;
+        this->nodes = 0;
+        this->aborted = false;
+        for (auto& worker : this->workers) {
+            worker->nodes = 0;
+            worker->batch = 0;
+        }
+
+        for (int height = std::max(1, stackHeight); height <= maxHeight && this->count > 0; height++) {
+            if (!this->canFinish(cells, height, 0)) { continue; }
+            if (this->searchHeight(cells, height)) {
+                out->found = true;
+                out->height = height;
+                out->count = this->resultCount;
+                std::copy(this->pieces, this->pieces + this->resultCount, out->pieces);
+                std::copy(this->resultPath, this->resultPath + this->resultCount, out->placements);
+                break;
+            }
+            if (this->aborted) { break; }
+        }
+
+        out->aborted = this->aborted && !out->found;
+        for (auto& worker : this->workers) { out->nodes += worker->nodes; }
+        out->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <thread>
+#include "concurrent/spsc_queue.cpp"
+#include "game.cpp"
+
+// Записей в очереди; при переполнении новые записи отбрасываются, игра не ждет
+#define TELEMETRY_QUEUE_SIZE 1024
+// Как часто поток записи проверяет очередь, когда она пуста
+#define TELEMETRY_POLL_MS 100
+
+enum TelemetryEvent { telemetryPiece = 0, telemetryGameOver = 1, telemetryGameQuit = 2 };
+
+const char* TELEMETRY_EVENT_NAMES[3] = { "piece", "game_over", "game_quit" };
+
+// Запись фиксированного размера: поток игры только копирует ее в очередь
+struct TelemetryRecord {
+    uint8_t event;
+    uint8_t board;
+    uint8_t shape; // только piece
+    uint8_t variant;
+    int16_t x;
+    int16_t y;
+    int32_t inputs;
+    int32_t finesseFaults; // piece - за фигуру, конец партии - за всю партию
+    int32_t clearedTiles; // piece - за фигуру, конец партии - за всю партию
+    int32_t linesCleared;
+    int32_t scoreDelta;
+    int32_t score;
+    int32_t level;
+    int32_t pieces;
+    float time; // от начала партии, с
+    float pieceTime;
+};
+
+// =============
+// TelemetryWriter: статистика фигур и партий в CSV (дописывается в конец файла).
+// Поток игры кладет записи в SPSC-очередь, отдельный поток форматирует и пишет их,
+// так что файловый ввод-вывод не попадает ни в тик симуляции, ни в App::tick.
+
+class TelemetryWriter {
+private:
+    SpscQueue<TelemetryRecord, TELEMETRY_QUEUE_SIZE> queue;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> dropped;
+    std::thread thread;
+    FILE* file;
+    uint64_t session; // отличает запуски в одном файле
+
+    void run() {
+        while (true) {
+            // Флаг читается до опустошения очереди: записи, положенные до stop(), не теряются
+            bool isRunning = this->running.load();
+            int written = 0;
+            TelemetryRecord record;
+            while (this->queue.pop(&record)) {
+                this->writeRecord(record);
+                written += 1;
+            }
+            if (written > 0) { fflush(this->file); }
+            if (!isRunning) { break; }
+            std::this_thread::sleep_for(std::chrono::milliseconds(TELEMETRY_POLL_MS));
+        }
+    }
+
+    void writeRecord(const TelemetryRecord& record) {
+        bool isPiece = record.event == TelemetryEvent::telemetryPiece;
+        float piecesPerSecond = record.time > 0.0f ? (float) record.pieces / record.time : 0.0f;
+        fprintf(
+                this->file, "%llu,%d,%s,%.3f,%s,%d,%d,%d,%.3f,%d,%d,%d,%d,%d,%d,%d,%d,%.3f\n",
+                (unsigned long long) this->session, record.board, TELEMETRY_EVENT_NAMES[record.event], record.time,
+                isPiece ? PieceSet::active().classes[record.shape].name : "", record.variant, record.x, record.y, record.pieceTime,
+                record.inputs, record.finesseFaults, record.linesCleared, record.clearedTiles, record.scoreDelta,
+                record.score, record.level, record.pieces, piecesPerSecond
+        );
+    }
+
+    void push(const TelemetryRecord& record) {
+        if (!this->queue.push(record)) {
+            this->dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+public:
+    // Файл не открылся - телеметрии просто нет, играть это не мешает
+    static std::unique_ptr<TelemetryWriter> open(const char* path) {
+        FILE* file = fopen(path, "a");
+        if (file == NULL) {
+            LOG_WARN("Unable open telemetry file: %s", path);
+            return NULL;
+        }
+        return std::make_unique<TelemetryWriter>(file);
+    }
+
+    explicit TelemetryWriter(FILE* file):
+            running(true),
+            dropped(0),
+            file(file),
+            session((uint64_t) time(NULL)) {
+        fseek(this->file, 0, SEEK_END);
+        if (ftell(this->file) == 0) {
+            fprintf(this->file, "session,board,event,time_s,piece,rotation,x,y,piece_time_s,inputs,finesse_faults,"
+                                "lines,cleared_tiles,score_delta,score,level,pieces,pieces_per_s\n");
+        }
+        this->thread = std::thread([this]() { this->run(); });
+    }
+
+    TelemetryWriter(const TelemetryWriter&) = delete;
+
+    ~TelemetryWriter() {
+        this->running = false;
+        if (this->thread.joinable()) {
+            this->thread.join();
+        }
+        fclose(this->file);
+        uint64_t droppedCount = this->dropped.load();
+        if (droppedCount > 0) {
+            LOG_WARN("Telemetry: %llu records dropped (queue full)", (unsigned long long) droppedCount);
+        }
+    }
+
+    // [game thread]
+    void pushPiece(int board, const TetroGame& game, const PieceStats& piece) {
+        TelemetryRecord record;
+        memset(&record, 0, sizeof(record));
+        record.event = TelemetryEvent::telemetryPiece;
+        record.board = (uint8_t) board;
+        record.shape = (uint8_t) piece.clazz;
+        record.variant = (uint8_t) piece.variant;
+        record.x = (int16_t) piece.x;
+        record.y = (int16_t) piece.y;
+        record.inputs = piece.inputs;
+        record.finesseFaults = piece.finesseFaults;
+        record.clearedTiles = piece.clearedTiles;
+        record.linesCleared = game.config.cleaningMode == CleaningMode::line ? piece.clearedTiles / game.field.getWidth() : 0;
+        record.scoreDelta = piece.scoreDelta;
+        record.score = game.score;
+        record.level = piece.level;
+        record.pieces = game.stats.pieces;
+        record.time = piece.lockTime;
+        record.pieceTime = piece.pieceTime;
+        this->push(record);
+    }
+
+    // [game thread]
+    void pushGameEnd(int board, const TetroGame& game, TelemetryEvent event) {
+        TelemetryRecord record;
+        memset(&record, 0, sizeof(record));
+        record.event = event;
+        record.board = (uint8_t) board;
+        record.finesseFaults = game.stats.finesseFaults;
+        record.clearedTiles = game.clearedTiles;
+        record.linesCleared = game.config.cleaningMode == CleaningMode::line ? game.clearedTiles / game.field.getWidth() : 0;
+        record.score = game.score;
+        record.level = game.level;
+        record.pieces = game.stats.pieces;
+        record.time = game.stats.playTime;
+        this->push(record);
+    }
+};
@@ -1,11 +1,15 @@
+#pragma once
+
+#include <cstring>
 #include <optional>
 #include <stdexcept>
-#include "shape_lines.cpp"
+#include "piece_set.cpp"
+#include "bit_rows.cpp"
+#include "config.cpp"
+#include "log.cpp"
 
-#define FIELD_W 10
 #define FIELD_H 24
 
-
 // =================================================
 // [ Плитка (1 плитка, не фигура!!!) и поле плиток ]
 
@@ -25,92 +29,265 @@ const TetroColor BASE_TILES[6] = {red, orange, yellow, green, blue, violet };
 // TODO: Add class
 using TetroTile = TetroColor;
 
+// Цвет мусорных строк
+#define GARBAGE_COLOR TetroColor::black
+
+// Ширина поля задается при запуске (GameConfig::fieldWidth), память - под максимальную
+static_assert(FIELD_W_MAX <= BIT_ROW_BITS, "Field row must fit into BitRow");
+static_assert(FIELD_H <= 32, "Field column must fit into uint32_t");
+
 class TetroField {
 private:
-    std::optional<TetroColor> tiles[FIELD_W][FIELD_H];
+    int width;
+    int rowVectors; // сколько 256-битных блоков BitRow занимает строка
+    BitRow filled[FIELD_H]; // занятость клеток, по ней идут проверки строк и столкновения
+    BitRow fullRow; // маска полной строки для текущей ширины
+    uint32_t columns[FIELD_W_MAX]; // бит y - занята ли клетка (x, y); для запросов высоты падения
+    uint8_t tiles[FIELD_H][FIELD_W_MAX]; // 0 - пусто, иначе цвет + 1
+
+    void setFilledBit(int x, int y, bool isFilled) {
+        uint64_t bit = (uint64_t) 1 << (x % 64);
+        if (isFilled) {
+            this->filled[y].words[x / 64] |= bit;
+            this->columns[x] |= (uint32_t) 1 << y;
+        } else {
+            this->filled[y].words[x / 64] &= ~bit;
+            this->columns[x] &= ~((uint32_t) 1 << y);
+        }
+    }
+
+    // Столбцы заново по строкам - после перестановки строк в произвольном порядке
+    void rebuildColumns() {
+        memset(this->columns, 0, sizeof(this->columns[0]) * this->width);
+        for (int y = 0; y < FIELD_H; y++) {
+            for (int w = 0; w < this->rowVectors * BIT_ROW_VECTOR_WORDS; w++) {
+                uint64_t word = this->filled[y].words[w];
+                while (word != 0) {
+                    int x = w * 64 + countTrailingZeros64(word);
+                    this->columns[x] |= (uint32_t) 1 << y;
+                    word &= word - 1;
+                }
+            }
+        }
+    }
+
+    void copyRow(int from, int to) {
+        this->filled[to] = this->filled[from];
+        memcpy(this->tiles[to], this->tiles[from], this->width);
+    }
+
+    void moveRows(int from, int to, int count) {
+        memmove(&this->filled[to], &this->filled[from], sizeof(this->filled[0]) * count);
+        memmove(&this->tiles[to], &this->tiles[from], sizeof(this->tiles[0]) * count);
+    }
 
 public:
-    std::optional<std::optional<TetroColor>*> get(int x, int y) {
-        if (x < 0 || x >= FIELD_W) { return std::optional<std::optional<TetroColor>*>(); }
-        if (y < 0 || y >= FIELD_H) { return std::optional<std::optional<TetroColor>*>(); }
-        return std::optional<std::optional<TetroColor>*>(&this->tiles[x][y]);
+    TetroField(): TetroField(DEFAULT_FIELD_W) {}
+
+    TetroField(int width): width(width), rowVectors((width + 255) / 256), filled(), fullRow(), columns(), tiles() {
+        if (width < FIELD_W_MIN || width > FIELD_W_MAX) {
+            LOG_ERROR("Invalid field width %d", width);
+            throw std::out_of_range("Field width");
+        }
+        for (int x = 0; x < width; x++) {
+            this->fullRow.words[x / 64] |= (uint64_t) 1 << (x % 64);
+        }
     }
 
-    std::optional<TetroColor>* getAssured(int x, int y) {
-        auto r = this->get(x, y);
-        if(r.has_value()) {
-            return r.value();
-        } else {
+    int getWidth() const {
+        return this->width;
+    }
+
+    std::optional<std::optional<TetroColor>> get(int x, int y) const {
+        if (x < 0 || x >= this->width) { return std::nullopt; }
+        if (y < 0 || y >= FIELD_H) { return std::nullopt; }
+        return std::optional(this->getAssured(x, y));
+    }
+
+    std::optional<TetroColor> getAssured(int x, int y) const {
+        if (x < 0 || x >= this->width || y < 0 || y >= FIELD_H) {
             throw std::out_of_range("Out of field range");
         }
+        uint8_t tile = this->tiles[y][x];
+        if (tile == 0) { return std::nullopt; }
+        return std::optional((TetroColor) (tile - 1));
+    }
+
+    // Занятость столбца x: бит y - клетка (x, y)
+    uint32_t columnBits(int x) const {
+        return this->columns[x];
+    }
+
+    // Занятость строки y: бит x слова x / 64. Слова за шириной поля - нули.
+    const uint64_t* rowBits(int y) const {
+        return this->filled[y].words;
+    }
+
+    // Без проверки границ - для горячих мест, где координаты уже проверены
+    bool isFilled(int x, int y) const {
+        return (this->filled[y].words[x / 64] >> (x % 64)) & 1;
+    }
+
+    // Без проверки границ: 0 - пусто, иначе цвет + 1
+    uint8_t tileCode(int x, int y) const {
+        return this->tiles[y][x];
     }
 
     void set(int x, int y, std::optional<TetroColor> tile) {
-        auto memCell = this->getAssured(x, y);
-        *memCell = tile;
+        if (x < 0 || x >= this->width || y < 0 || y >= FIELD_H) {
+            throw std::out_of_range("Out of field range");
+        }
+        this->tiles[y][x] = tile.has_value() ? (uint8_t) (tile.value() + 1) : 0;
+        this->setFilledBit(x, y, tile.has_value());
     }
 
     void clear() {
-        for (int x = 0; x < FIELD_W; x++) {
-            for (int y = 0; y < FIELD_H; y++) {
-                auto tile = this->getAssured(x, y);
-                *tile = std::nullopt;
-            }
+        this->clearRows(0, FIELD_H);
+    }
+
+    void clearRows(int first, int count) {
+        if (count <= 0) { return; }
+        for (int y = first; y < first + count; y++) {
+            this->filled[y] = BitRow();
+            memset(this->tiles[y], 0, this->width);
+        }
+        uint32_t rowsMask = (uint32_t) (((uint64_t) 1 << (first + count)) - ((uint64_t) 1 << first));
+        for (int x = 0; x < this->width; x++) {
+            this->columns[x] &= ~rowsMask;
         }
     }
 
     void removeLine(int line) {
-        for (int y = line; y > 0; y--) {
-            for (int x = 0; x < FIELD_W; x++) {
-                auto upper = this->getAssured(x, y - 1);
-                this->set(x, y, *upper);
-            }
+        if (line < 0 || line >= FIELD_H) {
+            throw std::out_of_range("Out of field range");
         }
-
-        for (int x = 0; x < FIELD_W; x++) {
-            this->set(x, 0, std::nullopt);
+        // Все строки выше удаленной опускаются на одну
+        this->moveRows(0, 1, line);
+        uint32_t aboveMask = ((uint32_t) 1 << line) - 1;
+        uint32_t belowMask = ~(uint32_t) (((uint64_t) 1 << (line + 1)) - 1);
+        for (int x = 0; x < this->width; x++) {
+            uint32_t column = this->columns[x];
+            this->columns[x] = ((column & aboveMask) << 1) | (column & belowMask);
         }
+        this->clearRows(0, 1);
     }
 
-    bool lineIsFull(int line) {
-        bool isFull = true;
-        for (int x = 0; x < FIELD_W; x++) {
-            if (!this->getAssured(x, line)->has_value()) {
-                isFull = false;
-                break;
-            }
+    // Поднимает все поле на count строк и заполняет освободившиеся снизу мусором
+    // с дыркой в столбце holeX. Верхние строки уходят за край поля.
+    void insertGarbageRows(int count, int holeX) {
+        if (count <= 0) { return; }
+        if (count > FIELD_H) { count = FIELD_H; }
+
+        this->moveRows(count, 0, FIELD_H - count);
+        uint32_t garbageMask = (uint32_t) (((uint64_t) 1 << FIELD_H) - ((uint64_t) 1 << (FIELD_H - count)));
+        for (int x = 0; x < this->width; x++) {
+            this->columns[x] = (uint32_t) ((uint64_t) this->columns[x] >> count) | garbageMask;
+        }
+        for (int y = FIELD_H - count; y < FIELD_H; y++) {
+            this->filled[y] = this->fullRow;
+            memset(this->tiles[y], GARBAGE_COLOR + 1, this->width);
+            this->tiles[y][holeX] = 0;
+            this->setFilledBit(holeX, y, false);
         }
-        return isFull;
     }
 
-    bool lineIsEmpty(int line) {
-        bool isEmpty = true;
-        for (int x = 0; x < FIELD_W; x++) {
-            if (this->getAssured(x, line)->has_value()) {
-                isEmpty = false;
-                break;
+    bool lineIsFull(int line) const {
+        return BitRowOps::get().covers(&this->filled[line], &this->fullRow, this->rowVectors);
+    }
+
+    bool lineIsEmpty(int line) const {
+        return BitRowOps::get().isZero(&this->filled[line], this->rowVectors);
+    }
+
+    // Плитки падают вниз по своим столбцам, пока не упрутся (режим очистки по цвету).
+    // Возвращает true, если что-то сдвинулось.
+    bool dropTiles() {
+        bool moved = false;
+        for (int x = 0; x < this->width; x++) {
+            int target = FIELD_H - 1;
+            for (int y = FIELD_H - 1; y >= 0; y--) {
+                uint8_t tile = this->tiles[y][x];
+                if (tile == 0) { continue; }
+                if (y != target) {
+                    this->tiles[target][x] = tile;
+                    this->setFilledBit(x, target, true);
+                    this->tiles[y][x] = 0;
+                    this->setFilledBit(x, y, false);
+                    moved = true;
+                }
+                target -= 1;
             }
         }
-        return isEmpty;
+        return moved;
     }
 
+    // Один проход снизу вверх: неполные строки сдвигаются вниз, сверху остаются пустые
     int removeFullLines() {
-        int removedLines = 0;
-        for (int line = 0; line < FIELD_H; line++) {
-            if (this->lineIsFull(line)) {
-                this->removeLine(line);
-                removedLines += 1;
-            }
+        int target = FIELD_H - 1;
+        for (int line = FIELD_H - 1; line >= 0; line--) {
+            if (this->lineIsFull(line)) { continue; }
+            if (line != target) { this->copyRow(line, target); }
+            target -= 1;
+        }
+        int removedLines = target + 1;
+        if (removedLines > 0) {
+            this->clearRows(0, removedLines);
+            this->rebuildColumns();
         }
         return removedLines;
     }
 
+    // Сколько пустых клеток под (x, y) до занятой клетки или дна - одним сдвигом маски столбца
+    int dropDistance(int x, int y) const {
+        uint32_t below = (uint32_t) ((uint64_t) this->columns[x] >> (y + 1));
+        if (below == 0) { return FIELD_H - 1 - y; }
+        return countTrailingZeros32(below);
+    }
+
+    // Сохранение партии: на строку - используемые блоки BitRow и байты плиток, без разбора по клеткам
+    size_t serializedSize() const {
+        return (size_t) FIELD_H * (this->rowVectors * sizeof(uint64_t) * BIT_ROW_VECTOR_WORDS + this->width);
+    }
+
+    void serialize(uint8_t* out) const {
+        size_t filledBytes = this->rowVectors * sizeof(uint64_t) * BIT_ROW_VECTOR_WORDS;
+        for (int y = 0; y < FIELD_H; y++) {
+            memcpy(out, this->filled[y].words, filledBytes);
+            out += filledBytes;
+            memcpy(out, this->tiles[y], this->width);
+            out += this->width;
+        }
+    }
+
+    // in - serializedSize() байт от поля той же ширины. false, если биты вылезают за ширину поля,
+    // цвет плитки неизвестен или плитки не совпадают с битами занятости.
+    bool deserialize(const uint8_t* in) {
+        size_t filledBytes = this->rowVectors * sizeof(uint64_t) * BIT_ROW_VECTOR_WORDS;
+        for (int y = 0; y < FIELD_H; y++) {
+            this->filled[y] = BitRow();
+            memcpy(this->filled[y].words, in, filledBytes);
+            in += filledBytes;
+            memcpy(this->tiles[y], in, this->width);
+            in += this->width;
+
+            if (!BitRowOps::get().covers(&this->fullRow, &this->filled[y], this->rowVectors)) { return false; }
+            for (int x = 0; x < this->width; x++) {
+                uint8_t tile = this->tiles[y][x];
+                if (tile > TetroColor::black + 1 || (tile != 0) != this->isFilled(x, y)) { return false; }
+            }
+        }
+        this->rebuildColumns();
+        return true;
+    }
+
 };
 
 // ===================================
 // [ Падающая фигура из нескольких плиток! ]
 
-enum TetroShapeClass {
+// Индекс фигуры в наборе (PieceSet). Имена - фигуры стандартного набора,
+// в загруженном наборе классы - просто номера от 0 до PieceSet::count.
+enum TetroShapeClass : uint8_t {
     I, L, J, T, S, Z, O,
     // Extra
     Dot
@@ -122,10 +299,13 @@ public:
     int variant;
 
     int tilesCount;
-    int offsetsX[16];
-    int offsetsY[16];
+    int offsetsX[PIECE_TILES_MAX];
+    int offsetsY[PIECE_TILES_MAX];
     TetroColor color;
 
+    // Пустая фигура, чтобы хранить прототипы в буферах фиксированного размера
+    TetroShapePrototype(): clazz(TetroShapeClass::O), variant(0), tilesCount(0), offsetsX(), offsetsY(), color(TetroColor::red) {}
+
     TetroShapePrototype(const TetroShapePrototype& other) {
         this->tilesCount = other.tilesCount;
         std::copy(std::begin(other.offsetsX), std::end(other.offsetsX), this->offsetsX);
@@ -135,76 +315,17 @@ public:
         this->variant = other.variant;
     }
 
-    TetroShapePrototype(TetroShapeClass clazz, int variant, TetroColor color) {
-        const char* line;
-
-        switch (clazz) {
-            case TetroShapeClass::O: line = SHAPE_O; break;
-            case TetroShapeClass::I:
-                switch (variant % 2) {
-                    case 0: line = SHAPE_I_0; break;
-                    case 1: line = SHAPE_I_1; break;
-                }
-                break;
-            case TetroShapeClass::T:
-                switch (variant % 4) {
-                    case 0: line = SHAPE_T_0; break;
-                    case 1: line = SHAPE_T_1; break;
-                    case 2: line = SHAPE_T_2; break;
-                    case 3: line = SHAPE_T_3; break;
-                }
-                break;
-            case TetroShapeClass::L:
-                switch (variant % 4) {
-                    case 0: line = SHAPE_L_0; break;
-                    case 1: line = SHAPE_L_1; break;
-                    case 2: line = SHAPE_L_2; break;
-                    case 3: line = SHAPE_L_3; break;
-                }
-                break;
-            case TetroShapeClass::J:
-                switch (variant % 4) {
-                    case 0: line = SHAPE_J_0; break;
-                    case 1: line = SHAPE_J_1; break;
-                    case 2: line = SHAPE_J_2; break;
-                    case 3: line = SHAPE_J_3; break;
-                }
-                break;
-            case TetroShapeClass::S:
-                switch (variant % 2) {
-                    case 0: line = SHAPE_S_0; break;
-                    case 1: line = SHAPE_S_1; break;
-                }
-                break;
-            case TetroShapeClass::Z:
-                switch (variant % 2) {
-                    case 0: line = SHAPE_Z_0; break;
-                    case 1: line = SHAPE_Z_1; break;
-                }
-                break;
-        }
-
-        // init
-        this->clazz = clazz;
-        this->variant = variant;
-
-        int c = 0;
-        for (int i = 0; i < 16; i++) {
-            int x = i % 4;
-            int y = i / 4;
-            if (line[i] == '#') {
-                this->offsetsX[c] = x;
-                this->offsetsY[c] = y;
-                c += 1;
-            }
-        }
-        if (c == 0) {
-            printf("EMPTY SHAPE\n");
-            exit(1);
-        }
+    // Плитки берутся из таблиц набора, собранных при его загрузке
+    TetroShapePrototype(TetroShapeClass clazz, int variant, TetroColor color):
+            clazz(clazz), variant(variant), tilesCount(0), offsetsX(), offsetsY(), color(color) {
+        const PieceOrientation& shape = this->orientation();
+        this->tilesCount = shape.tilesCount;
+        std::copy(shape.offsetsX, shape.offsetsX + shape.tilesCount, this->offsetsX);
+        std::copy(shape.offsetsY, shape.offsetsY + shape.tilesCount, this->offsetsY);
+    }
 
-        this->color = color;
-        this->tilesCount = c;
+    const PieceOrientation& orientation() const {
+        return PieceSet::active().orientation(this->clazz, this->variant);
     }
 
     TetroShapePrototype rotated() {
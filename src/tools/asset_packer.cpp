@@ -0,0 +1,105 @@
+// Сборка архива ассетов: все BMP конвертируются в формат пикселей рендера
+// и пишутся одним файлом с индексом.
+//
+// Usage: asset_packer <output.pak> <assets dir> <relative path>...
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <SDL2/SDL.h>
+#include "../assets/asset_archive.cpp"
+
+#define PACK_PIXEL_FORMAT SDL_PIXELFORMAT_ARGB8888
+
+struct PackedTexture {
+    AssetArchiveEntry entry;
+    std::vector<uint8_t> pixels;
+};
+
+bool packTexture(const char* assetsDir, const char* name, PackedTexture* packed) {
+    if (strlen(name) >= ASSET_NAME_SIZE) {
+        printf("Asset name too long: %s\n", name);
+        return false;
+    }
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", assetsDir, name);
+
+    auto surface = SDL_LoadBMP(path);
+    if (surface == NULL) {
+        printf("Unable load texture: %s!\nSDL Error: %s\n", path, SDL_GetError());
+        return false;
+    }
+    // Как SDL_CreateTextureFromSurface: смешивание только для поверхностей с альфой
+    bool hasAlpha = surface->format->Amask != 0;
+
+    auto converted = SDL_ConvertSurfaceFormat(surface, PACK_PIXEL_FORMAT, 0);
+    SDL_FreeSurface(surface);
+    if (converted == NULL) {
+        printf("Unable convert texture: %s!\nSDL Error: %s\n", path, SDL_GetError());
+        return false;
+    }
+
+    uint32_t rowSize = (uint32_t) converted->w * 4;
+    memset(&packed->entry, 0, sizeof(packed->entry));
+    strncpy(packed->entry.name, name, ASSET_NAME_SIZE - 1);
+    packed->entry.pixelFormat = PACK_PIXEL_FORMAT;
+    packed->entry.width = (uint32_t) converted->w;
+    packed->entry.height = (uint32_t) converted->h;
+    packed->entry.pitch = rowSize;
+    packed->entry.flags = hasAlpha ? ASSET_FLAG_BLEND : 0;
+    packed->entry.size = (uint64_t) rowSize * converted->h;
+
+    packed->pixels.resize(packed->entry.size);
+    for (int y = 0; y < converted->h; y++) {
+        auto src = (const uint8_t*) converted->pixels + (size_t) y * converted->pitch;
+        memcpy(packed->pixels.data() + (size_t) y * rowSize, src, rowSize);
+    }
+    SDL_FreeSurface(converted);
+    return true;
+}
+
+uint64_t alignUp(uint64_t value) {
+    return (value + ASSET_ARCHIVE_ALIGN - 1) / ASSET_ARCHIVE_ALIGN * ASSET_ARCHIVE_ALIGN;
+}
+
+int main(int argc, char* args[]) {
+    if (argc < 4) {
+        printf("Usage: %s <output.pak> <assets dir> <relative path>...\n", args[0]);
+        return 1;
+    }
+    const char* outputPath = args[1];
+    const char* assetsDir = args[2];
+
+    std::vector<PackedTexture> textures(argc - 3);
+    for (int i = 3; i < argc; i++) {
+        if (!packTexture(assetsDir, args[i], &textures[i - 3])) { return 1; }
+    }
+
+    // Раскладка: заголовок, индекс, затем выровненные пиксели
+    uint64_t offset = alignUp(sizeof(AssetArchiveHeader) + textures.size() * sizeof(AssetArchiveEntry));
+    for (auto& texture : textures) {
+        texture.entry.offset = offset;
+        offset = alignUp(offset + texture.entry.size);
+    }
+
+    std::vector<uint8_t> archive(offset, 0);
+    AssetArchiveHeader header = AssetArchiveHeader { ASSET_ARCHIVE_MAGIC, ASSET_ARCHIVE_VERSION, (uint32_t) textures.size(), 0 };
+    memcpy(archive.data(), &header, sizeof(header));
+    for (size_t i = 0; i < textures.size(); i++) {
+        auto& texture = textures[i];
+        memcpy(archive.data() + sizeof(header) + i * sizeof(AssetArchiveEntry), &texture.entry, sizeof(AssetArchiveEntry));
+        memcpy(archive.data() + texture.entry.offset, texture.pixels.data(), texture.entry.size);
+    }
+
+    auto file = fopen(outputPath, "wb");
+    if (file == NULL || fwrite(archive.data(), 1, archive.size(), file) != archive.size()) {
+        printf("Unable write asset archive: %s\n", outputPath);
+        if (file != NULL) { fclose(file); }
+        return 1;
+    }
+    fclose(file);
+
+    printf("Packed %zu textures into %s (%zu bytes)\n", textures.size(), outputPath, archive.size());
+    return 0;
+}
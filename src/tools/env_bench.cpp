@@ -0,0 +1,72 @@
+// Проверка и замер среды для обучения через ее C ABI: случайные ходы в пачке партий.
+// В режиме размещения ходы выбираются только из допустимых по маске.
+//
+// Usage: env_bench [envs] [steps] [tick|placement] [width]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "../env/tetris_env.h"
+#include "../utils.cpp"
+
+int main(int argc, char** argv) {
+    int envsCount = argc > 1 ? atoi(argv[1]) : 64;
+    int steps = argc > 2 ? atoi(argv[2]) : 10000;
+    bool isPlacement = argc > 3 && strcmp(argv[3], "placement") == 0;
+    int width = argc > 4 ? atoi(argv[4]) : 10;
+
+    TetrisEnvConfig config = { envsCount, isPlacement ? TETRIS_ENV_PLACEMENT : TETRIS_ENV_TICK, width, 5, 1, 0 };
+    TetrisEnv* env = tetris_env_create(&config);
+    if (env == NULL || steps <= 0) {
+        printf("Usage: %s [envs] [steps] [tick|placement] [width]\n", argv[0]);
+        return 1;
+    }
+
+    int words = tetris_env_board_words(env);
+    int actionsCount = tetris_env_action_count(env);
+    std::vector<uint64_t> board((size_t) envsCount * TETRIS_ENV_ROWS * words);
+    std::vector<int32_t> piece((size_t) envsCount * TETRIS_ENV_PIECE_FIELDS);
+    std::vector<int32_t> preview((size_t) envsCount * config.previewCount);
+    std::vector<float> rewards(envsCount);
+    std::vector<uint8_t> dones(envsCount);
+    std::vector<uint8_t> mask((size_t) envsCount * actionsCount);
+    std::vector<int32_t> actions(envsCount, 0);
+
+    TetrisEnvBuffers buffers = { board.data(), piece.data(), preview.data(), rewards.data(), dones.data(), mask.data() };
+    tetris_env_set_buffers(env, &buffers);
+    tetris_env_reset(env, 1);
+
+    uint32_t random = 12345;
+    auto nextRandom = [&random]() { return xorshift32(&random); };
+
+    double totalReward = 0.0;
+    long long episodes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; step++) {
+        for (int i = 0; i < envsCount; i++) {
+            if (!isPlacement) {
+                actions[i] = (int32_t) (nextRandom() % actionsCount);
+                continue;
+            }
+            // Случайный допустимый ход: от случайной точки до первой единицы маски
+            const uint8_t* envMask = mask.data() + (size_t) i * actionsCount;
+            int action = (int) (nextRandom() % actionsCount);
+            for (int k = 0; k < actionsCount && envMask[action] == 0; k++) { action = (action + 1) % actionsCount; }
+            actions[i] = action;
+        }
+        tetris_env_step(env, actions.data());
+        for (int i = 0; i < envsCount; i++) {
+            totalReward += rewards[i];
+            episodes += dones[i];
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    long long envSteps = (long long) envsCount * steps;
+    printf("Env bench (%s, width %d): %lld env steps in %.3f s, %.0f steps/s, %lld episodes, reward %.0f\n",
+           isPlacement ? "placement" : "tick", width, envSteps, seconds, (double) envSteps / seconds, episodes, totalReward);
+    tetris_env_destroy(env);
+    return 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../game.cpp"
+
+// Текстовые поля и очереди для утилит: фигуры - буквами набора (стандартный - IJLOSTZ, '.' - одиночная плитка)
+
+bool parseShapeClass(char letter, TetroShapeClass* clazz) {
+    int found = PieceSet::active().findByLetter(letter);
+    if (found < 0) { return false; }
+    *clazz = (TetroShapeClass) found;
+    return true;
+}
+
+char shapeLetter(TetroShapeClass clazz) {
+    return PieceSet::active().classes[clazz].letter;
+}
+
+// Строки поля из '.' и '#', прижатые к дну
+bool loadField(const char* path, TetroField* field) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Unable open field: %s\n", path);
+        return false;
+    }
+    std::vector<std::string> rows;
+    char line[FIELD_W_MAX + 8];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        std::string row(line);
+        while (!row.empty() && (row.back() == '\n' || row.back() == '\r')) { row.pop_back(); }
+        if (!row.empty()) { rows.push_back(row); }
+    }
+    fclose(file);
+
+    if ((int) rows.size() > VIEWABLE_FIELD_H) {
+        printf("Field has more than %d rows\n", VIEWABLE_FIELD_H);
+        return false;
+    }
+    for (int r = 0; r < (int) rows.size(); r++) {
+        int y = FIELD_H - (int) rows.size() + r;
+        for (int x = 0; x < field->getWidth() && x < (int) rows[r].size(); x++) {
+            if (rows[r][x] == '#') { field->set(x, y, std::optional(GARBAGE_COLOR)); }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,160 @@
+// Решатель perfect clear: ищет, как поставить известную очередь фигур (по порядку, без
+// удержания), чтобы поле стало пустым. Найденное решение проверяется повторной постановкой
+// фигур через applyPlacement на обычном поле игры.
+// С --bench=N решает N случайных очередей из мешков по 7 фигур с пустого поля
+// (perfect clear в 4 строки - 10 фигур) и печатает время.
+//
+// Usage: pc_solve <pieces, e.g. ILJTOSZIJL> [--width=N] [--threads=N] [--field=FILE] [--pieces=FILE] [--limit=NODES]
+//        pc_solve --bench=N [--bench-pieces=N] [--width=N] [--threads=N] [--pieces=FILE] [--limit=NODES]
+// --pieces - набор фигур (буквы очереди - из него), как в игре и perft; --bench-pieces - длина случайной очереди.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "../solver/perfect_clear.cpp"
+#include "field_text.cpp"
+
+#define PC_SOLVE_BENCH_PIECES 10
+#define PC_SOLVE_BENCH_SEED 12345
+
+// Повторяет решение на поле игры: true, если все фигуры встали и поле пустое
+bool replaySolution(const TetroField& start, const PcSolution& solution) {
+    TetroField field = start;
+    for (int i = 0; i < solution.count; i++) {
+        if (!applyPlacement(&field, solution.pieces[i], solution.placements[i])) { return false; }
+    }
+    for (int x = 0; x < field.getWidth(); x++) {
+        if (field.columnBits(x) != 0) { return false; }
+    }
+    return true;
+}
+
+void printSolution(const PcSolution& solution) {
+    for (int i = 0; i < solution.count; i++) {
+        const Placement& placement = solution.placements[i];
+        printf("  %2d. %c rotation %d, x %d, y %d\n", i + 1, shapeLetter(solution.pieces[i]),
+               placement.variant, placement.x, placement.y);
+    }
+}
+
+int runBench(PerfectClearSolver* solver, int games, int pieces, int width, uint64_t limit) {
+    GameRandom random = GameRandom(PC_SOLVE_BENCH_SEED);
+    ShapeBag bag;
+    std::vector<double> times;
+    int found = 0;
+    int aborted = 0;
+    int invalid = 0;
+    uint64_t nodes = 0;
+
+    for (int game = 0; game < games; game++) {
+        std::vector<TetroShapeClass> queue;
+        while ((int) queue.size() < pieces) {
+            if (bag.empty()) { fillShapeBag(&bag, false, &random); }
+            queue.push_back(bag.popFront());
+        }
+        TetroField field = TetroField(width);
+        PcSolution solution;
+        solver->solve(field, queue.data(), (int) queue.size(), limit, &solution);
+        times.push_back(solution.seconds * 1000.0);
+        nodes += solution.nodes;
+        if (solution.found) {
+            found += 1;
+            if (!replaySolution(field, solution)) { invalid += 1; }
+        }
+        if (solution.aborted) { aborted += 1; }
+    }
+
+    std::sort(times.begin(), times.end());
+    double total = 0.0;
+    for (double time : times) { total += time; }
+    printf("%d queues of %d pieces: %d solved, %d hit node limit, %llu nodes\n",
+           games, pieces, found, aborted, (unsigned long long) nodes);
+    printf("time ms: mean %.3f, median %.3f, p95 %.3f, max %.3f\n", total / games,
+           times[times.size() / 2], times[std::min(times.size() - 1, times.size() * 95 / 100)], times.back());
+    if (invalid > 0) {
+        printf("FAILED: %d solutions do not clear the field\n", invalid);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int width = DEFAULT_FIELD_W;
+    int threads = (int) std::max(1u, std::thread::hardware_concurrency());
+    int bench = 0;
+    int benchPieces = PC_SOLVE_BENCH_PIECES;
+    int limit = PC_DEFAULT_NODE_LIMIT;
+    const char* fieldPath = NULL;
+    const char* piecesPath = NULL;
+    const char* piecesText = NULL;
+
+    bool isValid = true;
+    for (int i = 1; i < argc; i++) {
+        if (parseIntOption(argv[i], "--width=", &width, &isValid)) {
+            isValid = isValid && width >= FIELD_W_MIN && width <= PC_WIDTH_MAX;
+        } else if (parseIntOption(argv[i], "--threads=", &threads, &isValid)) {
+            isValid = isValid && threads >= 1;
+        } else if (parseIntOption(argv[i], "--bench=", &bench, &isValid)) {
+            isValid = isValid && bench >= 1;
+        } else if (parseIntOption(argv[i], "--bench-pieces=", &benchPieces, &isValid)) {
+            isValid = isValid && benchPieces >= 1 && benchPieces <= PC_PIECES_MAX;
+        } else if (parseIntOption(argv[i], "--limit=", &limit, &isValid)) {
+            isValid = isValid && limit >= 1;
+        } else if (strncmp(argv[i], "--field=", 8) == 0) {
+            fieldPath = argv[i] + 8;
+        } else if (strncmp(argv[i], "--pieces=", 9) == 0) {
+            piecesPath = argv[i] + 9;
+        } else if (argv[i][0] != '-' && piecesText == NULL) {
+            piecesText = argv[i];
+        } else {
+            isValid = false;
+        }
+    }
+
+    if (isValid && piecesPath != NULL && !PieceSet::load(piecesPath)) { return 1; }
+
+    std::vector<TetroShapeClass> pieces;
+    for (const char* c = piecesText != NULL ? piecesText : ""; *c != 0; c++) {
+        TetroShapeClass clazz;
+        if (!parseShapeClass(*c, &clazz)) { isValid = false; break; }
+        pieces.push_back(clazz);
+    }
+    isValid = isValid && (bench > 0 || (!pieces.empty() && (int) pieces.size() <= PC_PIECES_MAX));
+    if (!isValid) {
+        printf("Usage: %s <pieces IJLOSTZ., up to %d> [--width=N] [--threads=N] [--field=FILE] [--pieces=FILE] [--limit=NODES]\n",
+               argv[0], PC_PIECES_MAX);
+        printf("       %s --bench=N [--bench-pieces=N] [--width=N] [--threads=N] [--pieces=FILE] [--limit=NODES]\n", argv[0]);
+        return 1;
+    }
+
+    PerfectClearSolver solver = PerfectClearSolver(threads);
+    if (bench > 0) {
+        return runBench(&solver, bench, benchPieces, width, (uint64_t) limit);
+    }
+
+    TetroField field = TetroField(width);
+    if (fieldPath != NULL && !loadField(fieldPath, &field)) { return 1; }
+
+    PcSolution solution;
+    if (!solver.solve(field, pieces.data(), (int) pieces.size(), (uint64_t) limit, &solution)) {
+        printf("Field does not fit the solver: width up to %d, stack up to %d rows\n", PC_WIDTH_MAX, PC_HEIGHT_MAX);
+        return 1;
+    }
+    if (!solution.found) {
+        printf("%s (%llu nodes in %.3f ms, %d threads)\n", solution.aborted ? "Node limit reached" : "No perfect clear",
+               (unsigned long long) solution.nodes, solution.seconds * 1000.0, threads);
+        return 2;
+    }
+
+    printf("Perfect clear in %d lines with %d pieces (%llu nodes in %.3f ms, %d threads)\n", solution.height,
+           solution.count, (unsigned long long) solution.nodes, solution.seconds * 1000.0, threads);
+    printSolution(solution);
+    if (!replaySolution(field, solution)) {
+        printf("FAILED: replay does not clear the field\n");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
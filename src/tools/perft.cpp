@@ -0,0 +1,213 @@
+// Perft для генератора ходов: сколько последовательностей мест фиксации длины depth
+// достижимо из поля по правилам игры для заданной последовательности фигур.
+// Ветви первого уровня считаются параллельно. С --verify те же числа считает медленный
+// эталонный перебор (обход положений через TetroGame::shapeCanPlaced) - расхождение
+// значит ошибку в быстром генераторе или в масках столбцов поля.
+//
+// Usage: perft <depth> <pieces, e.g. TLJSZOI> [--width=N] [--threads=N] [--field=FILE] [--pieces=FILE] [--verify]
+// --field - строки поля из '.' и '#', прижатые к дну; --pieces - набор фигур (буквы очереди - из него).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "../movegen.cpp"
+#include "../concurrent/worker_pool.cpp"
+#include "field_text.cpp"
+
+#define PERFT_DEPTH_MAX 8
+
+// =============
+// Эталон: обход в ширину по положениям (ориентация, x, y), каждое проверяется shapeCanPlaced
+
+void referencePlacements(const TetroField& field, TetroShapeClass clazz, std::vector<Placement>* out) {
+    TetroGame game;
+    game.field = field;
+    int orientations = shapeOrientations(clazz);
+
+    using State = std::tuple<int, int, int>;
+    std::set<State> visited;
+    std::set<State> locks;
+    std::vector<State> queue;
+
+    TetroActiveShape spawn = TetroActiveShape(spawnShapeX(field.getWidth(), clazz), 0, TetroShapePrototype(clazz, 0, TetroColor::red));
+    if (!game.shapeCanPlaced(spawn)) { return; }
+    queue.push_back(State(0, spawn.x, spawn.y));
+    visited.insert(queue.back());
+
+    for (size_t head = 0; head < queue.size(); head++) {
+        auto [variant, x, y] = queue[head];
+        State moves[4] = {
+                State(variant, x - 1, y),
+                State(variant, x + 1, y),
+                State((variant + 1) % orientations, x, y),
+                State(variant, x, y + 1),
+        };
+        for (int m = 0; m < 4; m++) {
+            auto [nextVariant, nextX, nextY] = moves[m];
+            TetroActiveShape shape = TetroActiveShape(nextX, nextY, TetroShapePrototype(clazz, nextVariant, TetroColor::red));
+            bool canPlace = game.shapeCanPlaced(shape);
+            if (m == 3 && !canPlace) { locks.insert(queue[head]); }
+            if (canPlace && visited.insert(moves[m]).second) { queue.push_back(moves[m]); }
+        }
+    }
+
+    for (auto& [variant, x, y] : locks) {
+        out->push_back(Placement { (int8_t) variant, (int16_t) x, (int16_t) y });
+    }
+}
+
+// =============
+// Подсчет: counts[d] - узлов на глубине d + 1 внутри одной ветви
+
+template<typename Generate>
+void perftNode(const TetroField& field, const std::vector<TetroShapeClass>& pieces, int depth, int maxDepth,
+               std::vector<std::vector<Placement>>& levels, uint64_t* counts, Generate& generate) {
+    std::vector<Placement>& placements = levels[depth];
+    placements.clear();
+    generate(field, pieces[depth % pieces.size()], &placements);
+    counts[depth] += placements.size();
+    if (depth + 1 == maxDepth) { return; }
+
+    for (size_t i = 0; i < placements.size(); i++) {
+        TetroField child = field;
+        if (!applyPlacement(&child, pieces[depth % pieces.size()], levels[depth][i])) { continue; }
+        perftNode(child, pieces, depth + 1, maxDepth, levels, counts, generate);
+    }
+}
+
+struct PerftResult {
+    uint64_t counts[PERFT_DEPTH_MAX];
+    double seconds;
+};
+
+// Корень считается в этом потоке, ветви первого уровня - задачами пула
+template<typename MakeGenerator>
+PerftResult runPerft(const TetroField& field, const std::vector<TetroShapeClass>& pieces, int maxDepth, int threads,
+                     std::vector<std::vector<uint64_t>>* branchCounts, MakeGenerator makeGenerator) {
+    PerftResult result;
+    memset(&result, 0, sizeof(result));
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<Placement> roots;
+    auto rootGenerate = makeGenerator();
+    rootGenerate(field, pieces[0], &roots);
+    result.counts[0] = roots.size();
+
+    branchCounts->assign(roots.size(), std::vector<uint64_t>(maxDepth, 0));
+    if (maxDepth > 1) {
+        WorkerPool pool(threads);
+        std::atomic<size_t> nextBranch(0);
+        for (int t = 0; t < threads; t++) {
+            pool.submit([&]() {
+                auto generate = makeGenerator();
+                std::vector<std::vector<Placement>> levels(maxDepth);
+                while (true) {
+                    size_t branch = nextBranch.fetch_add(1);
+                    if (branch >= roots.size()) { return; }
+                    TetroField child = field;
+                    if (!applyPlacement(&child, pieces[0], roots[branch])) { continue; }
+                    perftNode(child, pieces, 1, maxDepth, levels, (*branchCounts)[branch].data(), generate);
+                }
+            });
+        }
+    }
+
+    for (auto& counts : *branchCounts) {
+        for (int d = 1; d < maxDepth; d++) { result.counts[d] += counts[d]; }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int depth = argc > 1 ? atoi(argv[1]) : 0;
+    const char* piecesText = argc > 2 ? argv[2] : "";
+    int width = DEFAULT_FIELD_W;
+    int threads = (int) std::max(1u, std::thread::hardware_concurrency());
+    const char* fieldPath = NULL;
+    const char* piecesPath = NULL;
+    bool verify = false;
+
+    bool isValid = depth >= 1 && depth <= PERFT_DEPTH_MAX && strlen(piecesText) > 0;
+    for (int i = 3; i < argc; i++) {
+        if (parseIntOption(argv[i], "--width=", &width, &isValid)) {
+            isValid = isValid && width >= FIELD_W_MIN && width <= FIELD_W_MAX;
+        } else if (parseIntOption(argv[i], "--threads=", &threads, &isValid)) {
+            isValid = isValid && threads >= 1;
+        } else if (strncmp(argv[i], "--field=", 8) == 0) {
+            fieldPath = argv[i] + 8;
+        } else if (strncmp(argv[i], "--pieces=", 9) == 0) {
+            piecesPath = argv[i] + 9;
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            verify = true;
+        } else {
+            isValid = false;
+        }
+    }
+
+    if (isValid && piecesPath != NULL && !PieceSet::load(piecesPath)) { return 1; }
+
+    std::vector<TetroShapeClass> pieces;
+    for (const char* c = piecesText; *c != 0; c++) {
+        TetroShapeClass clazz;
+        if (!parseShapeClass(*c, &clazz)) { isValid = false; break; }
+        pieces.push_back(clazz);
+    }
+    if (!isValid) {
+        printf("Usage: %s <depth 1..%d> <pieces IJLOSTZ.> [--width=N] [--threads=N] [--field=FILE] [--pieces=FILE] [--verify]\n", argv[0], PERFT_DEPTH_MAX);
+        return 1;
+    }
+
+    TetroField field = TetroField(width);
+    if (fieldPath != NULL && !loadField(fieldPath, &field)) { return 1; }
+
+    std::vector<std::vector<uint64_t>> branchCounts;
+    PerftResult fast = runPerft(field, pieces, depth, threads, &branchCounts, []() {
+        // Генератор держит рабочие массивы - по одному на поток
+        return [moveGen = std::make_shared<MoveGen>()](const TetroField& field, TetroShapeClass clazz, std::vector<Placement>* out) {
+            moveGen->generate(field, clazz, out);
+        };
+    });
+
+    uint64_t totalNodes = 0;
+    for (int d = 0; d < depth; d++) {
+        totalNodes += fast.counts[d];
+        printf("perft %d: %llu\n", d + 1, (unsigned long long) fast.counts[d]);
+    }
+    printf("%llu nodes in %.3f s, %.2f Mnodes/s, %d threads\n",
+           (unsigned long long) totalNodes, fast.seconds, (double) totalNodes / fast.seconds / 1e6, threads);
+
+    if (!verify) { return 0; }
+
+    std::vector<std::vector<uint64_t>> referenceBranchCounts;
+    PerftResult reference = runPerft(field, pieces, depth, threads, &referenceBranchCounts, []() {
+        return [](const TetroField& field, TetroShapeClass clazz, std::vector<Placement>* out) {
+            referencePlacements(field, clazz, out);
+        };
+    });
+
+    int mismatches = 0;
+    for (int d = 0; d < depth; d++) {
+        if (fast.counts[d] != reference.counts[d]) {
+            printf("Mismatch at depth %d: %llu != reference %llu\n",
+                   d + 1, (unsigned long long) fast.counts[d], (unsigned long long) reference.counts[d]);
+            mismatches += 1;
+        }
+    }
+    for (size_t b = 0; b < branchCounts.size() && b < referenceBranchCounts.size() && mismatches > 0; b++) {
+        if (branchCounts[b] != referenceBranchCounts[b]) { printf("  first differing branch: %zu\n", b); break; }
+    }
+    printf("Reference: %.3f s (%.1fx slower)\n", reference.seconds, reference.seconds / fast.seconds);
+    if (mismatches > 0) {
+        printf("FAILED\n");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
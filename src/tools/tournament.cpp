@@ -0,0 +1,243 @@
+// Турнир ботов: каждая пара играет --games партий versus (мусор за линии уходит сопернику),
+// партии идут параллельно на всех ядрах. Пары играют одни и те же зерна, стороны чередуются.
+// Итог - рейтинги Эло по модели Брэдли-Терри (ничья - половина победы) и скорость.
+// Бот - файл весов (формат в src/ai/evaluator.cpp) или default - встроенные веса.
+//
+// Usage: tournament <bot> <bot> [bot ...] [--games=N] [--threads=N] [--max-pieces=N] [--width=N] [--seed=N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../ai/versus.cpp"
+
+#define TOURNAMENT_DEFAULT_GAMES 100
+// Партия без проигравшего за столько ходов - ничья
+#define TOURNAMENT_DEFAULT_MAX_PIECES 1000
+#define TOURNAMENT_ELO_BASE 1500.0
+// Каждый бот как будто сыграл вничью одну партию со средним соперником: рейтинг конечен даже без побед
+#define TOURNAMENT_ELO_PRIOR_GAMES 1.0
+#define TOURNAMENT_ELO_ITERATIONS 1000
+
+struct TournamentBot {
+    std::string name;
+    EvalWeights weights;
+};
+
+struct TournamentGame {
+    int bots[VERSUS_PLAYERS]; // кто играет за игрока 0 и 1
+    uint32_t seed;
+    VersusResult result;
+};
+
+// Зерно k-й партии пары: одинаковое для всех пар
+uint32_t tournamentSeed(uint32_t seed, int game) {
+    return mixSeed(seed * 0x9E3779B9u + (uint32_t) game);
+}
+
+// "bots/v3.txt" -> "v3"
+std::string botName(const char* spec) {
+    std::string name(spec);
+    size_t slash = name.find_last_of("/\\");
+    if (slash != std::string::npos) { name = name.substr(slash + 1); }
+    size_t dot = name.rfind('.');
+    if (dot != std::string::npos && dot > 0) { name = name.substr(0, dot); }
+    return name;
+}
+
+// Поток берет партии по одной из общего счетчика; у каждого свои политики и поля
+void playGames(std::vector<TournamentGame>* games, const std::vector<TournamentBot>& bots, const GameConfig& config,
+               int maxPieces, std::atomic<int>* next, std::atomic<int>* done) {
+    std::vector<PlacementPolicy> policies;
+    for (auto& bot : bots) { policies.push_back(PlacementPolicy(bot.weights)); }
+    VersusMatch match = VersusMatch(config);
+
+    while (true) {
+        int index = next->fetch_add(1);
+        if (index >= (int) games->size()) { return; }
+        TournamentGame& game = (*games)[index];
+        PlacementPolicy* players[VERSUS_PLAYERS] = { &policies[game.bots[0]], &policies[game.bots[1]] };
+        game.result = match.play(players, game.seed, maxPieces);
+        done->fetch_add(1);
+    }
+}
+
+// Сила бота s: ожидаемый счет против j - s / (s + s_j). Итерации minorization-maximization
+// до неподвижной точки; результат не зависит от порядка партий, в отличие от пошагового Эло.
+std::vector<double> fitRatings(const std::vector<TournamentGame>& games, int botsCount) {
+    std::vector<double> points(botsCount, 0.0);
+    std::vector<std::vector<double>> played(botsCount, std::vector<double>(botsCount, 0.0));
+    for (auto& game : games) {
+        int a = game.bots[0];
+        int b = game.bots[1];
+        played[a][b] += 1.0;
+        played[b][a] += 1.0;
+        if (game.result.winner < 0) {
+            points[a] += 0.5;
+            points[b] += 0.5;
+        } else {
+            points[game.bots[game.result.winner]] += 1.0;
+        }
+    }
+
+    std::vector<double> strength(botsCount, 1.0);
+    for (int iteration = 0; iteration < TOURNAMENT_ELO_ITERATIONS; iteration++) {
+        std::vector<double> next(botsCount);
+        double change = 0.0;
+        for (int i = 0; i < botsCount; i++) {
+            double denominator = TOURNAMENT_ELO_PRIOR_GAMES / (strength[i] + 1.0);
+            for (int j = 0; j < botsCount; j++) {
+                if (j != i) { denominator += played[i][j] / (strength[i] + strength[j]); }
+            }
+            next[i] = (points[i] + 0.5 * TOURNAMENT_ELO_PRIOR_GAMES) / denominator;
+        }
+        // Сила определена с точностью до множителя: среднее геометрическое - 1
+        double logMean = 0.0;
+        for (double value : next) { logMean += std::log(value); }
+        logMean /= botsCount;
+        for (int i = 0; i < botsCount; i++) {
+            next[i] /= std::exp(logMean);
+            change = std::max(change, std::fabs(std::log(next[i] / strength[i])));
+        }
+        strength = next;
+        if (change < 1e-9) { break; }
+    }
+
+    std::vector<double> ratings(botsCount);
+    for (int i = 0; i < botsCount; i++) {
+        ratings[i] = TOURNAMENT_ELO_BASE + 400.0 * std::log10(strength[i]);
+    }
+    return ratings;
+}
+
+void printStandings(const std::vector<TournamentGame>& games, const std::vector<TournamentBot>& bots) {
+    int botsCount = (int) bots.size();
+    std::vector<double> ratings = fitRatings(games, botsCount);
+    std::vector<int> wins(botsCount, 0), draws(botsCount, 0), losses(botsCount, 0);
+    std::vector<double> lines(botsCount, 0.0), garbage(botsCount, 0.0);
+    for (auto& game : games) {
+        for (int p = 0; p < VERSUS_PLAYERS; p++) {
+            int bot = game.bots[p];
+            if (game.result.winner < 0) { draws[bot] += 1; }
+            else if (game.result.winner == p) { wins[bot] += 1; }
+            else { losses[bot] += 1; }
+            lines[bot] += game.result.lines[p];
+            garbage[bot] += game.result.garbage[p];
+        }
+    }
+
+    std::vector<int> order(botsCount);
+    for (int i = 0; i < botsCount; i++) { order[i] = i; }
+    std::sort(order.begin(), order.end(), [&ratings](int a, int b) { return ratings[a] > ratings[b]; });
+
+    printf("%4s  %-20s %7s %7s %17s %7s %9s %9s\n", "rank", "bot", "elo", "games", "win-draw-loss", "score", "lines/g", "sent/g");
+    for (int rank = 0; rank < botsCount; rank++) {
+        int i = order[rank];
+        int played = wins[i] + draws[i] + losses[i];
+        double score = played > 0 ? (wins[i] + 0.5 * draws[i]) / played : 0.0;
+        char record[32];
+        snprintf(record, sizeof(record), "%d-%d-%d", wins[i], draws[i], losses[i]);
+        printf("%4d  %-20s %7.0f %7d %17s %6.1f%% %9.1f %9.1f\n", rank + 1, bots[i].name.c_str(), ratings[i], played, record,
+               score * 100.0, played > 0 ? lines[i] / played : 0.0, played > 0 ? garbage[i] / played : 0.0);
+    }
+}
+
+int main(int argc, char** argv) {
+    int gamesPerPair = TOURNAMENT_DEFAULT_GAMES;
+    int threads = (int) std::max(1u, std::thread::hardware_concurrency());
+    int maxPieces = TOURNAMENT_DEFAULT_MAX_PIECES;
+    int width = DEFAULT_FIELD_W;
+    int seed = 1;
+    std::vector<const char*> botSpecs;
+
+    bool isValid = true;
+    for (int i = 1; i < argc; i++) {
+        if (parseIntOption(argv[i], "--games=", &gamesPerPair, &isValid)) {
+            isValid = isValid && gamesPerPair >= 1;
+        } else if (parseIntOption(argv[i], "--threads=", &threads, &isValid)) {
+            isValid = isValid && threads >= 1;
+        } else if (parseIntOption(argv[i], "--max-pieces=", &maxPieces, &isValid)) {
+            isValid = isValid && maxPieces >= 1;
+        } else if (parseIntOption(argv[i], "--width=", &width, &isValid)) {
+            isValid = isValid && width >= FIELD_W_MIN && width <= FIELD_W_MAX;
+        } else if (parseIntOption(argv[i], "--seed=", &seed, &isValid)) {
+            isValid = isValid && seed >= 0;
+        } else if (argv[i][0] != '-') {
+            botSpecs.push_back(argv[i]);
+        } else {
+            isValid = false;
+        }
+    }
+    if (!isValid || botSpecs.size() < 2) {
+        printf("Usage: %s <bot> <bot> [bot ...] [--games=N] [--threads=N] [--max-pieces=N] [--width=N] [--seed=N]\n", argv[0]);
+        printf("  bot - weights file or 'default'; --games - games per pair of bots (default %d)\n", TOURNAMENT_DEFAULT_GAMES);
+        return 1;
+    }
+
+    std::vector<TournamentBot> bots;
+    for (const char* spec : botSpecs) {
+        TournamentBot bot;
+        bot.name = botName(spec);
+        if (strcmp(spec, "default") == 0) {
+            bot.weights = EvalWeights::defaults();
+        } else if (!EvalWeights::load(spec, &bot.weights)) {
+            return 1;
+        }
+        // Один файл дважды - разные участники
+        for (auto& other : bots) {
+            if (other.name == bot.name) { bot.name += "#" + std::to_string(bots.size() + 1); }
+        }
+        bots.push_back(bot);
+    }
+
+    std::vector<TournamentGame> games;
+    for (int a = 0; a < (int) bots.size(); a++) {
+        for (int b = a + 1; b < (int) bots.size(); b++) {
+            for (int k = 0; k < gamesPerPair; k++) {
+                TournamentGame game = TournamentGame();
+                game.bots[0] = k % 2 == 0 ? a : b;
+                game.bots[1] = k % 2 == 0 ? b : a;
+                game.seed = tournamentSeed((uint32_t) seed, k);
+                games.push_back(game);
+            }
+        }
+    }
+
+    GameConfig config;
+    config.fieldWidth = width;
+    config.boardsCount = VERSUS_PLAYERS;
+
+    printf("%d bots, %d games on %d threads, up to %d pieces per game\n", (int) bots.size(), (int) games.size(), threads, maxPieces);
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<int> next(0);
+    std::atomic<int> done(0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(playGames, &games, std::cref(bots), std::cref(config), maxPieces, &next, &done);
+    }
+    // Прогресс по десятым долям
+    int reported = 0;
+    while (done.load() < (int) games.size()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        int tenths = done.load() * 10 / (int) games.size();
+        if (tenths > reported && tenths < 10) {
+            reported = tenths;
+            printf("  %d/%d games\n", done.load(), (int) games.size());
+            fflush(stdout);
+        }
+    }
+    for (auto& worker : workers) { worker.join(); }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t pieces = 0;
+    for (auto& game : games) { pieces += (uint64_t) game.result.pieces * VERSUS_PLAYERS; }
+    printStandings(games, bots);
+    printf("%d games in %.2f s: %.1f games/s (%.0f per hour), %.0f pieces/s\n", (int) games.size(), seconds,
+           games.size() / seconds, games.size() / seconds * 3600.0, pieces / seconds);
+    return 0;
+}
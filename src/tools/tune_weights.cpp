@@ -0,0 +1,279 @@
+// Подбор весов оценки (src/ai/evaluator.cpp) для встроенного бота методом CMA-ES.
+// Оценка набора весов - среднее число линий за --games одиночных партий до проигрыша или
+// --max-pieces ходов. Партии поколения идут параллельно на всех ядрах; все кандидаты поколения
+// играют одни и те же зерна, чтобы разница в оценке шла от весов, а не от очереди фигур.
+// После каждого поколения состояние пишется в --checkpoint; если файл уже есть, подбор
+// продолжается с него (настройки партий - из файла) и дает те же веса, что и без перерыва.
+// --out - текущее среднее распределения, файл весов для игры и tournament.
+//
+// Usage: tune_weights [--generations=N] [--population=N] [--games=N] [--max-pieces=N] [--sigma=X]
+//                     [--threads=N] [--width=N] [--seed=N] [--start=FILE] [--checkpoint=FILE] [--out=FILE]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../ai/cma_es.cpp"
+#include "../ai/evaluator.cpp"
+#include "../concurrent/worker_pool.cpp"
+#include "../utils.cpp"
+
+#define TUNE_DEFAULT_GENERATIONS 100
+#define TUNE_DEFAULT_GAMES 32
+// Лимит должен быть таким, чтобы и хорошие веса иногда проигрывали: иначе у всех кандидатов
+// одна оценка - 4/ширина линии на ход. Встроенные веса при 1000 ходах почти всегда доживают до лимита.
+#define TUNE_DEFAULT_MAX_PIECES 5000
+#define TUNE_DEFAULT_SIGMA 0.3
+
+static_assert(EVAL_FEATURES <= CMA_DIMENSIONS_MAX, "Features must fit into CMA-ES");
+
+// Настройки, от которых зависит оценка; хранятся в контрольной точке
+struct TuneSettings {
+    int games;
+    int maxPieces;
+    int width;
+    int seed;
+};
+
+struct TuneState {
+    TuneSettings settings;
+    CmaEs search;
+    double bestFitness; // лучший кандидат за все поколения
+    EvalWeights best;
+};
+
+// Зерно k-й партии поколения: одинаковое для всех кандидатов поколения
+uint32_t tuneSeed(uint32_t seed, int generation, int game) {
+    return mixSeed(seed * 0x9E3779B9u + (uint32_t) generation * 0x85EBCA6Bu + (uint32_t) game);
+}
+
+// Выбор хода не меняется от умножения весов на положительное число: играем нормированными
+EvalWeights candidateWeights(const std::vector<double>& x) {
+    double norm = 0.0;
+    for (double value : x) { norm += value * value; }
+    norm = std::sqrt(norm);
+    EvalWeights weights = EvalWeights();
+    for (int i = 0; i < EVAL_FEATURES; i++) {
+        weights.values[i] = norm > 0.0 ? (float) (x[i] / norm) : 0.0f;
+    }
+    return weights;
+}
+
+int playSolo(TetroGame& game, PlacementPolicy& policy, uint32_t seed, int maxPieces) {
+    game.reset(seed);
+    game.spawnNextShape();
+    for (int piece = 0; piece < maxPieces && !game.isLose; piece++) {
+        PolicyMove move;
+        if (!policy.choose(game, &move) || !game.placeShape(move.rotations, move.column)) { break; }
+    }
+    return game.clearedTiles / game.field.getWidth();
+}
+
+// Оценки кандидатов: работы (кандидат, партия) из общего счетчика, у каждого потока свое поле
+std::vector<double> evaluate(const std::vector<std::vector<double>>& candidates, const TuneSettings& settings,
+                             int generation, int threads) {
+    int games = settings.games;
+    int jobs = (int) candidates.size() * games;
+    std::vector<int> lines(jobs, 0);
+    GameConfig config;
+    config.fieldWidth = settings.width;
+    {
+        WorkerPool pool(threads);
+        std::atomic<int> nextJob(0);
+        for (int t = 0; t < threads; t++) {
+            pool.submit([&]() {
+                TetroGame game = TetroGame(config);
+                PlacementPolicy policy;
+                while (true) {
+                    int job = nextJob.fetch_add(1);
+                    if (job >= jobs) { return; }
+                    policy.weights = candidateWeights(candidates[job / games]);
+                    uint32_t seed = tuneSeed((uint32_t) settings.seed, generation, job % games);
+                    lines[job] = playSolo(game, policy, seed, settings.maxPieces);
+                }
+            });
+        }
+    }
+
+    std::vector<double> fitness(candidates.size(), 0.0);
+    for (int job = 0; job < jobs; job++) { fitness[job / games] += lines[job]; }
+    for (double& value : fitness) { value /= games; }
+    return fitness;
+}
+
+// =================================================
+// Контрольная точка - текст:
+//   tune <games> <max_pieces> <width> <seed>
+//   features <имена признаков через пробел>
+//   <состояние CmaEs::write>
+//   best <оценка> <веса в порядке features>
+
+bool writeCheckpoint(const char* path, const TuneState& state) {
+    char tempPath[1024];
+    if (!tempFilePath(path, tempPath, sizeof(tempPath))) { return false; }
+    FILE* file = fopen(tempPath, "w");
+    if (file == NULL) { return false; }
+    const TuneSettings& settings = state.settings;
+    fprintf(file, "tune %d %d %d %d\n", settings.games, settings.maxPieces, settings.width, settings.seed);
+    fprintf(file, "features");
+    for (int i = 0; i < EVAL_FEATURES; i++) { fprintf(file, " %s", EVAL_FEATURE_NAMES[i]); }
+    fprintf(file, "\n");
+    state.search.write(file);
+    fprintf(file, "best %.17g", state.bestFitness);
+    for (int i = 0; i < EVAL_FEATURES; i++) { fprintf(file, " %.9g", state.best.values[i]); }
+    fprintf(file, "\n");
+    bool isWritten = ferror(file) == 0;
+    isWritten = fclose(file) == 0 && isWritten;
+    return replaceWithTempFile(tempPath, path, isWritten);
+}
+
+// Признаки должны совпадать с текущими: иначе координаты поиска значат другое
+bool readCheckpoint(FILE* file, TuneState* out) {
+    TuneState state = TuneState();
+    TuneSettings& settings = state.settings;
+    if (fscanf(file, " tune %d %d %d %d", &settings.games, &settings.maxPieces, &settings.width, &settings.seed) != 4) {
+        return false;
+    }
+    if (settings.games < 1 || settings.maxPieces < 1 || settings.width < FIELD_W_MIN || settings.width > FIELD_W_MAX) {
+        return false;
+    }
+    char name[64];
+    if (fscanf(file, " %63s", name) != 1 || strcmp(name, "features") != 0) { return false; }
+    for (int i = 0; i < EVAL_FEATURES; i++) {
+        if (fscanf(file, " %63s", name) != 1 || strcmp(name, EVAL_FEATURE_NAMES[i]) != 0) { return false; }
+    }
+    if (!state.search.read(file) || state.search.dimensions != EVAL_FEATURES) { return false; }
+    if (fscanf(file, " best %lf", &state.bestFitness) != 1) { return false; }
+    for (int i = 0; i < EVAL_FEATURES; i++) {
+        if (fscanf(file, " %f", &state.best.values[i]) != 1) { return false; }
+    }
+    *out = state;
+    return true;
+}
+
+bool writeWeights(const char* path, const EvalWeights& weights, double fitness, int generation) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) { return false; }
+    fprintf(file, "// tune_weights: generation %d, %.1f lines per game\n", generation, fitness);
+    weights.write(file);
+    return fclose(file) == 0;
+}
+
+int main(int argc, char** argv) {
+    int generations = TUNE_DEFAULT_GENERATIONS;
+    int population = 0;
+    double sigma = TUNE_DEFAULT_SIGMA;
+    int threads = (int) std::max(1u, std::thread::hardware_concurrency());
+    TuneSettings settings = TuneSettings { TUNE_DEFAULT_GAMES, TUNE_DEFAULT_MAX_PIECES, DEFAULT_FIELD_W, 1 };
+    const char* startPath = NULL;
+    const char* checkpointPath = NULL;
+    const char* outPath = NULL;
+
+    bool isValid = true;
+    for (int i = 1; i < argc; i++) {
+        if (parseIntOption(argv[i], "--generations=", &generations, &isValid)) {
+            isValid = isValid && generations >= 1;
+        } else if (parseIntOption(argv[i], "--population=", &population, &isValid)) {
+            isValid = isValid && (population == 0 || (population >= 4 && population <= CMA_POPULATION_MAX));
+        } else if (parseIntOption(argv[i], "--games=", &settings.games, &isValid)) {
+            isValid = isValid && settings.games >= 1;
+        } else if (parseIntOption(argv[i], "--max-pieces=", &settings.maxPieces, &isValid)) {
+            isValid = isValid && settings.maxPieces >= 1;
+        } else if (parseDoubleOption(argv[i], "--sigma=", &sigma, &isValid)) {
+            isValid = isValid && sigma > 0.0;
+        } else if (parseIntOption(argv[i], "--threads=", &threads, &isValid)) {
+            isValid = isValid && threads >= 1;
+        } else if (parseIntOption(argv[i], "--width=", &settings.width, &isValid)) {
+            isValid = isValid && settings.width >= FIELD_W_MIN && settings.width <= FIELD_W_MAX;
+        } else if (parseIntOption(argv[i], "--seed=", &settings.seed, &isValid)) {
+            isValid = isValid && settings.seed >= 0;
+        } else if (strncmp(argv[i], "--start=", 8) == 0) {
+            startPath = argv[i] + 8;
+        } else if (strncmp(argv[i], "--checkpoint=", 13) == 0) {
+            checkpointPath = argv[i] + 13;
+        } else if (strncmp(argv[i], "--out=", 6) == 0) {
+            outPath = argv[i] + 6;
+        } else {
+            isValid = false;
+        }
+    }
+    if (!isValid) {
+        printf("Usage: %s [--generations=N] [--population=N] [--games=N] [--max-pieces=N] [--sigma=X]\n", argv[0]);
+        printf("       [--threads=N] [--width=N] [--seed=N] [--start=FILE] [--checkpoint=FILE] [--out=FILE]\n");
+        printf("  --games - games per candidate (default %d), --population - candidates per generation (default 4 + 3 ln %d)\n",
+               TUNE_DEFAULT_GAMES, EVAL_FEATURES);
+        printf("  --start - initial weights (default - built-in), --checkpoint - resume from FILE if it exists\n");
+        return 1;
+    }
+
+    TuneState state = TuneState();
+    FILE* checkpoint = checkpointPath != NULL ? fopen(checkpointPath, "r") : NULL;
+    if (checkpoint != NULL) {
+        bool isRead = readCheckpoint(checkpoint, &state);
+        fclose(checkpoint);
+        if (!isRead) {
+            printf("Invalid checkpoint: %s\n", checkpointPath);
+            return 1;
+        }
+        printf("Resuming %s from generation %d\n", checkpointPath, state.search.generation);
+    } else {
+        EvalWeights start = EvalWeights::defaults();
+        if (startPath != NULL && !EvalWeights::load(startPath, &start)) { return 1; }
+        double mean[EVAL_FEATURES];
+        for (int i = 0; i < EVAL_FEATURES; i++) { mean[i] = start.values[i]; }
+        state.settings = settings;
+        state.search.start(EVAL_FEATURES, mean, sigma, population, (uint64_t) settings.seed + 1);
+        state.bestFitness = -1.0;
+        state.best = start;
+    }
+
+    const TuneSettings& active = state.settings;
+    CmaEs& search = state.search;
+    printf("%d features, %d candidates x %d games per generation on %d threads, up to %d pieces per game\n",
+           EVAL_FEATURES, search.population, active.games, threads, active.maxPieces);
+    printf("%5s %10s %10s %10s %8s\n", "gen", "sigma", "best", "mean", "seconds");
+
+    std::vector<std::vector<double>> candidates;
+    while (search.generation < generations) {
+        auto start = std::chrono::steady_clock::now();
+        int generation = search.generation;
+        search.ask(&candidates);
+        // Последним играет само среднее: его оценка - то, что попадет в --out
+        candidates.push_back(std::vector<double>(search.mean, search.mean + EVAL_FEATURES));
+        std::vector<double> fitness = evaluate(candidates, active, generation, threads);
+        double meanFitness = fitness.back();
+        EvalWeights meanWeights = candidateWeights(candidates.back());
+        candidates.pop_back();
+        fitness.pop_back();
+
+        int bestIndex = (int) (std::max_element(fitness.begin(), fitness.end()) - fitness.begin());
+        if (fitness[bestIndex] > state.bestFitness) {
+            state.bestFitness = fitness[bestIndex];
+            state.best = candidateWeights(candidates[bestIndex]);
+        }
+        search.tell(candidates, fitness);
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("%5d %10.4f %10.1f %10.1f %8.2f\n", generation, search.sigma, fitness[bestIndex], meanFitness, seconds);
+        fflush(stdout);
+
+        if (checkpointPath != NULL && !writeCheckpoint(checkpointPath, state)) {
+            printf("Unable write checkpoint: %s\n", checkpointPath);
+            return 1;
+        }
+        if (outPath != NULL && !writeWeights(outPath, meanWeights, meanFitness, generation)) {
+            printf("Unable write weights: %s\n", outPath);
+            return 1;
+        }
+    }
+
+    printf("best candidate: %.1f lines per game\n", state.bestFitness);
+    state.best.write(stdout);
+    return 0;
+}
@@ -1,3 +1,11 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
 //
 // Created by dragon on 22.04.2024.
 //
@@ -11,3 +19,68 @@ char* copyStr(const char* source) {
     return buf;
 }
 
+// Шаг xorshift32 (Марсалья): *state != 0, возвращает новое состояние
+inline uint32_t xorshift32(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// Перемешивает биты числа (финализатор в духе splitmix): соседние входы дают далекие выходы.
+// Из зерна запуска и номера партии - независимые зерна партий.
+inline uint32_t mixSeed(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Разбирает "--name=value" в целое. Возвращает false, если аргумент не про эту опцию.
+bool parseIntOption(const char* arg, const char* prefix, int* value, bool* isValid) {
+    auto prefixLen = strlen(prefix);
+    if (strncmp(arg, prefix, prefixLen) != 0) { return false; }
+
+    const char* text = arg + prefixLen;
+    char* end = NULL;
+    long parsed = strtol(text, &end, 10);
+    *isValid = *text != '\0' && *end == '\0';
+    if (*isValid) { *value = (int) parsed; }
+    return true;
+}
+
+// Разбирает "--name=value" в конечное число с плавающей точкой, как parseIntOption
+bool parseDoubleOption(const char* arg, const char* prefix, double* value, bool* isValid) {
+    auto prefixLen = strlen(prefix);
+    if (strncmp(arg, prefix, prefixLen) != 0) { return false; }
+
+    const char* text = arg + prefixLen;
+    char* end = NULL;
+    double parsed = strtod(text, &end);
+    *isValid = *text != '\0' && *end == '\0' && std::isfinite(parsed);
+    if (*isValid) { *value = parsed; }
+    return true;
+}
+
+// Рядом с path: "<path>.tmp". false - путь не помещается в size.
+bool tempFilePath(const char* path, char* out, size_t size) {
+    return snprintf(out, size, "%s.tmp", path) < (int) size;
+}
+
+// Заменяет path записанным tempPath; если запись не удалась (isWritten) или замена
+// не прошла, удаляет tempPath, и прежний path остается целым
+bool replaceWithTempFile(const char* tempPath, const char* path, bool isWritten) {
+#ifdef _WIN32
+    // rename в Windows не заменяет существующий файл
+    if (isWritten) { std::remove(path); }
+#endif
+    if (!isWritten || std::rename(tempPath, path) != 0) {
+        std::remove(tempPath);
+        return false;
+    }
+    return true;
+}